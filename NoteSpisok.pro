@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
@@ -26,29 +26,13 @@ DEFINES += QT_DEPRECATED_WARNINGS
 CONFIG += c++11
 
 SOURCES += \
-        aboutapp.cpp \
-        configuration.cpp \
-        delete.cpp \
-        dictionaries.cpp \
-        main.cpp \
-        mainwindow.cpp \
-        rename.cpp
+        commandline.cpp \
+        main.cpp
 
 HEADERS += \
-        aboutapp.h \
-        configuration.h \
-        delete.h \
-        dictionaries.h \
-        mainwindow.h \
-        rename.h
-
-FORMS += \
-        aboutapp.ui \
-        configuration.ui \
-        delete.ui \
-        dictionaries.ui \
-        mainwindow.ui \
-        rename.ui
+        commandline.h
+
+include(notespisok.pri)
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
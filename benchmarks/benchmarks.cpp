@@ -0,0 +1,475 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QScopedPointer>
+#include <QComboBox>
+#include <QListView>
+#include <QLineEdit>
+#include <QTextEdit>
+#include <QTextDocument>
+#include <QTextCursor>
+#include "corpus.h"
+#include "mainwindow.h"
+#include "storage.h"
+#include "termstore.h"
+#include "termloader.h"
+
+/* Every benchmark runs against the real main window, opened on
+ * a generated corpus, and is reported twice per dictionary size:
+ * cold, the first time the operation runs in a freshly opened
+ * window, and warm, once the window has done it before. Cold runs
+ * still find the corpus in the page cache of the system.
+ *
+ * NOTESPISOK_BENCH_SIZES lists the dictionary sizes, for example
+ * "1000,100000,1000000". NOTESPISOK_BENCH_CORPUS names a folder
+ * where the corpus is kept between runs, since large dictionaries
+ * take a while to generate; a temporary folder is used otherwise.
+ */
+
+//Dictionary sizes benchmarked unless others are listed
+QString const defaultSizes{"1000,100000"};
+
+//All the dictionaries are saved in the resources folder
+QString const resourcesFolder{"resources/"};
+
+//A small dictionary to switch away from and back to
+QString const smallDictionary{"corpus-small"};
+int const smallSize{10};
+
+//How many terms of each dictionary are viewed, saved, and searched
+int const sampleSize{64};
+
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void cleanupTestCase();
+
+    void dictionarySwitch_data();
+
+    void dictionarySwitch();
+
+    void termView_data();
+
+    void termView();
+
+    void save_data();
+
+    void save();
+
+    void searchKeystroke_data();
+
+    void searchKeystroke();
+
+    void fuzzySuggestion_data();
+
+    void fuzzySuggestion();
+
+    void historyNavigation_data();
+
+    void historyNavigation();
+
+private:
+    static QString dictionaryName(int size);
+
+    void addRows();
+
+    MainWindow *openWindow(QString const &dictionary);
+
+    void switchDictionary(MainWindow *window, QString const &dictionary);
+
+    static bool viewTerm(MainWindow *window, QString const &term, bool historyUpdateNeeded);
+
+    QTemporaryDir mTemporaryFolder;
+    QString mPreviousFolder;
+    QList<int> mSizes;
+    QHash<QString, int> mCounts;
+    QHash<QString, QStringList> mSamples;
+};
+
+/**
+ * @brief Benchmarks::dictionaryName
+ * @param size the number of terms
+ * @return the name of the generated dictionary of that size
+ */
+QString Benchmarks::dictionaryName(int size)
+{
+    return QString{"corpus-%1"}.arg(size);
+}
+
+/**
+ * @brief Benchmarks::initTestCase
+ * Generates the corpus and makes it the working folder, so
+ * that the main window finds it where it looks for resources.
+ */
+void Benchmarks::initTestCase()
+{
+    mPreviousFolder = QDir::currentPath();
+
+    QString folder{QString::fromLocal8Bit(qgetenv("NOTESPISOK_BENCH_CORPUS"))};
+    if (folder == "")
+    {
+        QVERIFY(mTemporaryFolder.isValid());
+        folder = mTemporaryFolder.path();
+    }
+    QVERIFY(QDir{}.mkpath(folder));
+    QVERIFY(QDir::setCurrent(folder));
+
+    QString sizes{QString::fromLocal8Bit(qgetenv("NOTESPISOK_BENCH_SIZES"))};
+    if (sizes == "")
+        sizes = defaultSizes;
+    for (QString const &size: sizes.split(',', QString::SkipEmptyParts))
+        mSizes << size.trimmed().toInt();
+
+    QMap<QString, int> dictionaries{{smallDictionary, smallSize}};
+    for (int size: mSizes)
+        dictionaries.insert(dictionaryName(size), size);
+
+    Storage storage{resourcesFolder};
+    std::mt19937 random{1};
+    for (auto dictionary = dictionaries.constBegin(); dictionary != dictionaries.constEnd(); ++dictionary)
+    {
+        int const count{Corpus::generate(resourcesFolder, dictionary.key(), dictionary.value(),
+                                         static_cast<quint32>(dictionary.value()))};
+        QVERIFY(count > 0);
+        mCounts.insert(dictionary.key(), count);
+
+        //Pick the same terms on every run
+        QSharedPointer<TermStore> const store{storage.store(dictionary.key())};
+        QVERIFY(!store.isNull());
+        QStringList const terms{store->terms()};
+        std::uniform_int_distribution<int> pick{0, terms.size() - 1};
+        QStringList &samples{mSamples[dictionary.key()]};
+        for (int i = 0; i < sampleSize; i++)
+            samples << terms[pick(random)];
+    }
+    storage.closeAll();
+
+    //Let a first window build the full-text index, so that later
+    //windows do not spend the benchmarks indexing in the background
+    delete new MainWindow;
+}
+
+/**
+ * @brief Benchmarks::cleanupTestCase
+ * Leaves the corpus folder.
+ */
+void Benchmarks::cleanupTestCase()
+{
+    QDir::setCurrent(mPreviousFolder);
+}
+
+/**
+ * @brief Benchmarks::addRows
+ * Adds a cold and a warm row for every dictionary size.
+ */
+void Benchmarks::addRows()
+{
+    QTest::addColumn<QString>("dictionary");
+    QTest::addColumn<bool>("cold");
+
+    for (int size: mSizes)
+    {
+        QTest::newRow(qPrintable(QString{"%1 terms, cold"}.arg(size))) << dictionaryName(size) << true;
+        QTest::newRow(qPrintable(QString{"%1 terms, warm"}.arg(size))) << dictionaryName(size) << false;
+    }
+}
+
+/**
+ * @brief Benchmarks::openWindow
+ * @param dictionary the dictionary to show
+ * @return a new main window, showing every term of the dictionary
+ */
+MainWindow *Benchmarks::openWindow(QString const &dictionary)
+{
+    MainWindow *window{new MainWindow};
+    switchDictionary(window, dictionary);
+    return window;
+}
+
+/**
+ * @brief Benchmarks::switchDictionary
+ * Selects a dictionary and waits until its terms are listed
+ * and its fuzzy matcher is built.
+ * @param window the main window
+ * @param dictionary the dictionary to show
+ */
+void Benchmarks::switchDictionary(MainWindow *window, QString const &dictionary)
+{
+    QComboBox *dictionaries{window->findChild<QComboBox *>("comboBoxDictionaries")};
+    QListView const *terms{window->findChild<QListView *>("listViewEntries")};
+    TermLoader const *loader{window->findChild<TermLoader *>()};
+
+    dictionaries->setCurrentText(dictionary);
+    while (loader->isLoading() || terms->model()->rowCount() < mCounts.value(dictionary))
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    //Deliver the fuzzy matcher, relayed after the last batch
+    QCoreApplication::processEvents();
+}
+
+/**
+ * @brief Benchmarks::viewTerm
+ * Views a term of the current dictionary, as clicking it would.
+ * @param window the main window
+ * @param term the term name
+ * @param historyUpdateNeeded whether to add the term to the history
+ * @return whether the term was found
+ */
+bool Benchmarks::viewTerm(MainWindow *window, QString const &term, bool historyUpdateNeeded)
+{
+    bool viewed{false};
+    QMetaObject::invokeMethod(window, "viewContents", Q_RETURN_ARG(bool, viewed),
+                              Q_ARG(QString, term), Q_ARG(bool, false),
+                              Q_ARG(bool, historyUpdateNeeded));
+    return viewed;
+}
+
+void Benchmarks::dictionarySwitch_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::dictionarySwitch
+ * Switching to a dictionary until all its terms are listed.
+ * Warm runs switch back to a small dictionary in between.
+ */
+void Benchmarks::dictionarySwitch()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    QScopedPointer<MainWindow> window{openWindow(smallDictionary)};
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            switchDictionary(window.data(), dictionary);
+        }
+        return;
+    }
+
+    switchDictionary(window.data(), dictionary);
+    QBENCHMARK {
+        switchDictionary(window.data(), smallDictionary);
+        switchDictionary(window.data(), dictionary);
+    }
+}
+
+void Benchmarks::termView_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::termView
+ * Viewing the definition of a term. Warm runs cycle through
+ * terms that have all been viewed before.
+ */
+void Benchmarks::termView()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    QScopedPointer<MainWindow> window{openWindow(dictionary)};
+    QStringList const samples{mSamples.value(dictionary)};
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            QVERIFY(viewTerm(window.data(), samples[0], false));
+        }
+        return;
+    }
+
+    for (QString const &term: samples)
+        viewTerm(window.data(), term, false);
+    int i{0};
+    QBENCHMARK {
+        viewTerm(window.data(), samples[i++ % samples.size()], false);
+    }
+}
+
+void Benchmarks::save_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::save
+ * Saving an edited definition, until the window can be used
+ * again; the definition itself is written in the background.
+ * Each edit types a few characters at the end, like a user
+ * would, so only they are written.
+ */
+void Benchmarks::save()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    QScopedPointer<MainWindow> window{openWindow(dictionary)};
+    QTextEdit *editor{window->findChild<QTextEdit *>("textEdit")};
+    QStringList const samples{mSamples.value(dictionary)};
+    QVERIFY(viewTerm(window.data(), samples[0], false));
+    QString const definition{editor->toPlainText()};
+
+    int edit{0};
+    auto const saveEdit = [&]() {
+        QTextCursor cursor{editor->document()};
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(QString::number(edit++));
+        QMetaObject::invokeMethod(window.data(), "on_pushButtonSave_clicked");
+    };
+
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            saveEdit();
+        }
+    }
+    else
+    {
+        saveEdit();
+        QBENCHMARK {
+            saveEdit();
+        }
+    }
+
+    //Leave the definition as it was
+    editor->setPlainText(definition);
+    editor->document()->setModified(true);
+    QMetaObject::invokeMethod(window.data(), "on_pushButtonSave_clicked");
+}
+
+void Benchmarks::searchKeystroke_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::searchKeystroke
+ * Looking up the search box after a keystroke, as if typing
+ * had paused after every one. Most prefixes are not terms,
+ * so suggestions are looked for too.
+ */
+void Benchmarks::searchKeystroke()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    QScopedPointer<MainWindow> window{openWindow(dictionary)};
+    QLineEdit *search{window->findChild<QLineEdit *>("lineEditSearch")};
+
+    //Every prefix of the sampled terms, in typing order
+    QStringList keystrokes;
+    for (QString const &term: mSamples.value(dictionary))
+        for (int length = 1; length <= term.size(); length++)
+            keystrokes << term.left(length);
+
+    int i{0};
+    auto const type = [&]() {
+        search->setText(keystrokes[i++ % keystrokes.size()]);
+        QMetaObject::invokeMethod(window.data(), "lookUpSearch");
+    };
+
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            type();
+        }
+        return;
+    }
+
+    for (int j = 0; j < keystrokes.size(); j++)
+        type();
+    QBENCHMARK {
+        type();
+    }
+}
+
+void Benchmarks::fuzzySuggestion_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::fuzzySuggestion
+ * Looking up a misspelled term, which no term starts with,
+ * so the closest terms are suggested instead. The corpus
+ * has no digits, so ending a sampled term with one makes a
+ * misspelling one edit away from it.
+ */
+void Benchmarks::fuzzySuggestion()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    QScopedPointer<MainWindow> window{openWindow(dictionary)};
+    QLineEdit *search{window->findChild<QLineEdit *>("lineEditSearch")};
+
+    QStringList misspellings;
+    for (QString const &term: mSamples.value(dictionary))
+        misspellings << term.left(term.size() - 1) + "0";
+
+    int i{0};
+    auto const type = [&]() {
+        search->setText(misspellings[i++ % misspellings.size()]);
+        QMetaObject::invokeMethod(window.data(), "lookUpSearch");
+    };
+
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            type();
+        }
+        return;
+    }
+
+    for (int j = 0; j < misspellings.size(); j++)
+        type();
+    QBENCHMARK {
+        type();
+    }
+}
+
+void Benchmarks::historyNavigation_data()
+{
+    addRows();
+}
+
+/**
+ * @brief Benchmarks::historyNavigation
+ * Going back and forth through the history. Cold runs go
+ * back once in a window that has just read the history.
+ */
+void Benchmarks::historyNavigation()
+{
+    QFETCH(QString, dictionary);
+    QFETCH(bool, cold);
+
+    //Fill the history with terms of the dictionary
+    {
+        QScopedPointer<MainWindow> writer{openWindow(dictionary)};
+        for (QString const &term: mSamples.value(dictionary))
+            viewTerm(writer.data(), term, true);
+    }
+
+    QScopedPointer<MainWindow> window{openWindow(dictionary)};
+    if (cold)
+    {
+        QBENCHMARK_ONCE {
+            QMetaObject::invokeMethod(window.data(), "on_pushButtonBack_clicked");
+        }
+        return;
+    }
+
+    QBENCHMARK {
+        QMetaObject::invokeMethod(window.data(), "on_pushButtonBack_clicked");
+        QMetaObject::invokeMethod(window.data(), "on_pushButtonNext_clicked");
+    }
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "benchmarks.moc"
@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Benchmarks for the storage and interface paths.
+# Build with: qmake benchmarks/benchmarks.pro && make
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent testlib
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = benchmarks
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+SOURCES += \
+        benchmarks.cpp \
+        corpus.cpp
+
+HEADERS += \
+        corpus.h
+
+include(../notespisok.pri)
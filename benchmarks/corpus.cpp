@@ -0,0 +1,159 @@
+#include "corpus.h"
+#include "storage.h"
+#include "packedtermstore.h"
+
+#include <QDir>
+#include <QSet>
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+//Syllables the generated words are made of
+QStringList const latinSyllables{
+    "ka", "re", "mo", "ti", "lan", "ster", "que", "vi", "no", "pa",
+    "dor", "ex", "ul", "men", "tra", "sol", "bi", "gen", "ro", "tum"
+};
+QStringList const cyrillicSyllables{
+    QString::fromUtf8("ка"), QString::fromUtf8("ре"), QString::fromUtf8("мо"),
+    QString::fromUtf8("ти"), QString::fromUtf8("лан"), QString::fromUtf8("стер"),
+    QString::fromUtf8("ще"), QString::fromUtf8("ви"), QString::fromUtf8("но"),
+    QString::fromUtf8("па"), QString::fromUtf8("дор"), QString::fromUtf8("ёж"),
+    QString::fromUtf8("ул"), QString::fromUtf8("мен"), QString::fromUtf8("тра"),
+    QString::fromUtf8("сол"), QString::fromUtf8("бы"), QString::fromUtf8("жен"),
+    QString::fromUtf8("ро"), QString::fromUtf8("цум")
+};
+
+//Share of terms and definitions written in Cyrillic
+double const cyrillicShare{0.6};
+
+//Definitions are mostly a few hundred bytes, with a long tail;
+//their sizes follow a log-normal distribution, capped
+double const definitionSizeLogMean{6.0};
+double const definitionSizeLogDeviation{1.1};
+int const maxDefinitionSize{64 * 1024};
+
+/**
+ * @brief Corpus::Corpus
+ * Creates a generator of term names and definitions. The
+ * same seed always produces the same corpus.
+ * @param seed the seed of the random numbers
+ */
+Corpus::Corpus(quint32 seed) :
+    mRandom{seed}
+{
+}
+
+/**
+ * @brief Corpus::word
+ * @param cyrillic whether to use Cyrillic or Latin syllables
+ * @param syllables how many syllables the word has
+ * @return a made-up word
+ */
+QString Corpus::word(bool cyrillic, int syllables)
+{
+    QStringList const &alphabet{cyrillic ? cyrillicSyllables : latinSyllables};
+    std::uniform_int_distribution<int> pick{0, alphabet.size() - 1};
+    QString result;
+    for (int i = 0; i < syllables; i++)
+        result += alphabet[pick(mRandom)];
+    return result;
+}
+
+/**
+ * @brief Corpus::termName
+ * @return a term name of one to three words, capitalized
+ * now and then, in either Cyrillic or Latin script
+ */
+QString Corpus::termName()
+{
+    std::bernoulli_distribution cyrillic{cyrillicShare};
+    //Mostly single words, some short phrases
+    std::discrete_distribution<int> words{0, 6, 3, 1};
+    std::uniform_int_distribution<int> syllables{1, 4};
+    std::bernoulli_distribution capitalized{0.2};
+
+    bool const script{cyrillic(mRandom)};
+    QStringList parts;
+    int const count{words(mRandom)};
+    for (int i = 0; i < count; i++)
+        parts << word(script, syllables(mRandom));
+
+    QString name{parts.join(' ')};
+    if (capitalized(mRandom))
+        name[0] = name[0].toUpper();
+    return name;
+}
+
+/**
+ * @brief Corpus::definition
+ * @return a UTF-8 encoded definition made of sentences,
+ * broken into short paragraphs
+ */
+QByteArray Corpus::definition()
+{
+    std::lognormal_distribution<double> size{definitionSizeLogMean, definitionSizeLogDeviation};
+    std::bernoulli_distribution cyrillic{cyrillicShare};
+    std::uniform_int_distribution<int> syllables{1, 4};
+    std::uniform_int_distribution<int> sentence{4, 14};
+
+    int const target{std::min(maxDefinitionSize, static_cast<int>(size(mRandom)))};
+    bool const script{cyrillic(mRandom)};
+
+    QString text;
+    int bytes{0};
+    int sentences{0};
+    while (bytes < target)
+    {
+        QStringList words;
+        int const length{sentence(mRandom)};
+        for (int i = 0; i < length; i++)
+            words << word(script, syllables(mRandom));
+        QString line{words.join(' ') + ". "};
+        line[0] = line[0].toUpper();
+        if (++sentences % 5 == 0)
+            line += "\n\n";
+        text += line;
+        bytes += line.toUtf8().size();
+    }
+    return text.toUtf8();
+}
+
+/**
+ * @brief Corpus::generate
+ * Writes a dictionary of generated terms into a resources
+ * folder. A dictionary generated before with the same size
+ * is reused, since large ones take a while to write.
+ * @param resourcesFolder the folder holding the dictionaries
+ * @param dictionary the dictionary name
+ * @param terms how many terms to generate
+ * @param seed the seed of the random numbers
+ * @return the number of terms in the dictionary, or -1 if
+ * it could not be written
+ */
+int Corpus::generate(QString const &resourcesFolder, QString const &dictionary,
+                     int terms, quint32 seed)
+{
+    QDir{}.mkpath(resourcesFolder + dictionary);
+    Storage const storage{resourcesFolder};
+    PackedTermStore store{storage.packPath(dictionary)};
+    if (!store.open())
+        return -1;
+    if (store.count() >= terms)
+        return store.count();
+
+    Corpus corpus{seed};
+    QSet<QString> names;
+    while (names.size() < terms)
+    {
+        //Tell apart the names that come out the same
+        QString name{corpus.termName()};
+        if (names.contains(name))
+            name += " " + QString::number(names.size());
+        names.insert(name);
+        if (!store.write(name, corpus.definition()))
+            return -1;
+    }
+
+    //Move every term from the tail into the index
+    return store.compact() ? store.count() : -1;
+}
@@ -0,0 +1,26 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <QString>
+#include <QByteArray>
+#include <random>
+
+class Corpus
+{
+public:
+    explicit Corpus(quint32 seed);
+
+    QString termName();
+
+    QByteArray definition();
+
+    static int generate(QString const &resourcesFolder, QString const &dictionary,
+                        int terms, quint32 seed);
+
+private:
+    QString word(bool cyrillic, int syllables);
+
+    std::mt19937 mRandom;
+};
+
+#endif // CORPUS_H
@@ -0,0 +1,320 @@
+#include "chunkeddefinition.h"
+#include "metrics.h"
+#include "textcodec.h"
+
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextEdit>
+
+//Definitions at least this large are edited in chunks
+int const largeDefinitionSize{1024 * 1024};
+
+//Chunks are about this large, and end at a line break
+int const chunkSize{64 * 1024};
+
+//Chunks laid out right away, enough to fill the editor
+int const initialChunks{2};
+
+/**
+ * @brief ChunkedDefinition::ChunkedDefinition
+ * Creates the large-definition mode of an editor. Instead
+ * of laying out the whole definition at once, it is split
+ * into chunks at line breaks, which are added to the editor
+ * as the user scrolls down. Every block of the editor that
+ * starts a chunk has the chunk's index as its user state,
+ * so edits can be traced back to the chunks they touch, and
+ * saving only encodes those again.
+ * @param editor the editor showing the definitions
+ * @param parent
+ */
+ChunkedDefinition::ChunkedDefinition(QTextEdit *editor, QObject *parent) :
+    QObject{parent},
+    mEditor{editor},
+    mLoaded{0},
+    mActive{false},
+    mAppending{false}
+{
+    QObject::connect(mEditor->document(), SIGNAL(contentsChange(int,int,int)),
+                     this, SLOT(markChanged(int,int,int)));
+    QObject::connect(mEditor->verticalScrollBar(), SIGNAL(valueChanged(int)),
+                     this, SLOT(loadMore()));
+}
+
+/**
+ * @brief ChunkedDefinition::isLarge
+ * @param contents a UTF-8 encoded definition
+ * @return whether the definition should be edited in chunks
+ */
+bool ChunkedDefinition::isLarge(QByteArray const &contents)
+{
+    return contents.size() >= largeDefinitionSize;
+}
+
+/**
+ * @brief ChunkedDefinition::split
+ * Copies a definition into chunks ending at line breaks.
+ * A line longer than a chunk stays whole. Splitting copies
+ * the bytes, so the definition may point into a mapped
+ * dictionary that changes afterwards.
+ * @param contents the UTF-8 encoded definition
+ * @return the chunks, in order
+ */
+QVector<QByteArray> ChunkedDefinition::split(QByteArray const &contents)
+{
+    ScopedTimer const timer{Metrics::ChunkedDefinitionSplit};
+    QVector<QByteArray> chunks;
+    chunks.reserve(contents.size() / chunkSize + 1);
+    int start{0};
+    while (start < contents.size())
+    {
+        int const end{contents.indexOf('\n', start + chunkSize - 1)};
+        int const length{(end == -1 ? contents.size() : end + 1) - start};
+        chunks.push_back(QByteArray{contents.constData() + start, length});
+        start += length;
+    }
+    if (chunks.isEmpty())
+        chunks.push_back(QByteArray{});
+    return chunks;
+}
+
+/**
+ * @brief ChunkedDefinition::load
+ * Shows a large definition, laying out only its first
+ * chunks. Undo is turned off while the definition is
+ * shown, since undoing the addition of a chunk would
+ * remove it from the definition.
+ * @param chunks the definition, as returned by split()
+ */
+void ChunkedDefinition::load(QVector<QByteArray> const &chunks)
+{
+    ScopedTimer const timer{Metrics::ChunkedDefinitionLoad};
+    mActive = false;
+    mEditor->document()->setUndoRedoEnabled(false);
+    mEditor->clear();
+
+    mChunks = chunks;
+    mDirty.fill(false, mChunks.size());
+    mCrlf.resize(mChunks.size());
+    for (int i = 0; i < mChunks.size(); i++)
+    {
+        int const lineEnd{mChunks[i].indexOf('\n')};
+        mCrlf[i] = lineEnd > 0 && mChunks[i][lineEnd - 1] == '\r';
+    }
+    mLoaded = 0;
+    mActive = true;
+    for (int i = 0; i < initialChunks; i++)
+        appendChunk();
+    mEditor->moveCursor(QTextCursor::Start);
+}
+
+/**
+ * @brief ChunkedDefinition::clear
+ * Leaves the large-definition mode, so that the editor
+ * can show a definition as a whole.
+ */
+void ChunkedDefinition::clear()
+{
+    if (!mActive)
+        return;
+
+    mActive = false;
+    mChunks.clear();
+    mDirty.clear();
+    mCrlf.clear();
+    mLoaded = 0;
+    mEditor->document()->setUndoRedoEnabled(true);
+}
+
+/**
+ * @brief ChunkedDefinition::isActive
+ * @return whether the editor shows a large definition
+ */
+bool ChunkedDefinition::isActive() const
+{
+    return mActive;
+}
+
+/**
+ * @brief ChunkedDefinition::isModified
+ * @return whether any chunk was edited since the
+ * definition was loaded or last saved
+ */
+bool ChunkedDefinition::isModified() const
+{
+    return mDirty.contains(true);
+}
+
+/**
+ * @brief ChunkedDefinition::appendChunk
+ * Adds the next chunk at the end of the editor. The line
+ * break ending a chunk is what separates it from the next
+ * one, so it becomes the start of a new block instead. A
+ * CRLF is taken off as a whole, or its CR would make a
+ * block of its own. Tells whether the chunk is not valid
+ * UTF-8 through invalidText().
+ */
+void ChunkedDefinition::appendChunk()
+{
+    if (mLoaded >= mChunks.size())
+        return;
+
+    QByteArray const &chunk{mChunks[mLoaded]};
+    int length{chunk.size()};
+    if (mLoaded < mChunks.size() - 1 && chunk.endsWith("\r\n"))
+        length -= 2;
+    else if (mLoaded < mChunks.size() - 1 && chunk.endsWith('\n'))
+        length -= 1;
+
+    QTextDocument *document{mEditor->document()};
+    bool const modified{document->isModified()};
+    mAppending = true;
+    QTextCursor cursor{document};
+    cursor.movePosition(QTextCursor::End);
+    if (mLoaded > 0)
+        cursor.insertBlock();
+    cursor.block().setUserState(mLoaded);
+    //Invalid bytes are shown as replacement characters, which
+    //replace them in the pack only if the chunk is edited
+    bool const valid{TextCodec::decode(chunk.constData(), length, mDecoded)};
+    cursor.insertText(mDecoded);
+    mAppending = false;
+    document->setModified(modified);
+    mLoaded++;
+    if (!valid)
+        emit invalidText();
+}
+
+/**
+ * @brief ChunkedDefinition::loadMore
+ * Adds the next chunk once the user scrolls close to the
+ * end of those already in the editor.
+ */
+void ChunkedDefinition::loadMore()
+{
+    if (!mActive || mLoaded >= mChunks.size())
+        return;
+
+    QScrollBar const *scrollBar{mEditor->verticalScrollBar()};
+    if (scrollBar->value() >= scrollBar->maximum() - scrollBar->pageStep())
+        appendChunk();
+}
+
+/**
+ * @brief ChunkedDefinition::chunkOf
+ * @param block a block of the editor
+ * @return the chunk the block belongs to, which is that
+ * of the closest block starting a chunk at or above it
+ */
+int ChunkedDefinition::chunkOf(QTextBlock block) const
+{
+    while (block.isValid() && block.userState() < 0)
+        block = block.previous();
+    return block.isValid() ? block.userState() : 0;
+}
+
+/**
+ * @brief ChunkedDefinition::markChanged
+ * Marks the chunks touched by an edit. Removing text may
+ * take away the block starting a chunk, so every chunk up
+ * to the next block still starting one is marked.
+ * @param position where the edit happened
+ * @param removed the number of characters removed
+ * @param added the number of characters added
+ */
+void ChunkedDefinition::markChanged(int position, int removed, int added)
+{
+    Q_UNUSED(removed)
+    if (!mActive || mAppending)
+        return;
+
+    QTextDocument const *document{mEditor->document()};
+    QTextBlock last{document->findBlock(position + added)};
+    if (!last.isValid())
+        last = document->lastBlock();
+
+    int const firstChunk{chunkOf(document->findBlock(position))};
+    int lastChunk{chunkOf(last)};
+    int nextChunk{mLoaded};
+    for (QTextBlock block = last.next(); block.isValid(); block = block.next())
+        if (block.userState() > lastChunk)
+        {
+            nextChunk = block.userState();
+            break;
+        }
+
+    for (int i = firstChunk; i < nextChunk; i++)
+        mDirty[i] = true;
+}
+
+/**
+ * @brief ChunkedDefinition::parts
+ * Returns the definition as it is in the editor, with the
+ * chunks not edited as they were loaded. Only the edited
+ * chunks are encoded again, walking the blocks no further
+ * than the last of them, and they become the new chunks.
+ * Their lines end the way they did when loaded.
+ * @param delta set to the splices replacing the edited
+ * chunks, so that only they need to be written
+ * @return the chunks of the definition, in order
+ */
+TermStore::Parts ChunkedDefinition::parts(TermStore::Delta &delta)
+{
+    delta.clear();
+    ScopedTimer const timer{Metrics::ChunkedDefinitionParts};
+    if (!mActive)
+        return TermStore::Parts{};
+
+    auto const lineBreak = [this](int chunk) {
+        return QByteArray{mCrlf[chunk] ? "\r\n" : "\n"};
+    };
+
+    int const lastDirty{mDirty.lastIndexOf(true)};
+    QVector<QByteArray> encoded(lastDirty + 1);
+    int chunk{0};
+    bool runStarted{false};
+    QTextBlock block{mEditor->document()->begin()};
+    for (; block.isValid() && lastDirty != -1; block = block.next())
+    {
+        int const state{block.userState()};
+        if (state >= 0 && state != chunk)
+        {
+            //The previous chunk ended with a line break
+            if (mDirty[chunk])
+                encoded[chunk] += lineBreak(chunk);
+            chunk = state;
+            runStarted = false;
+            if (chunk > lastDirty)
+                break;
+        }
+        if (mDirty[chunk])
+        {
+            if (runStarted)
+                encoded[chunk] += lineBreak(chunk);
+            QString const text{block.text()};
+            TextCodec::append(text.constData(), text.size(), encoded[chunk]);
+        }
+        runStarted = true;
+    }
+    //The last chunk in the editor ends with a line break
+    //unless it is the last chunk of the definition
+    if (!block.isValid() && lastDirty != -1 && mDirty[chunk] && mLoaded < mChunks.size())
+        encoded[chunk] += lineBreak(chunk);
+
+    //Each splice starts after the chunks before it, as
+    //left by the splices before it
+    quint32 offset{0};
+    for (int i = 0; i <= lastDirty; i++)
+    {
+        if (mDirty[i])
+        {
+            delta.push_back(TermStore::Splice{offset, static_cast<quint32>(mChunks[i].size()),
+                                              encoded[i]});
+            mChunks[i] = encoded[i];
+            mDirty[i] = false;
+        }
+        offset += static_cast<quint32>(mChunks[i].size());
+    }
+    return mChunks;
+}
@@ -0,0 +1,64 @@
+#ifndef CHUNKEDDEFINITION_H
+#define CHUNKEDDEFINITION_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "termstore.h"
+
+class QTextEdit;
+class QTextBlock;
+
+class ChunkedDefinition : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChunkedDefinition(QTextEdit *editor, QObject *parent = nullptr);
+
+    static bool isLarge(QByteArray const &contents);
+
+    static QVector<QByteArray> split(QByteArray const &contents);
+
+    void load(QVector<QByteArray> const &chunks);
+
+    void clear();
+
+    bool isActive() const;
+
+    bool isModified() const;
+
+    TermStore::Parts parts(TermStore::Delta &delta);
+
+signals:
+    //Do not implement signals
+    void invalidText();
+
+private slots:
+    void loadMore();
+
+    void markChanged(int position, int removed, int added);
+
+private:
+    void appendChunk();
+
+    int chunkOf(QTextBlock block) const;
+
+    QTextEdit *mEditor;
+    //The definition, split at line breaks
+    QVector<QByteArray> mChunks;
+    //Chunks edited since they were loaded or last saved
+    QVector<bool> mDirty;
+    //Chunks whose lines end with CRLF, which the editor turns
+    //into plain line breaks, so they are put back when encoding
+    QVector<bool> mCrlf;
+    //Chunks laid out in the editor, the rest wait for scrolling
+    int mLoaded;
+    //Reused for decoding each chunk as it is laid out
+    QString mDecoded;
+    bool mActive;
+    bool mAppending;
+};
+
+#endif // CHUNKEDDEFINITION_H
@@ -0,0 +1,323 @@
+#include "commandline.h"
+#include "storage.h"
+#include "termstore.h"
+#include "fulltextindex.h"
+#include "dictionaryfile.h"
+#include "configuration.h"
+#include "textcodec.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+//All the dictionaries are saved in the resources folder, unless
+//another one is given with --resources
+QString const defaultResourcesFolder{"resources/"};
+
+//The full-text index, inside the resources folder
+QString const fullTextIndexFileName{"fulltext.idx"};
+
+//Show at most this many full-text results, unless --limit says otherwise
+int const defaultSearchLimit{20};
+
+//The commands, the first argument selects one of them
+char const *const commands[]{"dictionaries", "lookup", "list", "search", "import", "export", "help"};
+
+/**
+ * @brief CommandLine::CommandLine
+ * Creates a command-line session writing UTF-8 to the
+ * standard output and error.
+ */
+CommandLine::CommandLine() :
+    mOut{stdout},
+    mErr{stderr},
+    mResourcesFolder{defaultResourcesFolder}
+{
+    mOut.setCodec(TextCodec::codec());
+    mErr.setCodec(TextCodec::codec());
+}
+
+/**
+ * @brief CommandLine::isCommand
+ * Tells whether the program was started with a command,
+ * in which case it runs without a window.
+ * @param argc the number of arguments
+ * @param argv the arguments, the first being the program
+ * @return whether the first argument is a command
+ */
+bool CommandLine::isCommand(int argc, char *argv[])
+{
+    if (argc < 2)
+        return false;
+    if (std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "--resources") == 0)
+        return true;
+    for (char const *command: commands)
+        if (std::strcmp(argv[1], command) == 0)
+            return true;
+    return false;
+}
+
+/**
+ * @brief CommandLine::run
+ * Runs the command given in the arguments.
+ * @param arguments the arguments, without the program
+ * @return the exit status
+ */
+int CommandLine::run(QStringList arguments)
+{
+    //Options may appear anywhere after the command
+    int limit{defaultSearchLimit};
+    QString dictionary;
+    for (int i = 0; i < arguments.size(); i++)
+    {
+        QString const option{arguments[i]};
+        if (option != "--resources" && option != "--limit" && option != "--dictionary")
+            continue;
+        if (i + 1 >= arguments.size())
+            return usage(2);
+
+        QString const value{arguments.takeAt(i + 1)};
+        arguments.removeAt(i--);
+        if (option == "--resources")
+            mResourcesFolder = value.endsWith('/') ? value : value + "/";
+        else if (option == "--dictionary")
+            dictionary = value;
+        else
+        {
+            bool ok{false};
+            limit = value.toInt(&ok);
+            if (!ok || limit <= 0)
+                return usage(2);
+        }
+    }
+
+    if (arguments.isEmpty() || arguments[0] == "help" || arguments[0] == "--help")
+        return usage(arguments.isEmpty() ? 2 : 0);
+
+    Storage storage{mResourcesFolder};
+    storage.setCompression(Configuration::compression());
+    QString const command{arguments.takeFirst()};
+    if (command == "dictionaries")
+        return listDictionaries(storage);
+    if (command == "lookup" && !arguments.isEmpty())
+        return lookUp(storage, arguments[0], arguments.mid(1));
+    if (command == "list" && !arguments.isEmpty())
+        return listTerms(storage, arguments[0], arguments.value(1));
+    if (command == "search" && !arguments.isEmpty())
+        return search(storage, arguments.join(' '), dictionary, limit);
+    if ((command == "import" || command == "export") && arguments.size() == 2)
+        return transfer(storage, command == "import", arguments[0], arguments[1]);
+    return usage(2);
+}
+
+/**
+ * @brief CommandLine::usage
+ * Describes the commands.
+ * @param status the exit status to return
+ * @return the exit status
+ */
+int CommandLine::usage(int status)
+{
+    QTextStream &stream{status == 0 ? mOut : mErr};
+    stream << "Usage: NoteSpisok <command> [--resources <folder>]\n"
+              "\n"
+              "Commands:\n"
+              "  dictionaries                  list the dictionaries\n"
+              "  lookup <dictionary> [term...] print the definitions of the terms, or of\n"
+              "                                every term read from the standard input,\n"
+              "                                one per line, as: term<TAB>definition\n"
+              "  list <dictionary> [prefix]    list the terms starting with prefix\n"
+              "  search <words...>             list the terms whose definitions contain\n"
+              "                                every word, best first, as:\n"
+              "                                dictionary<TAB>term<TAB>score\n"
+              "    --dictionary <dictionary>   only search one dictionary\n"
+              "    --limit <count>             show at most count terms\n"
+              "  import <dictionary> <file>    add the terms of a file to a dictionary,\n"
+              "                                creating it if needed\n"
+              "  export <dictionary> <file>    write every term of a dictionary to a file\n"
+              "\n"
+              "Definitions are printed on one line, with backslashes, tabs,\n"
+              "and line breaks written as \\\\, \\t, and \\n.\n"
+              "Files ending in .tsv or .txt hold one term<TAB>definition per\n"
+              "line, escaped the same way; files ending in .jsonl hold one\n"
+              "{\"term\": ..., \"definition\": ...} object per line; and files\n"
+              "ending in .ifo are StarDict dictionaries, next to their .idx and\n"
+              ".dict files.\n"
+              "Without a command, the window is opened.\n";
+    stream.flush();
+    return status;
+}
+
+/**
+ * @brief CommandLine::listDictionaries
+ * @param storage the storage holding the dictionaries
+ * @return the exit status
+ */
+int CommandLine::listDictionaries(Storage &storage)
+{
+    for (QString const &dictionary: storage.dictionaries())
+        mOut << dictionary << "\n";
+    mOut.flush();
+    return 0;
+}
+
+/**
+ * @brief CommandLine::lookUp
+ * Prints the definitions of the given terms, or of the terms
+ * read from the standard input. Each definition is written as
+ * soon as it is found, so the command can serve a pipeline.
+ * @param storage the storage holding the dictionaries
+ * @param dictionary the dictionary name
+ * @param terms the term names, if any
+ * @return the exit status, 1 if a term was not found
+ */
+int CommandLine::lookUp(Storage &storage, QString const &dictionary, QStringList const &terms)
+{
+    QSharedPointer<TermStore> const store{storage.store(dictionary)};
+    if (store.isNull())
+    {
+        mErr << "No such dictionary: " << dictionary << "\n";
+        mErr.flush();
+        return 2;
+    }
+
+    int status{0};
+    auto const print = [&](QString const &term) {
+        QByteArray contents;
+        if (!store->view(term, contents))
+        {
+            mErr << "Not found: " << term << "\n";
+            mErr.flush();
+            status = 1;
+            return;
+        }
+        //The definition is UTF-8 already, so it is written as it is
+        mOut << term << "\t";
+        mOut.flush();
+        mOut.device()->write(DictionaryFile::escape(contents));
+        mOut << "\n";
+    };
+
+    if (!terms.isEmpty())
+    {
+        for (QString const &term: terms)
+            print(term);
+        mOut.flush();
+        return status;
+    }
+
+    //Answer each line before reading the next, so that a
+    //script can write a term and wait for its definition
+    QTextStream in{stdin};
+    in.setCodec(TextCodec::codec());
+    QString term;
+    while (in.readLineInto(&term))
+    {
+        if (term == "")
+            continue;
+        print(term);
+        mOut.flush();
+    }
+    mOut.flush();
+    return status;
+}
+
+/**
+ * @brief CommandLine::listTerms
+ * Prints the terms of a dictionary starting with a prefix,
+ * ignoring case, in the same order as the term list.
+ * @param storage the storage holding the dictionaries
+ * @param dictionary the dictionary name
+ * @param prefix the beginning of the term names
+ * @return the exit status
+ */
+int CommandLine::listTerms(Storage &storage, QString const &dictionary, QString const &prefix)
+{
+    QSharedPointer<TermStore> const store{storage.store(dictionary)};
+    if (store.isNull())
+    {
+        mErr << "No such dictionary: " << dictionary << "\n";
+        mErr.flush();
+        return 2;
+    }
+
+    QStringList const terms{store->terms()};
+
+    //The terms are sorted ignoring case, so the matches are
+    //the run starting at the first term not before the prefix
+    auto term = std::lower_bound(terms.constBegin(), terms.constEnd(), prefix,
+                                 [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    for (; term != terms.constEnd() && term->startsWith(prefix, Qt::CaseInsensitive); ++term)
+        mOut << *term << "\n";
+    mOut.flush();
+    return 0;
+}
+
+/**
+ * @brief CommandLine::search
+ * Prints the terms whose definitions contain every word of
+ * the query. The full-text index is brought up to date first,
+ * and saved if anything changed.
+ * @param storage the storage holding the dictionaries
+ * @param query the words to look for
+ * @param dictionary only search this dictionary, if given
+ * @param limit the maximum number of terms
+ * @return the exit status, 1 if nothing was found
+ */
+int CommandLine::search(Storage &storage, QString const &query,
+                        QString const &dictionary, int limit)
+{
+    FullTextIndex index{mResourcesFolder + fullTextIndexFileName};
+    index.load();
+    if (index.synchronize(&storage))
+    {
+        storage.closeAll();
+        index.save(&storage);
+    }
+
+    //Ask for every hit when only one dictionary is wanted
+    int found{0};
+    for (FullTextIndex::Hit const &hit: index.search(query, dictionary == "" ? limit : INT_MAX))
+    {
+        if (dictionary != "" && hit.dictionary != dictionary)
+            continue;
+        mOut << hit.dictionary << "\t" << hit.term << "\t"
+             << QString::number(hit.score, 'f', 3) << "\n";
+        if (++found == limit)
+            break;
+    }
+    mOut.flush();
+    return found > 0 ? 0 : 1;
+}
+
+/**
+ * @brief CommandLine::transfer
+ * Imports a file into a dictionary, creating the dictionary
+ * if it does not exist, or exports a dictionary to a file.
+ * @param storage the storage holding the dictionaries
+ * @param importing whether to import rather than export
+ * @param dictionary the dictionary name
+ * @param path the file to read or write
+ * @return the exit status
+ */
+int CommandLine::transfer(Storage &storage, bool importing, QString const &dictionary,
+                          QString const &path)
+{
+    if (importing && !storage.dictionaries().contains(dictionary))
+        storage.createDictionary(dictionary);
+
+    DictionaryFile::Result const result{importing ?
+                DictionaryFile::importFile(&storage, dictionary, path) :
+                DictionaryFile::exportFile(&storage, dictionary, path)};
+    if (result.skipped > 0)
+        mErr << "Skipped " << result.skipped << " entries\n";
+    if (result.error != "")
+        mErr << result.error << "\n";
+    mErr.flush();
+    mOut << (importing ? "Imported " : "Exported ") << result.terms << " terms\n";
+    mOut.flush();
+    return result.error == "" ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+class Storage;
+
+class CommandLine
+{
+public:
+    CommandLine();
+
+    static bool isCommand(int argc, char *argv[]);
+
+    int run(QStringList arguments);
+
+private:
+    int listDictionaries(Storage &storage);
+
+    int lookUp(Storage &storage, QString const &dictionary, QStringList const &terms);
+
+    int listTerms(Storage &storage, QString const &dictionary, QString const &prefix);
+
+    int search(Storage &storage, QString const &query, QString const &dictionary, int limit);
+
+    int usage(int status);
+
+    int transfer(Storage &storage, bool importing, QString const &dictionary, QString const &path);
+
+    QTextStream mOut;
+    QTextStream mErr;
+    QString mResourcesFolder;
+};
+
+#endif // COMMANDLINE_H
@@ -1,14 +1,58 @@
 #include "configuration.h"
 #include "ui_configuration.h"
+#include <QSettings>
+
+//The settings are kept next to the dictionaries
+QString const settingsFile{"resources/settings.ini"};
+
+//Megabytes of decoded definitions kept in memory by default
+int const defaultCacheBudget{32};
 
 Configuration::Configuration(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::Configuration)
 {
     ui->setupUi(this);
+
+    QSettings const settings{settingsFile, QSettings::IniFormat};
+    ui->spinBoxCacheBudget->setValue(settings.value("cache/budget", defaultCacheBudget).toInt());
+    ui->checkBoxCompression->setChecked(settings.value("storage/compression", false).toBool());
 }
 
 Configuration::~Configuration()
 {
     delete ui;
 }
+
+/**
+ * @brief Configuration::cacheBudget
+ * @return the memory budget of the definition cache in bytes
+ */
+int Configuration::cacheBudget()
+{
+    QSettings const settings{settingsFile, QSettings::IniFormat};
+    return settings.value("cache/budget", defaultCacheBudget).toInt() * 1024 * 1024;
+}
+
+/**
+ * @brief Configuration::compression
+ * @return whether definitions are stored compressed
+ */
+bool Configuration::compression()
+{
+    QSettings const settings{settingsFile, QSettings::IniFormat};
+    return settings.value("storage/compression", false).toBool();
+}
+
+/**
+ * @brief Configuration::on_buttonBox_accepted
+ * Saves the settings and tells the program to apply them.
+ */
+void Configuration::on_buttonBox_accepted()
+{
+    QSettings settings{settingsFile, QSettings::IniFormat};
+    settings.setValue("cache/budget", ui->spinBoxCacheBudget->value());
+    settings.setValue("storage/compression", ui->checkBoxCompression->isChecked());
+    settings.sync();
+    emit settingsChanged();
+}
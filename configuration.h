@@ -15,6 +15,17 @@ public:
     explicit Configuration(QWidget *parent = nullptr);
     ~Configuration();
 
+    static int cacheBudget();
+
+    static bool compression();
+
+signals:
+    //Do not implement signals
+    void settingsChanged();
+
+private slots:
+    void on_buttonBox_accepted();
+
 private:
     Ui::Configuration *ui;
 };
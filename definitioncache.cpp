@@ -0,0 +1,195 @@
+#include "definitioncache.h"
+#include "storage.h"
+#include "termstore.h"
+#include "saveengine.h"
+#include "chunkeddefinition.h"
+#include "textcodec.h"
+
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+/**
+ * @brief DefinitionCache::DefinitionCache
+ * Creates a cache that keeps the most recently used
+ * decoded definitions within a memory budget.
+ * @param budget the budget in bytes
+ */
+DefinitionCache::DefinitionCache(int budget) :
+    mDefinitions{budget},
+    mVersion{0},
+    mGeneration{0}
+{
+}
+
+/**
+ * @brief DefinitionCache::~DefinitionCache
+ * Waits for the prefetcher to stop.
+ */
+DefinitionCache::~DefinitionCache()
+{
+    stopPrefetching();
+}
+
+/**
+ * @brief DefinitionCache::cost
+ * @param definition a decoded definition
+ * @return roughly how many bytes it takes in the cache
+ */
+int DefinitionCache::cost(QString const &definition)
+{
+    return static_cast<int>(sizeof(QString)) + definition.size() * static_cast<int>(sizeof(QChar));
+}
+
+/**
+ * @brief DefinitionCache::setBudget
+ * Changes the memory budget, dropping the least recently
+ * used definitions if it shrinks.
+ * @param budget the budget in bytes
+ */
+void DefinitionCache::setBudget(int budget)
+{
+    QMutexLocker locker{&mMutex};
+    mDefinitions.setMaxCost(budget);
+}
+
+/**
+ * @brief DefinitionCache::find
+ * Looks up a definition and marks it as recently used.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param definition set to the definition, if cached
+ * @return whether the definition is cached
+ */
+bool DefinitionCache::find(QString const &dictionary, QString const &term, QString &definition)
+{
+    QMutexLocker locker{&mMutex};
+    QString const *cached{mDefinitions.object(Key{dictionary, term})};
+    if (cached == nullptr)
+        return false;
+    definition = *cached;
+    return true;
+}
+
+/**
+ * @brief DefinitionCache::insert
+ * Caches a definition that has just been read or saved.
+ * A definition larger than the whole budget is not kept.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param definition the decoded definition
+ */
+void DefinitionCache::insert(QString const &dictionary, QString const &term,
+                             QString const &definition)
+{
+    QMutexLocker locker{&mMutex};
+    mVersion++;
+    mDefinitions.insert(Key{dictionary, term}, new QString{definition}, cost(definition));
+}
+
+/**
+ * @brief DefinitionCache::remove
+ * Forgets the definition of a deleted or renamed term.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ */
+void DefinitionCache::remove(QString const &dictionary, QString const &term)
+{
+    QMutexLocker locker{&mMutex};
+    mVersion++;
+    mDefinitions.remove(Key{dictionary, term});
+}
+
+/**
+ * @brief DefinitionCache::clear
+ * Forgets every definition, after dictionaries have been
+ * renamed or deleted.
+ */
+void DefinitionCache::clear()
+{
+    QMutexLocker locker{&mMutex};
+    mVersion++;
+    mDefinitions.clear();
+}
+
+/**
+ * @brief DefinitionCache::prefetch
+ * Starts reading the given definitions into the cache in the
+ * background, abandoning any prefetch still running. Those
+ * already cached are skipped, and the first ones are read first.
+ * @param storage the storage holding the dictionaries
+ * @param saveEngine the engine whose queued saves are newer
+ * than the stored definitions
+ * @param keys the dictionaries and terms likely viewed next
+ */
+void DefinitionCache::prefetch(Storage *storage, SaveEngine *saveEngine, QList<Key> const &keys)
+{
+    int const generation{mGeneration.fetchAndAddOrdered(1) + 1};
+
+    //Abandoned prefetches stop at their next key, but are kept
+    //until they do so that stopPrefetching() can wait for them
+    QList<QFuture<void>> const prefetches{mPrefetches.futures()};
+    mPrefetches.clearFutures();
+    for (QFuture<void> const &prefetch: prefetches)
+        if (!prefetch.isFinished())
+            mPrefetches.addFuture(prefetch);
+    mPrefetches.addFuture(QtConcurrent::run(this, &DefinitionCache::run, storage, saveEngine,
+                                            keys, generation));
+}
+
+/**
+ * @brief DefinitionCache::stopPrefetching
+ * Abandons every running prefetch and waits for them.
+ */
+void DefinitionCache::stopPrefetching()
+{
+    mGeneration.fetchAndAddOrdered(1);
+    mPrefetches.waitForFinished();
+    mPrefetches.clearFutures();
+}
+
+/**
+ * @brief DefinitionCache::run
+ * Reads definitions into the cache. Runs on a worker thread.
+ * @param storage the storage holding the dictionaries
+ * @param saveEngine the engine holding the queued saves
+ * @param keys the dictionaries and terms to read
+ * @param generation the prefetch this run belongs to
+ */
+void DefinitionCache::run(Storage *storage, SaveEngine *saveEngine,
+                          QList<Key> const &keys, int generation)
+{
+    for (Key const &key: keys)
+    {
+        if (generation != mGeneration.loadAcquire())
+            return;
+
+        QMutexLocker locker{&mMutex};
+        if (mDefinitions.contains(key))
+            continue;
+        quint64 const version{mVersion};
+        locker.unlock();
+
+        //A queued save is newer than what the dictionary holds
+        QByteArray contents;
+        if (!saveEngine->pending(key.first, key.second, contents))
+        {
+            QSharedPointer<TermStore> const store{storage->store(key.first)};
+            if (store.isNull() || !store->read(key.second, contents))
+                continue;
+        }
+
+        //Large definitions are shown in chunks, never from the cache
+        if (ChunkedDefinition::isLarge(contents))
+            continue;
+        //Definitions that are not valid UTF-8 are decoded when
+        //viewed, so that the user is told about them
+        QString definition;
+        if (!TextCodec::decode(contents, definition))
+            continue;
+
+        //Drop the definition if it was saved or removed meanwhile
+        locker.relock();
+        if (version == mVersion && !mDefinitions.contains(key))
+            mDefinitions.insert(key, new QString{definition}, cost(definition));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef DEFINITIONCACHE_H
+#define DEFINITIONCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureSynchronizer>
+
+class Storage;
+class SaveEngine;
+
+class DefinitionCache
+{
+public:
+    typedef QPair<QString, QString> Key;
+
+    explicit DefinitionCache(int budget);
+    ~DefinitionCache();
+
+    void setBudget(int budget);
+
+    bool find(QString const &dictionary, QString const &term, QString &definition);
+
+    void insert(QString const &dictionary, QString const &term, QString const &definition);
+
+    void remove(QString const &dictionary, QString const &term);
+
+    void clear();
+
+    void prefetch(Storage *storage, SaveEngine *saveEngine, QList<Key> const &keys);
+
+    void stopPrefetching();
+
+private:
+    void run(Storage *storage, SaveEngine *saveEngine, QList<Key> const &keys, int generation);
+
+    static int cost(QString const &definition);
+
+    QMutex mMutex;
+    QCache<Key, QString> mDefinitions;
+    //Changed whenever the interface updates or removes a definition
+    quint64 mVersion;
+    QAtomicInt mGeneration;
+    //Every prefetch still running, abandoned ones included
+    QFutureSynchronizer<void> mPrefetches;
+};
+
+#endif // DEFINITIONCACHE_H
@@ -1,21 +1,38 @@
 #include "dictionaries.h"
 #include "ui_dictionaries.h"
 #include "mainwindow.h"
+#include "storage.h"
+#include "dictionarytask.h"
 
-#include <QDir>
-#include <QFileInfo>
 #include <QDebug>
 
-QString const resourcesFolder{"resources/"};
-QString const historyFile{"resources/history.txt"};
-QString const temporaryFile{"resources/temp.txt"};
-
-Dictionaries::Dictionaries(QWidget *parent) :
+/**
+ * @brief Dictionaries::Dictionaries
+ * Creates the window and loads the term folders.
+ * @param storage the storage holding the dictionaries
+ * @param task renames and deletes dictionaries in the background
+ * @param parent
+ */
+Dictionaries::Dictionaries(Storage *storage, DictionaryTask *task, QWidget *parent) :
     QDialog{parent},
-    ui{new Ui::Dictionaries}
+    ui{new Ui::Dictionaries},
+    mStorage{storage},
+    mTask{task}
 {
     ui->setupUi(this);
 
+    //Only the entry affected by each task is updated
+    QObject::connect(mTask, SIGNAL(renamed(QString,QString,bool)),
+                     this, SLOT(finishRenaming(QString,QString,bool)));
+    QObject::connect(mTask, SIGNAL(removed(QString,bool)), this, SLOT(finishDeleting(QString,bool)));
+    QObject::connect(mTask, SIGNAL(progress(int,int)), this, SLOT(showProgress(int,int)));
+    QObject::connect(mTask, SIGNAL(reclaimed(bool)), this, SLOT(finishReclaiming()));
+
+    //The progress bar is only shown while files are removed
+    ui->progressBar->hide();
+    ui->pushButtonStop->hide();
+    setTaskRunning(mTask->isRunning());
+
     loadTermFolders();
 }
 
@@ -31,33 +48,54 @@ Dictionaries::~Dictionaries()
  */
 void Dictionaries::loadTermFolders()
 {
-    //Open the resources folder
-    //Add the folders to the list widget
-    QDir dictionaries{resourcesFolder};
-    for (QFileInfo item: dictionaries.entryInfoList())
-        if (item.isDir() && item.baseName() != "")
-            ui->listWidget->addItem(item.baseName());
+    //Add the dictionaries listed by the storage
+    //to the list widget
+    ui->listWidget->addItems(mStorage->dictionaries());
+}
+
+/**
+ * @brief Dictionaries::insertDictionary
+ * Adds a dictionary to the list widget, keeping the
+ * list sorted the way the storage sorts it.
+ * @param dictionary the dictionary name
+ */
+void Dictionaries::insertDictionary(QString const &dictionary)
+{
+    int row{0};
+    while (row < ui->listWidget->count() &&
+           QString::compare(ui->listWidget->item(row)->text(), dictionary, Qt::CaseInsensitive) < 0)
+        row++;
+    ui->listWidget->insertItem(row, dictionary);
+}
+
+/**
+ * @brief Dictionaries::setTaskRunning
+ * Disables renaming and deleting while a dictionary
+ * is being renamed or deleted.
+ * @param running whether a task is running
+ */
+void Dictionaries::setTaskRunning(bool running)
+{
+    ui->pushButtonRename->setEnabled(!running);
+    ui->pushButtonDelete->setEnabled(!running);
 }
 
 /**
  * @brief Dictionaries::on_pushButtonAdd_clicked
  * Adds a new term folder to the resources folder
  * and sends a signal to the main window to
- * update the term folders.
+ * add it to its dictionaries.
  */
 void Dictionaries::on_pushButtonAdd_clicked()
 {
     QString newFolderName{ui->lineEdit->text()};
 
-    QDir newTermFolder{resourcesFolder + newFolderName};
-    if (!newTermFolder.exists())
-        //Go to the parent folder and create the folder
-        newTermFolder.mkdir("../" + newFolderName);
+    //Create the folder unless it already exists
+    if (!mStorage->createDictionary(newFolderName))
+        return;
 
-    //Clear the list widget and reload it
-    ui->listWidget->clear();
-    loadTermFolders();
-    emit signalLoadTermFolders();
+    insertDictionary(newFolderName);
+    emit dictionaryAdded(newFolderName);
 }
 
 /**
@@ -82,7 +120,9 @@ void Dictionaries::on_pushButtonDelete_clicked()
 
 /**
  * @brief Dictionaries::deleteDictionary
- * Deletes the selected dictionary and all of its contents.
+ * Starts deleting the selected dictionary and all of its
+ * contents. The dictionary disappears at once; its files
+ * are removed in the background.
  */
 void Dictionaries::deleteDictionary()
 {
@@ -91,16 +131,63 @@ void Dictionaries::deleteDictionary()
     {
         QString folderToDelete{ui->listWidget->currentItem()->text()};
 
-        QDir folderPath{resourcesFolder + folderToDelete};
+        //Close the dictionary and turn its folder into a tombstone
+        if (mTask->remove(folderToDelete))
+            setTaskRunning(true);
+    }
+}
 
-        if (folderPath.exists())
-            //Go to the parent folder and delete the folder
-            folderPath.removeRecursively();
-        //Clear the list widget and reload it
-        ui->listWidget->clear();
-        loadTermFolders();
-        emit signalLoadTermFolders();
+/**
+ * @brief Dictionaries::finishDeleting
+ * Removes a deleted dictionary from the list widget.
+ * @param dictionary the dictionary name
+ * @param succeeded whether the dictionary was deleted
+ */
+void Dictionaries::finishDeleting(QString const &dictionary, bool succeeded)
+{
+    if (!succeeded)
+    {
+        setTaskRunning(false);
+        return;
     }
+
+    for (QListWidgetItem *item: ui->listWidget->findItems(dictionary, Qt::MatchExactly))
+        delete item;
+}
+
+/**
+ * @brief Dictionaries::showProgress
+ * Shows how many files of deleted dictionaries are removed.
+ * @param removedFiles the files removed so far
+ * @param totalFiles the files to remove
+ */
+void Dictionaries::showProgress(int removedFiles, int totalFiles)
+{
+    ui->progressBar->setMaximum(totalFiles);
+    ui->progressBar->setValue(removedFiles);
+    ui->progressBar->show();
+    ui->pushButtonStop->show();
+}
+
+/**
+ * @brief Dictionaries::on_pushButtonStop_clicked
+ * Stops removing files. The deleted dictionaries stay
+ * deleted, their remaining files are removed next time.
+ */
+void Dictionaries::on_pushButtonStop_clicked()
+{
+    mTask->cancel();
+}
+
+/**
+ * @brief Dictionaries::finishReclaiming
+ * Hides the progress bar once the files are removed.
+ */
+void Dictionaries::finishReclaiming()
+{
+    ui->progressBar->hide();
+    ui->pushButtonStop->hide();
+    setTaskRunning(false);
 }
 
 /**
@@ -131,13 +218,25 @@ void Dictionaries::renameDictionary(QString const &newName)
 {
     QString currentName{ui->listWidget->currentItem()->text()};
 
-    QDir parentDirectory;
+    //Close the dictionary and rename its folder
+    if (mTask->rename(currentName, newName))
+        setTaskRunning(true);
+}
 
-    parentDirectory.cd(resourcesFolder);
-    parentDirectory.rename(currentName, newName);
+/**
+ * @brief Dictionaries::finishRenaming
+ * Replaces the name of a renamed dictionary in the list widget.
+ * @param dictionary the previous dictionary name
+ * @param newName the new dictionary name
+ * @param succeeded whether the dictionary was renamed
+ */
+void Dictionaries::finishRenaming(QString const &dictionary, QString const &newName, bool succeeded)
+{
+    setTaskRunning(false);
+    if (!succeeded)
+        return;
 
-    //Clear the list widget and reload it
-    ui->listWidget->clear();
-    loadTermFolders();
-    emit signalLoadTermFolders();
+    for (QListWidgetItem *item: ui->listWidget->findItems(dictionary, Qt::MatchExactly))
+        delete item;
+    insertDictionary(newName);
 }
@@ -5,6 +5,9 @@
 #include "rename.h"
 #include "delete.h"
 
+class Storage;
+class DictionaryTask;
+
 namespace Ui {
 class Dictionaries;
 }
@@ -14,7 +17,7 @@ class Dictionaries : public QDialog
     Q_OBJECT
 
 public:
-    explicit Dictionaries(QWidget *parent = nullptr);
+    explicit Dictionaries(Storage *storage, DictionaryTask *task, QWidget *parent = nullptr);
     ~Dictionaries();
 
     void loadTermFolders();
@@ -22,7 +25,7 @@ public:
 signals:
     void relayDictionary(QString);
 
-    void signalLoadTermFolders();
+    void dictionaryAdded(QString);
 
 private slots:
     void on_pushButtonAdd_clicked();
@@ -35,8 +38,24 @@ private slots:
 
     void deleteDictionary();
 
+    void on_pushButtonStop_clicked();
+
+    void finishRenaming(QString const &dictionary, QString const &newName, bool succeeded);
+
+    void finishDeleting(QString const &dictionary, bool succeeded);
+
+    void showProgress(int removedFiles, int totalFiles);
+
+    void finishReclaiming();
+
 private:
+    void insertDictionary(QString const &dictionary);
+
+    void setTaskRunning(bool running);
+
     Ui::Dictionaries *ui;
+    Storage *mStorage;
+    DictionaryTask *mTask;
     Rename *mRename;
     Delete *mDelete;
 };
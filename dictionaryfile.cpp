@@ -0,0 +1,703 @@
+#include "dictionaryfile.h"
+#include "storage.h"
+#include "revisionstore.h"
+#include "metrics.h"
+#include "textcodec.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+/* Imports read the whole file through a memory map and cut
+ * it into chunks that end on a line break. A window of chunks
+ * is parsed in parallel, then the terms of each chunk are
+ * appended to the pack in order with a single write, before
+ * the next window is parsed. Terms that already exist keep
+ * their history in the revision store. The pack is compacted
+ * once at the end, still on the worker thread, which is the
+ * only time it is synced to the disk; the interface copies
+ * definitions out of the pack, so it holds no slice of the
+ * mapping that compacting replaces.
+ *
+ * Exports go through a buffer that is written out whenever it
+ * fills up, so that only one definition at a time is held in
+ * memory besides the buffer.
+ */
+
+//Parse the file in chunks of about this many bytes
+int const chunkSize{4 * 1024 * 1024};
+
+//Write the export in blocks of about this many bytes
+int const bufferSize{1024 * 1024};
+
+//Parse this many chunks per processor before writing them
+int const chunksPerThread{2};
+
+//The first line of a StarDict information file
+char const starDictMagic[]{"StarDict's dict ifo file"};
+
+/**
+ * @brief The StarDictEntry struct
+ * A word of a StarDict index and where its data lies
+ * in the dictionary file.
+ */
+struct StarDictEntry
+{
+    QByteArray name;
+    quint64 offset;
+    quint32 size;
+};
+
+/**
+ * @brief The StarDictParser class
+ * Extracts the text of a range of StarDict index entries.
+ * Used as the map function of QtConcurrent, hence the
+ * result_type typedef.
+ */
+class StarDictParser
+{
+public:
+    typedef DictionaryFile::Batch result_type;
+
+    StarDictParser(QVector<StarDictEntry> const *entries, uchar const *data,
+                   qint64 size, QByteArray const &types) :
+        mEntries{entries},
+        mData{data},
+        mSize{size},
+        mTypes{types}
+    {
+    }
+
+    DictionaryFile::Batch operator()(QPair<int, int> const &range) const
+    {
+        DictionaryFile::Batch batch{QVector<TermStore::Term>{}, 0};
+        batch.terms.reserve(range.second - range.first);
+        for (int i = range.first; i < range.second; i++)
+        {
+            StarDictEntry const &entry{mEntries->at(i)};
+            if (entry.name.isEmpty() || entry.offset + entry.size > static_cast<quint64>(mSize))
+            {
+                batch.skipped++;
+                continue;
+            }
+            char const *data{reinterpret_cast<char const *>(mData) + entry.offset};
+            batch.terms.push_back(TermStore::Term{QString::fromUtf8(entry.name),
+                                                  text(data, data + entry.size)});
+        }
+        return batch;
+    }
+
+private:
+    /**
+     * @brief StarDictParser::text
+     * Joins the text fields of the data of a word, one per
+     * line, and drops the binary ones such as pictures and
+     * sounds. Lower case types are text ending with a null
+     * byte, upper case types are preceded by their size.
+     * With a sametypesequence the types are not stored and
+     * the last field has neither end nor size.
+     * @param data the first byte of the data
+     * @param end one past the last byte of the data
+     * @return the text of the data
+     */
+    QByteArray text(char const *data, char const *end) const
+    {
+        QByteArray text;
+        for (int field = 0; data < end; field++)
+        {
+            bool const typesGiven{!mTypes.isEmpty()};
+            if (typesGiven && field >= mTypes.size())
+                break;
+            char const type{typesGiven ? mTypes[field] : *data++};
+            bool const last{typesGiven && field == mTypes.size() - 1};
+
+            bool const isText{type >= 'a' && type <= 'z'};
+
+            char const *fieldEnd{end};
+            char const *next{end};
+            if (!last && isText)
+            {
+                char const *terminator{static_cast<char const *>(std::memchr(data, '\0', end - data))};
+                fieldEnd = terminator == nullptr ? end : terminator;
+                next = terminator == nullptr ? end : terminator + 1;
+            }
+            else if (!last && end - data >= 4)
+            {
+                quint32 const size{qFromBigEndian<quint32>(reinterpret_cast<uchar const *>(data))};
+                data += 4;
+                fieldEnd = size <= static_cast<quint32>(end - data) ? data + size : end;
+                next = fieldEnd;
+            }
+            else if (!last)
+                break;
+
+            if (isText)
+            {
+                if (!text.isEmpty())
+                    text += '\n';
+                text.append(data, static_cast<int>(fieldEnd - data));
+            }
+            data = next;
+        }
+        return text;
+    }
+
+    QVector<StarDictEntry> const *mEntries;
+    uchar const *mData;
+    qint64 mSize;
+    QByteArray mTypes;
+};
+
+/**
+ * @brief writeBatches
+ * Parses the work items in windows, in parallel, and appends
+ * the terms of each item to the store in the order of the items.
+ * Terms that are overwritten keep their history: the replaced
+ * definition becomes a revision if the term has none yet, and
+ * the imported one is recorded after it.
+ * @param store the store receiving the terms
+ * @param revisions the revisions of the dictionary, if any
+ * @param items the chunks or ranges to parse
+ * @param parse the parser, taking one item and returning a Batch
+ * @param result incremented with the terms written and skipped
+ * @return whether every batch was written
+ */
+template <typename Item, typename Parser>
+bool writeBatches(TermStore *store, RevisionStore *revisions, QVector<Item> const &items,
+                  Parser parse, DictionaryFile::Result &result)
+{
+    int const window{std::max(1, QThread::idealThreadCount()) * chunksPerThread};
+    for (int first = 0; first < items.size(); first += window)
+    {
+        QList<DictionaryFile::Batch> const batches{
+            QtConcurrent::blockingMapped<QList<DictionaryFile::Batch>>(items.mid(first, window), parse)};
+        for (DictionaryFile::Batch const &batch: batches)
+        {
+            QVector<int> overwritten;
+            for (int i = 0; revisions != nullptr && i < batch.terms.size(); i++)
+            {
+                QString const &term{batch.terms[i].first};
+                if (!store->contains(term))
+                    continue;
+                overwritten.push_back(i);
+                QByteArray previous;
+                if (!revisions->hasRevisions(term) && store->read(term, previous))
+                    revisions->record(term, TermStore::Parts{previous});
+            }
+
+            if (!store->writeBatch(batch.terms))
+                return false;
+            for (int const i: overwritten)
+                revisions->record(batch.terms[i].first, TermStore::Parts{batch.terms[i].second});
+            result.terms += batch.terms.size();
+            result.skipped += batch.skipped;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief DictionaryFile::format
+ * Tells the format of a file from its extension: .tsv and
+ * .txt are tab separated, .jsonl is JSON lines, and .ifo is
+ * the information file of a StarDict dictionary.
+ * @param path the file path
+ * @return the format of the file
+ */
+DictionaryFile::Format DictionaryFile::format(QString const &path)
+{
+    QString const suffix{QFileInfo{path}.suffix().toLower()};
+    if (suffix == "tsv" || suffix == "txt")
+        return Tsv;
+    if (suffix == "jsonl")
+        return JsonLines;
+    if (suffix == "ifo")
+        return StarDict;
+    return Unknown;
+}
+
+/**
+ * @brief DictionaryFile::filter
+ * @return the name filters of the supported formats,
+ * for file dialogs
+ */
+QString DictionaryFile::filter()
+{
+    return "Tab-separated values (*.tsv *.txt);;"
+           "JSON lines (*.jsonl);;"
+           "StarDict (*.ifo)";
+}
+
+/**
+ * @brief DictionaryFile::escape
+ * Puts a definition on a single line by writing backslashes,
+ * tabs, and line breaks as \\, \t, and \n. Carriage
+ * returns are dropped.
+ * @param text a UTF-8 encoded definition
+ * @return the definition on a single line
+ */
+QByteArray DictionaryFile::escape(QByteArray const &text)
+{
+    QByteArray escaped;
+    escaped.reserve(text.size());
+    for (char const character: text)
+    {
+        if (character == '\\')
+            escaped += "\\\\";
+        else if (character == '\t')
+            escaped += "\\t";
+        else if (character == '\n')
+            escaped += "\\n";
+        else if (character != '\r')
+            escaped += character;
+    }
+    return escaped;
+}
+
+/**
+ * @brief DictionaryFile::unescape
+ * Reverses escape(). Unknown escapes are kept as they are.
+ * @param text an escaped definition
+ * @return the definition
+ */
+QByteArray DictionaryFile::unescape(QByteArray const &text)
+{
+    if (!text.contains('\\'))
+        return text;
+
+    QByteArray unescaped;
+    unescaped.reserve(text.size());
+    for (int i = 0; i < text.size(); i++)
+    {
+        char const character{text[i]};
+        if (character != '\\' || i + 1 == text.size())
+        {
+            unescaped += character;
+            continue;
+        }
+
+        char const escaped{text[++i]};
+        if (escaped == 't')
+            unescaped += '\t';
+        else if (escaped == 'n')
+            unescaped += '\n';
+        else if (escaped == '\\')
+            unescaped += '\\';
+        else
+            unescaped += QByteArray{"\\"} + escaped;
+    }
+    return unescaped;
+}
+
+/**
+ * @brief DictionaryFile::importFile
+ * Adds every term of a file to a dictionary, replacing the
+ * definitions of the terms it already has. Runs on a worker
+ * thread; the dictionary may be in use meanwhile.
+ * @param storage the storage holding the dictionary
+ * @param dictionary the dictionary name
+ * @param path the file to import
+ * @return the number of terms imported and skipped, or an error
+ */
+DictionaryFile::Result DictionaryFile::importFile(Storage *storage, QString const &dictionary,
+                                                  QString const &path)
+{
+    ScopedTimer const timer{Metrics::DictionaryFileImport};
+
+    QSharedPointer<TermStore> const store{storage->store(dictionary)};
+    if (store.isNull())
+        return Result{0, 0, "No such dictionary: " + dictionary};
+
+    Format const fileFormat{format(path)};
+    if (fileFormat == Unknown)
+        return Result{0, 0, "Unknown file format: " + path};
+
+    QSharedPointer<RevisionStore> const revisions{storage->revisions(dictionary)};
+    Result const result{fileFormat == StarDict ?
+                importStarDict(store.data(), revisions.data(), path) :
+                importLines(store.data(), revisions.data(), path, fileFormat)};
+
+    //Even a failed import may have written some terms
+    if (result.terms > 0 && !store->compact() && result.error == "")
+        return Result{result.terms, result.skipped, "Could not compact the dictionary"};
+    return result;
+}
+
+/**
+ * @brief DictionaryFile::importLines
+ * Imports a file holding one term per line.
+ * @param store the store receiving the terms
+ * @param revisions the revisions of the dictionary, if any
+ * @param path the file to import
+ * @param format Tsv or JsonLines
+ * @return the number of terms imported and skipped, or an error
+ */
+DictionaryFile::Result DictionaryFile::importLines(TermStore *store, RevisionStore *revisions,
+                                                   QString const &path, Format format)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly))
+        return Result{0, 0, "Could not open " + path};
+
+    qint64 const size{file.size()};
+    if (size == 0)
+        return Result{0, 0, ""};
+    char const *data{reinterpret_cast<char const *>(file.map(0, size))};
+    if (data == nullptr)
+        return Result{0, 0, "Could not read " + path};
+
+    qint64 start{0};
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        start = 3;
+
+    //The chunks point into the map, nothing is copied yet
+    QVector<QByteArray> chunks;
+    while (start < size)
+    {
+        qint64 end{std::min(start + chunkSize, size)};
+        if (end < size)
+        {
+            void const *lineEnd{std::memchr(data + end, '\n', static_cast<size_t>(size - end))};
+            end = lineEnd == nullptr ? size : static_cast<char const *>(lineEnd) - data + 1;
+        }
+        chunks.push_back(QByteArray::fromRawData(data + start, static_cast<int>(end - start)));
+        start = end;
+    }
+
+    Result result{0, 0, ""};
+    if (!writeBatches(store, revisions, chunks, format == Tsv ? &DictionaryFile::parseTsv :
+                                                     &DictionaryFile::parseJsonLines, result))
+        result.error = "Could not write to the dictionary";
+    return result;
+}
+
+/**
+ * @brief DictionaryFile::parseTsv
+ * Parses lines of the form term<TAB>definition, both
+ * escaped as by escape(). Lines without a tab, or with an
+ * empty term, are skipped, except for blank lines.
+ * @param chunk whole lines of the file
+ * @return the terms of the chunk
+ */
+DictionaryFile::Batch DictionaryFile::parseTsv(QByteArray const &chunk)
+{
+    Batch batch{QVector<TermStore::Term>{}, 0};
+    int start{0};
+    while (start < chunk.size())
+    {
+        int end{chunk.indexOf('\n', start)};
+        if (end < 0)
+            end = chunk.size();
+        int lineEnd{end};
+        if (lineEnd > start && chunk[lineEnd - 1] == '\r')
+            lineEnd--;
+
+        int const tab{chunk.indexOf('\t', start)};
+        if (tab > start && tab < lineEnd)
+        {
+            QString const term{QString::fromUtf8(unescape(chunk.mid(start, tab - start)))};
+            batch.terms.push_back(TermStore::Term{term, unescape(chunk.mid(tab + 1, lineEnd - tab - 1))});
+        }
+        else if (lineEnd > start)
+            batch.skipped++;
+        start = end + 1;
+    }
+    return batch;
+}
+
+/**
+ * @brief DictionaryFile::parseJsonLines
+ * Parses lines holding objects such as
+ * {"term": "...", "definition": "..."}. Lines that are not
+ * such objects are skipped, except for blank lines.
+ * @param chunk whole lines of the file
+ * @return the terms of the chunk
+ */
+DictionaryFile::Batch DictionaryFile::parseJsonLines(QByteArray const &chunk)
+{
+    Batch batch{QVector<TermStore::Term>{}, 0};
+    int start{0};
+    while (start < chunk.size())
+    {
+        int end{chunk.indexOf('\n', start)};
+        if (end < 0)
+            end = chunk.size();
+        QByteArray const line{chunk.mid(start, end - start).trimmed()};
+        start = end + 1;
+        if (line.isEmpty())
+            continue;
+
+        QJsonObject const object{QJsonDocument::fromJson(line).object()};
+        QString const term{object.value("term").toString()};
+        if (term == "" || !object.value("definition").isString())
+        {
+            batch.skipped++;
+            continue;
+        }
+        batch.terms.push_back(TermStore::Term{term,
+                                              TextCodec::encode(object.value("definition").toString())});
+    }
+    return batch;
+}
+
+/**
+ * @brief DictionaryFile::importStarDict
+ * Imports a StarDict dictionary from its .ifo, .idx, and
+ * .dict files. Compressed indexes and dictionaries have to
+ * be unpacked first, with gzip -d and dictzip -d.
+ * @param store the store receiving the terms
+ * @param revisions the revisions of the dictionary, if any
+ * @param path the .ifo file
+ * @return the number of terms imported and skipped, or an error
+ */
+DictionaryFile::Result DictionaryFile::importStarDict(TermStore *store, RevisionStore *revisions,
+                                                      QString const &path)
+{
+    QFile information{path};
+    if (!information.open(QIODevice::ReadOnly | QIODevice::Text))
+        return Result{0, 0, "Could not open " + path};
+    if (information.readLine().trimmed() != starDictMagic)
+        return Result{0, 0, path + " is not a StarDict information file"};
+
+    QByteArray types;
+    int offsetBytes{4};
+    while (!information.atEnd())
+    {
+        QByteArray const line{information.readLine().trimmed()};
+        if (line.startsWith("sametypesequence="))
+            types = line.mid(static_cast<int>(std::strlen("sametypesequence=")));
+        else if (line == "idxoffsetbits=64")
+            offsetBytes = 8;
+    }
+
+    QString const base{path.left(path.size() - static_cast<int>(std::strlen(".ifo")))};
+    for (QString const &suffix: QStringList{".idx", ".dict"})
+        if (!QFile::exists(base + suffix))
+            return Result{0, 0, QFile::exists(base + suffix + (suffix == ".idx" ? ".gz" : ".dz")) ?
+                                    "Unpack " + base + suffix + " before importing it" :
+                                    "Missing " + base + suffix};
+
+    QFile index{base + ".idx"};
+    QFile dictionary{base + ".dict"};
+    if (!index.open(QIODevice::ReadOnly) || !dictionary.open(QIODevice::ReadOnly))
+        return Result{0, 0, "Could not open " + base + ".idx and .dict"};
+
+    //Each entry is the word, a null byte, and the offset and
+    //size of its data, both big endian
+    QVector<StarDictEntry> entries;
+    qint64 const indexSize{index.size()};
+    char const *indexData{reinterpret_cast<char const *>(index.map(0, indexSize))};
+    if (indexSize > 0 && indexData == nullptr)
+        return Result{0, 0, "Could not read " + index.fileName()};
+    char const *const indexEnd{indexData + indexSize};
+    for (char const *word = indexData; word < indexEnd;)
+    {
+        char const *nameEnd{static_cast<char const *>(std::memchr(word, '\0', indexEnd - word))};
+        if (nameEnd == nullptr || indexEnd - nameEnd < 1 + offsetBytes + 4)
+            return Result{0, 0, index.fileName() + " is truncated"};
+
+        uchar const *numbers{reinterpret_cast<uchar const *>(nameEnd + 1)};
+        quint64 const offset{offsetBytes == 8 ? qFromBigEndian<quint64>(numbers) :
+                                                qFromBigEndian<quint32>(numbers)};
+        entries.push_back(StarDictEntry{QByteArray{word, static_cast<int>(nameEnd - word)},
+                                        offset, qFromBigEndian<quint32>(numbers + offsetBytes)});
+        word = nameEnd + 1 + offsetBytes + 4;
+    }
+
+    qint64 const dictionarySize{dictionary.size()};
+    uchar const *dictionaryData{dictionary.map(0, dictionarySize)};
+    if (dictionarySize > 0 && dictionaryData == nullptr)
+        return Result{0, 0, "Could not read " + dictionary.fileName()};
+
+    //Split the index into as many ranges as a text file of the
+    //same size would have chunks
+    int const rangeCount{static_cast<int>(std::max<qint64>(1, dictionarySize / chunkSize))};
+    int const rangeSize{entries.size() / rangeCount + 1};
+    QVector<QPair<int, int>> ranges;
+    for (int first = 0; first < entries.size(); first += rangeSize)
+        ranges.push_back(qMakePair(first, std::min(first + rangeSize, entries.size())));
+
+    Result result{0, 0, ""};
+    if (!writeBatches(store, revisions, ranges, StarDictParser{&entries, dictionaryData, dictionarySize, types}, result))
+        result.error = "Could not write to the dictionary";
+    return result;
+}
+
+/**
+ * @brief DictionaryFile::exportFile
+ * Writes every term of a dictionary to a file, in the order
+ * of the term list. The file is only replaced once it has
+ * been written completely.
+ * @param storage the storage holding the dictionary
+ * @param dictionary the dictionary name
+ * @param path the file to write; its extension selects the format
+ * @return the number of terms exported, or an error
+ */
+DictionaryFile::Result DictionaryFile::exportFile(Storage *storage, QString const &dictionary,
+                                                  QString const &path)
+{
+    ScopedTimer const timer{Metrics::DictionaryFileExport};
+
+    QSharedPointer<TermStore> const store{storage->store(dictionary)};
+    if (store.isNull())
+        return Result{0, 0, "No such dictionary: " + dictionary};
+
+    Format const fileFormat{format(path)};
+    if (fileFormat == Unknown)
+        return Result{0, 0, "Unknown file format: " + path};
+    if (fileFormat == StarDict)
+        return exportStarDict(store.data(), dictionary, path);
+    return exportLines(store.data(), path, fileFormat);
+}
+
+/**
+ * @brief DictionaryFile::exportLines
+ * Writes one term per line.
+ * @param store the store holding the terms
+ * @param path the file to write
+ * @param format Tsv or JsonLines
+ * @return the number of terms exported, or an error
+ */
+DictionaryFile::Result DictionaryFile::exportLines(TermStore *store, QString const &path,
+                                                   Format format)
+{
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly))
+        return Result{0, 0, "Could not create " + path};
+
+    Result result{0, 0, ""};
+    QByteArray buffer;
+    buffer.reserve(bufferSize);
+    QByteArray contents;
+    for (QString const &term: store->terms())
+    {
+        if (!store->read(term, contents))
+        {
+            result.skipped++;
+            continue;
+        }
+
+        if (format == Tsv)
+            buffer += escape(TextCodec::encode(term)) + '\t' + escape(contents) + '\n';
+        else
+            buffer += QJsonDocument{QJsonObject{{"term", term},
+                                                {"definition", TextCodec::decode(contents)}}}
+                      .toJson(QJsonDocument::Compact) + '\n';
+        result.terms++;
+
+        if (buffer.size() >= bufferSize)
+        {
+            file.write(buffer);
+            buffer.clear();
+        }
+    }
+    file.write(buffer);
+
+    if (!file.commit())
+        return Result{0, 0, "Could not write " + path};
+    return result;
+}
+
+/**
+ * @brief DictionaryFile::exportStarDict
+ * Writes the .ifo, .idx, and .dict files of a StarDict
+ * dictionary whose definitions are plain text. The index
+ * is sorted the way StarDict expects: ignoring the case of
+ * ASCII letters first, then byte by byte.
+ * @param store the store holding the terms
+ * @param dictionary the dictionary name, used as the book name
+ * @param path the .ifo file
+ * @return the number of terms exported, or an error
+ */
+DictionaryFile::Result DictionaryFile::exportStarDict(TermStore *store, QString const &dictionary,
+                                                      QString const &path)
+{
+    QVector<QByteArray> names;
+    for (QString const &term: store->terms())
+        names.push_back(term.toUtf8());
+    std::sort(names.begin(), names.end(), [](QByteArray const &a, QByteArray const &b) {
+        int const order{qstricmp(a.constData(), b.constData())};
+        return order != 0 ? order < 0 : std::strcmp(a.constData(), b.constData()) < 0;
+    });
+
+    QString const base{path.left(path.size() - static_cast<int>(std::strlen(".ifo")))};
+    QSaveFile dictionaryFile{base + ".dict"};
+    if (!dictionaryFile.open(QIODevice::WriteOnly))
+        return Result{0, 0, "Could not create " + dictionaryFile.fileName()};
+
+    Result result{0, 0, ""};
+    QVector<StarDictEntry> entries;
+    entries.reserve(names.size());
+    quint64 offset{0};
+    QByteArray buffer;
+    buffer.reserve(bufferSize);
+    QByteArray contents;
+    for (QByteArray const &name: names)
+    {
+        if (!store->read(QString::fromUtf8(name), contents))
+        {
+            result.skipped++;
+            continue;
+        }
+        entries.push_back(StarDictEntry{name, offset, static_cast<quint32>(contents.size())});
+        offset += static_cast<quint64>(contents.size());
+        buffer += contents;
+        result.terms++;
+
+        if (buffer.size() >= bufferSize)
+        {
+            dictionaryFile.write(buffer);
+            buffer.clear();
+        }
+    }
+    dictionaryFile.write(buffer);
+
+    //Offsets only need 64 bits when the definitions
+    //add up to more than 4 GiB
+    bool const wideOffsets{offset > 0xFFFFFFFFu};
+    QSaveFile indexFile{base + ".idx"};
+    if (!indexFile.open(QIODevice::WriteOnly))
+        return Result{0, 0, "Could not create " + indexFile.fileName()};
+    buffer.clear();
+    for (StarDictEntry const &entry: entries)
+    {
+        uchar numbers[12];
+        if (wideOffsets)
+            qToBigEndian<quint64>(entry.offset, numbers);
+        else
+            qToBigEndian<quint32>(static_cast<quint32>(entry.offset), numbers);
+        qToBigEndian<quint32>(entry.size, numbers + (wideOffsets ? 8 : 4));
+        buffer += entry.name + '\0';
+        buffer.append(reinterpret_cast<char const *>(numbers), wideOffsets ? 12 : 8);
+        if (buffer.size() >= bufferSize)
+        {
+            indexFile.write(buffer);
+            buffer.clear();
+        }
+    }
+    indexFile.write(buffer);
+
+    QSaveFile information{path};
+    if (!information.open(QIODevice::WriteOnly))
+        return Result{0, 0, "Could not create " + path};
+    QByteArray header{QByteArray{starDictMagic} + "\n"};
+    header += wideOffsets ? "version=3.0.0\nidxoffsetbits=64\n" : "version=2.4.2\n";
+    header += "bookname=" + dictionary.toUtf8() + "\n";
+    header += "wordcount=" + QByteArray::number(entries.size()) + "\n";
+    header += "idxfilesize=" + QByteArray::number(indexFile.size()) + "\n";
+    header += "sametypesequence=m\n";
+    information.write(header);
+
+    //The information file goes last, so a dictionary with
+    //a valid .ifo always has its other files complete
+    if (!dictionaryFile.commit() || !indexFile.commit() || !information.commit())
+        return Result{0, 0, "Could not write " + base + ".ifo, .idx, and .dict"};
+    return result;
+}
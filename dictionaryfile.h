@@ -0,0 +1,65 @@
+#ifndef DICTIONARYFILE_H
+#define DICTIONARYFILE_H
+
+#include "termstore.h"
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+class Storage;
+class RevisionStore;
+
+class DictionaryFile
+{
+public:
+    enum Format
+    {
+        Unknown,
+        Tsv,
+        JsonLines,
+        StarDict
+    };
+
+    //The outcome of an import or an export
+    struct Result
+    {
+        int terms;
+        int skipped;
+        QString error;
+    };
+
+    //The terms parsed from one chunk of a file
+    struct Batch
+    {
+        QVector<TermStore::Term> terms;
+        int skipped;
+    };
+
+    static Format format(QString const &path);
+
+    static QString filter();
+
+    static Result importFile(Storage *storage, QString const &dictionary, QString const &path);
+
+    static Result exportFile(Storage *storage, QString const &dictionary, QString const &path);
+
+    static QByteArray escape(QByteArray const &text);
+
+    static QByteArray unescape(QByteArray const &text);
+
+private:
+    static Result importLines(TermStore *store, RevisionStore *revisions, QString const &path,
+                              Format format);
+
+    static Result importStarDict(TermStore *store, RevisionStore *revisions, QString const &path);
+
+    static Batch parseTsv(QByteArray const &chunk);
+
+    static Batch parseJsonLines(QByteArray const &chunk);
+
+    static Result exportLines(TermStore *store, QString const &path, Format format);
+
+    static Result exportStarDict(TermStore *store, QString const &dictionary, QString const &path);
+};
+
+#endif // DICTIONARYFILE_H
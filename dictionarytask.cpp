@@ -0,0 +1,206 @@
+#include "dictionarytask.h"
+#include "storage.h"
+#include "metrics.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtConcurrent>
+
+//Report the progress of a reclaim every this many files
+int const progressInterval{256};
+
+/**
+ * @brief DictionaryTask::DictionaryTask
+ * Creates a task runner that renames and deletes
+ * dictionaries on a worker thread, one at a time.
+ * Its signals are emitted from the worker and arrive
+ * queued in the thread of the receivers.
+ * @param storage the storage holding the dictionaries
+ * @param parent
+ */
+DictionaryTask::DictionaryTask(Storage *storage, QObject *parent) :
+    QObject{parent},
+    mStorage{storage},
+    mCancelled{0}
+{
+}
+
+/**
+ * @brief DictionaryTask::~DictionaryTask
+ * Stops reclaiming space and waits for the worker.
+ * Tombstones left behind are reclaimed next time.
+ */
+DictionaryTask::~DictionaryTask()
+{
+    cancel();
+    mTask.waitForFinished();
+}
+
+/**
+ * @brief DictionaryTask::rename
+ * Starts renaming a dictionary. The dictionary is closed
+ * first, which may compact it. aboutToChange is emitted
+ * before anything is touched, and renamed once it is done.
+ * @param dictionary the current dictionary name
+ * @param newName the new dictionary name
+ * @return whether the rename was started, false if
+ * another task is still running
+ */
+bool DictionaryTask::rename(QString const &dictionary, QString const &newName)
+{
+    if (isRunning())
+        return false;
+
+    emit aboutToChange(dictionary);
+    mCancelled.storeRelease(0);
+    mTask = QtConcurrent::run(this, &DictionaryTask::runRename, dictionary, newName);
+    return true;
+}
+
+/**
+ * @brief DictionaryTask::remove
+ * Starts deleting a dictionary. removed is emitted as soon
+ * as the dictionary is gone from the list, then its files
+ * are removed while progress is reported.
+ * @param dictionary the dictionary name
+ * @return whether the deletion was started, false if
+ * another task is still running
+ */
+bool DictionaryTask::remove(QString const &dictionary)
+{
+    if (isRunning())
+        return false;
+
+    emit aboutToChange(dictionary);
+    mCancelled.storeRelease(0);
+    mTask = QtConcurrent::run(this, &DictionaryTask::runRemove, dictionary);
+    return true;
+}
+
+/**
+ * @brief DictionaryTask::reclaim
+ * Starts removing the files of dictionaries whose deletion
+ * was cancelled or interrupted.
+ * @return whether there was anything to reclaim and no
+ * other task was running
+ */
+bool DictionaryTask::reclaim()
+{
+    if (isRunning() || mStorage->tombstones().isEmpty())
+        return false;
+
+    mCancelled.storeRelease(0);
+    mTask = QtConcurrent::run(this, &DictionaryTask::runReclaim);
+    return true;
+}
+
+/**
+ * @brief DictionaryTask::cancel
+ * Stops removing the files of deleted dictionaries. The
+ * dictionaries stay deleted; the files that are left
+ * are removed by the next reclaim.
+ */
+void DictionaryTask::cancel()
+{
+    mCancelled.storeRelease(1);
+}
+
+/**
+ * @brief DictionaryTask::isRunning
+ * @return whether a task is running
+ */
+bool DictionaryTask::isRunning() const
+{
+    return mTask.isRunning();
+}
+
+/**
+ * @brief DictionaryTask::runRename
+ * Renames the dictionary. Runs on a worker thread.
+ * @param dictionary the current dictionary name
+ * @param newName the new dictionary name
+ */
+void DictionaryTask::runRename(QString const &dictionary, QString const &newName)
+{
+    ScopedTimer const timer{Metrics::DictionaryTaskRename};
+    emit renamed(dictionary, newName, mStorage->renameDictionary(dictionary, newName));
+}
+
+/**
+ * @brief DictionaryTask::runRemove
+ * Turns the dictionary into a tombstone and reclaims it.
+ * Runs on a worker thread.
+ * @param dictionary the dictionary name
+ */
+void DictionaryTask::runRemove(QString const &dictionary)
+{
+    bool const succeeded{mStorage->removeDictionary(dictionary)};
+    emit removed(dictionary, succeeded);
+    if (succeeded)
+        runReclaim();
+}
+
+/**
+ * @brief DictionaryTask::runReclaim
+ * Removes every file and folder inside the tombstones.
+ * Files are listed first so that progress can be reported
+ * against a total. Runs on a worker thread.
+ */
+void DictionaryTask::runReclaim()
+{
+    ScopedTimer const timer{Metrics::DictionaryTaskReclaim};
+
+    //Folders are listed before their contents, so removing
+    //them in reverse order empties each one before it goes
+    QStringList files;
+    QStringList folders;
+    for (QString const &tombstone: mStorage->tombstones())
+    {
+        folders << tombstone;
+        QDirIterator entry{tombstone, QDir::AllEntries | QDir::Hidden | QDir::System |
+                           QDir::NoDotAndDotDot, QDirIterator::Subdirectories};
+        while (entry.hasNext())
+        {
+            entry.next();
+            if (entry.fileInfo().isDir() && !entry.fileInfo().isSymLink())
+                folders << entry.filePath();
+            else
+                files << entry.filePath();
+            if (mCancelled.loadAcquire())
+            {
+                emit reclaimed(false);
+                return;
+            }
+        }
+    }
+
+    emit progress(0, files.size());
+    for (int i = 0; i < files.size(); i++)
+    {
+        if (mCancelled.loadAcquire())
+        {
+            emit progress(i, files.size());
+            emit reclaimed(false);
+            return;
+        }
+
+        //Read-only files cannot be removed on every platform
+        if (!QFile::remove(files[i]))
+        {
+            QFile::setPermissions(files[i], QFile::ReadOwner | QFile::WriteOwner);
+            QFile::remove(files[i]);
+        }
+        if ((i + 1) % progressInterval == 0)
+            emit progress(i + 1, files.size());
+    }
+
+    QDir dir;
+    for (int i = folders.size() - 1; i >= 0; i--)
+        dir.rmdir(folders[i]);
+
+    emit progress(files.size(), files.size());
+    emit reclaimed(mStorage->tombstones().isEmpty());
+}
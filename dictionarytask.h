@@ -0,0 +1,53 @@
+#ifndef DICTIONARYTASK_H
+#define DICTIONARYTASK_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+#include <QFuture>
+
+class Storage;
+
+class DictionaryTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DictionaryTask(Storage *storage, QObject *parent = nullptr);
+    ~DictionaryTask();
+
+    bool rename(QString const &dictionary, QString const &newName);
+
+    bool remove(QString const &dictionary);
+
+    bool reclaim();
+
+    void cancel();
+
+    bool isRunning() const;
+
+signals:
+    //Do not implement signals
+    void aboutToChange(QString dictionary);
+
+    void renamed(QString dictionary, QString newName, bool succeeded);
+
+    void removed(QString dictionary, bool succeeded);
+
+    void progress(int removedFiles, int totalFiles);
+
+    void reclaimed(bool completed);
+
+private:
+    void runRename(QString const &dictionary, QString const &newName);
+
+    void runRemove(QString const &dictionary);
+
+    void runReclaim();
+
+    Storage *mStorage;
+    QAtomicInt mCancelled;
+    QFuture<void> mTask;
+};
+
+#endif // DICTIONARYTASK_H
@@ -0,0 +1,85 @@
+#include "edittracker.h"
+#include "textcodec.h"
+
+#include <QTextDocument>
+
+/**
+ * @brief EditTracker::EditTracker
+ * Follows the edits made to a document, narrowing down the
+ * region that differs from the stored definition it shows,
+ * so that saving can write just that region.
+ * @param document the document of the editor
+ * @param parent
+ */
+EditTracker::EditTracker(QTextDocument *document, QObject *parent) :
+    QObject{parent},
+    mDocument{document},
+    mSize{0},
+    mPrefix{0},
+    mSuffix{0},
+    mChanged{false}
+{
+    QObject::connect(mDocument, SIGNAL(contentsChange(int,int,int)),
+                     this, SLOT(markChanged(int,int,int)));
+}
+
+/**
+ * @brief EditTracker::reset
+ * Tells that the document is the same as the stored
+ * definition, as right after loading or saving it.
+ * @param size the size of the stored definition, in bytes
+ */
+void EditTracker::reset(int size)
+{
+    mSize = size;
+    mChanged = false;
+}
+
+/**
+ * @brief EditTracker::markChanged
+ * Widens the edited region to cover an edit. The text
+ * before the first edit and after the last one is still
+ * the same as in the stored definition.
+ * @param position where the edit happened
+ * @param removed the number of characters removed
+ * @param added the number of characters added
+ */
+void EditTracker::markChanged(int position, int removed, int added)
+{
+    Q_UNUSED(removed)
+
+    //The document always ends with a paragraph separator
+    //that is not part of the text
+    int const length{mDocument->characterCount() - 1};
+    int const suffix{qMax(0, length - position - added)};
+    mPrefix = mChanged ? qMin(mPrefix, position) : position;
+    mSuffix = mChanged ? qMin(mSuffix, suffix) : suffix;
+    mChanged = true;
+}
+
+/**
+ * @brief EditTracker::delta
+ * Builds the splice that turns the stored definition into
+ * the text of the document. The store checks it against
+ * the stored definition before using it, so a delta made
+ * for another definition only costs a whole write.
+ * @param text the text of the document
+ * @return the delta, or none if the whole text should be
+ * written
+ */
+TermStore::Delta EditTracker::delta(QString const &text) const
+{
+    if (!mChanged || mPrefix + mSuffix > text.size())
+        return TermStore::Delta{};
+
+    int const prefixSize{TextCodec::utf8Size(text.constData(), mPrefix)};
+    int const suffixSize{TextCodec::utf8Size(text.constData() + text.size() - mSuffix, mSuffix)};
+    int const removed{mSize - prefixSize - suffixSize};
+    if (removed < 0)
+        return TermStore::Delta{};
+
+    QByteArray inserted;
+    TextCodec::append(text.constData() + mPrefix, text.size() - mPrefix - mSuffix, inserted);
+    return TermStore::Delta{TermStore::Splice{static_cast<quint32>(prefixSize),
+                                              static_cast<quint32>(removed), inserted}};
+}
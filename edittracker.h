@@ -0,0 +1,34 @@
+#ifndef EDITTRACKER_H
+#define EDITTRACKER_H
+
+#include <QObject>
+#include <QString>
+#include "termstore.h"
+
+class QTextDocument;
+
+class EditTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditTracker(QTextDocument *document, QObject *parent = nullptr);
+
+    void reset(int size);
+
+    TermStore::Delta delta(QString const &text) const;
+
+private slots:
+    void markChanged(int position, int removed, int added);
+
+private:
+    QTextDocument *mDocument;
+    //The size of the stored definition the document started as
+    int mSize;
+    //Characters left alone at the start and at the end
+    int mPrefix;
+    int mSuffix;
+    bool mChanged;
+};
+
+#endif // EDITTRACKER_H
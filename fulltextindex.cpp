@@ -0,0 +1,680 @@
+#include "fulltextindex.h"
+#include "storage.h"
+#include "termstore.h"
+#include "textcodec.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* The index maps every token found in the definitions to a
+ * postings list: the ids of the documents containing it, in
+ * increasing order, and how many times it appears in each.
+ * Ids are stored as deltas from the previous id and every
+ * number is a varint, so most postings take two bytes.
+ *
+ * Updating a definition gives it a new id, which is always
+ * appended at the end of the lists; the old id is only marked
+ * as removed. The lists are rewritten without removed ids when
+ * they outnumber the live ones, and whenever the index is saved.
+ */
+char const indexMagic[4]{'N', 'S', 'F', 'T'};
+quint32 const indexVersion{1};
+
+//Tokens outside these lengths are not indexed
+int const minimumTokenLength{2};
+int const maximumTokenLength{64};
+
+/**
+ * @brief appendVarint
+ * Appends a number using seven bits per byte.
+ * @param data the buffer to append to
+ * @param value the number
+ */
+static void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80)
+    {
+        data.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+/**
+ * @brief readVarint
+ * Reads a number written by appendVarint.
+ * @param position where the number starts, moved past it
+ * @return the number
+ */
+static quint32 readVarint(char const *&position)
+{
+    quint32 value{0};
+    int shift{0};
+    quint8 byte{0};
+    do
+    {
+        byte = static_cast<quint8>(*position++);
+        value |= static_cast<quint32>(byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) != 0 && shift < 35);
+    return value;
+}
+
+/**
+ * @brief FullTextIndex::FullTextIndex
+ * Creates an empty index. Call load() to read it from disk
+ * and synchronize() to bring it up to date.
+ * @param path the index file
+ */
+FullTextIndex::FullTextIndex(QString const &path) :
+    mPath{path},
+    mLiveDocuments{0},
+    mSynchronizing{false}
+{
+    //Ids start at one, the first document is never used
+    mDocuments.push_back(Document{QString{}, QString{}, false, {}});
+}
+
+/**
+ * @brief FullTextIndex::tokenize
+ * Splits a text into case-folded words. Any Unicode letter
+ * or digit is part of a word, so Cyrillic and Latin text
+ * are handled alike.
+ * @param text the text
+ * @return how many times each token appears
+ */
+QHash<QString, quint32> FullTextIndex::tokenize(QString const &text)
+{
+    QHash<QString, quint32> frequencies;
+    QString token;
+    for (int i = 0; i <= text.size(); i++)
+    {
+        if (i < text.size() && text[i].isLetterOrNumber())
+        {
+            token += text[i].toCaseFolded();
+            continue;
+        }
+        if (token.size() >= minimumTokenLength && token.size() <= maximumTokenLength)
+            frequencies[token]++;
+        token.clear();
+    }
+    return frequencies;
+}
+
+/**
+ * @brief FullTextIndex::addDocument
+ * Indexes a definition under a new id. The caller holds the lock.
+ * @param key the dictionary and term of the definition
+ * @param frequencies the tokens of the definition
+ */
+void FullTextIndex::addDocument(Key const &key, QHash<QString, quint32> const &frequencies)
+{
+    if (frequencies.isEmpty())
+        return;
+
+    quint32 const id{static_cast<quint32>(mDocuments.size())};
+    QVector<QString> tokens;
+    tokens.reserve(frequencies.size());
+    for (auto token = frequencies.constBegin(); token != frequencies.constEnd(); ++token)
+        tokens.push_back(token.key());
+    mDocuments.push_back(Document{key.first, key.second, true, tokens});
+    mDocumentIds.insert(key, id);
+    mLiveDocuments++;
+
+    for (auto token = frequencies.constBegin(); token != frequencies.constEnd(); ++token)
+    {
+        Postings &postings{mPostings[token.key()]};
+        if (postings.data.isEmpty())
+            postings.lastDocument = 0;
+        appendVarint(postings.data, id - postings.lastDocument);
+        appendVarint(postings.data, token.value());
+        postings.lastDocument = id;
+        postings.count++;
+    }
+}
+
+/**
+ * @brief FullTextIndex::removeDocument
+ * Marks the definition of a term as removed. The caller
+ * holds the lock.
+ * @param key the dictionary and term of the definition
+ */
+void FullTextIndex::removeDocument(Key const &key)
+{
+    quint32 const id{mDocumentIds.take(key)};
+    if (id == 0)
+        return;
+
+    //The document no longer counts towards the rarity of its
+    //tokens, and tokens left in no live document are dropped
+    for (QString const &token: mDocuments[id].tokens)
+    {
+        auto const postings = mPostings.find(token);
+        if (postings != mPostings.end() && --postings.value().count == 0)
+            mPostings.erase(postings);
+    }
+    mDocuments[id] = Document{QString{}, QString{}, false, {}};
+    mLiveDocuments--;
+
+    //Drop removed ids once they outnumber the live ones
+    int const removedDocuments{mDocuments.size() - 1 - mLiveDocuments};
+    if (removedDocuments > qMax(1024, mLiveDocuments))
+        compact();
+}
+
+/**
+ * @brief FullTextIndex::update
+ * Indexes the new definition of a term.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param definition the definition
+ */
+void FullTextIndex::update(QString const &dictionary, QString const &term,
+                           QString const &definition)
+{
+    QHash<QString, quint32> const frequencies{tokenize(definition)};
+    Key const key{dictionary, term};
+
+    QMutexLocker locker{&mMutex};
+    if (mSynchronizing)
+        mTouched.insert(key);
+    removeDocument(key);
+    addDocument(key, frequencies);
+}
+
+/**
+ * @brief FullTextIndex::update
+ * Indexes a definition given in pieces, decoding one piece
+ * at a time into the same buffer. Pieces must not split
+ * words, so the editor splits large definitions at line
+ * breaks.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param parts the pieces of the UTF-8 encoded definition
+ */
+void FullTextIndex::update(QString const &dictionary, QString const &term,
+                           QVector<QByteArray> const &parts)
+{
+    QHash<QString, quint32> frequencies;
+    QString text;
+    //Invalid bytes decode to replacement characters, which
+    //are not letters, so they never make up a token
+    for (QByteArray const &part: parts)
+    {
+        TextCodec::decode(part, text);
+        QHash<QString, quint32> const partFrequencies{tokenize(text)};
+        for (auto token = partFrequencies.constBegin(); token != partFrequencies.constEnd(); ++token)
+            frequencies[token.key()] += token.value();
+    }
+    Key const key{dictionary, term};
+
+    QMutexLocker locker{&mMutex};
+    if (mSynchronizing)
+        mTouched.insert(key);
+    removeDocument(key);
+    addDocument(key, frequencies);
+}
+
+/**
+ * @brief FullTextIndex::remove
+ * Removes a deleted term from the index.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ */
+void FullTextIndex::remove(QString const &dictionary, QString const &term)
+{
+    Key const key{dictionary, term};
+
+    QMutexLocker locker{&mMutex};
+    if (mSynchronizing)
+        mTouched.insert(key);
+    removeDocument(key);
+}
+
+/**
+ * @brief FullTextIndex::rename
+ * Follows the rename of a term. Its postings keep
+ * pointing at the same id.
+ * @param dictionary the dictionary of the term
+ * @param term the current term name
+ * @param newName the new term name
+ */
+void FullTextIndex::rename(QString const &dictionary, QString const &term,
+                           QString const &newName)
+{
+    Key const key{dictionary, term};
+    Key const newKey{dictionary, newName};
+
+    QMutexLocker locker{&mMutex};
+    if (mSynchronizing)
+    {
+        mTouched.insert(key);
+        mTouched.insert(newKey);
+    }
+
+    if (key == newKey)
+        return;
+
+    //Removing the document replaced may compact the index and
+    //renumber the documents, so the id is only looked up after
+    removeDocument(newKey);
+    quint32 const id{mDocumentIds.take(key)};
+    if (id == 0)
+        return;
+    mDocuments[id].term = newName;
+    mDocumentIds.insert(newKey, id);
+}
+
+/**
+ * @brief FullTextIndex::renameDictionary
+ * Follows the rename of a dictionary. Renaming its folder
+ * leaves the pack as it is, so its stamp is kept and
+ * nothing is indexed again.
+ * @param dictionary the current dictionary name
+ * @param newName the new dictionary name
+ */
+void FullTextIndex::renameDictionary(QString const &dictionary, QString const &newName)
+{
+    QMutexLocker locker{&mMutex};
+
+    QList<Key> keys;
+    for (auto document = mDocumentIds.constBegin(); document != mDocumentIds.constEnd(); ++document)
+        if (document.key().first == dictionary)
+            keys.push_back(document.key());
+    for (Key const &key: keys)
+    {
+        Key const newKey{newName, key.second};
+        if (mSynchronizing)
+        {
+            mTouched.insert(key);
+            mTouched.insert(newKey);
+        }
+        quint32 const id{mDocumentIds.take(key)};
+        mDocuments[id].dictionary = newName;
+        mDocumentIds.insert(newKey, id);
+    }
+
+    if (mStamps.contains(dictionary))
+        mStamps.insert(newName, mStamps.take(dictionary));
+}
+
+/**
+ * @brief FullTextIndex::forgetDictionary
+ * Follows the deletion of a dictionary.
+ * @param dictionary the dictionary name
+ */
+void FullTextIndex::forgetDictionary(QString const &dictionary)
+{
+    QMutexLocker locker{&mMutex};
+    removeDictionary(dictionary);
+    mStamps.remove(dictionary);
+}
+
+/**
+ * @brief FullTextIndex::search
+ * Finds the definitions containing every word of the query,
+ * ranked by how often the words appear, weighted by how
+ * rare they are.
+ * @param query the words to look for
+ * @param limit the maximum number of hits
+ * @return the hits, best first
+ */
+QVector<FullTextIndex::Hit> FullTextIndex::search(QString const &query, int limit) const
+{
+    QStringList const tokens{tokenize(query).keys()};
+    if (tokens.isEmpty())
+        return QVector<Hit>{};
+
+    QMutexLocker locker{&mMutex};
+
+    double const documents{static_cast<double>(qMax(1, mLiveDocuments))};
+    QHash<quint32, double> scores;
+    QHash<quint32, int> matches;
+    for (QString const &token: tokens)
+    {
+        auto const postings = mPostings.constFind(token);
+        if (postings == mPostings.constEnd())
+            return QVector<Hit>{};
+
+        double const rarity{std::log(1.0 + documents / postings.value().count)};
+        char const *position{postings.value().data.constData()};
+        char const *const end{position + postings.value().data.size()};
+        quint32 id{0};
+        while (position < end)
+        {
+            id += readVarint(position);
+            double const frequency{static_cast<double>(readVarint(position))};
+            if (!mDocuments[static_cast<int>(id)].live)
+                continue;
+            scores[id] += rarity * frequency / (frequency + 1.2);
+            matches[id]++;
+        }
+    }
+
+    QVector<Hit> hits;
+    for (auto score = scores.constBegin(); score != scores.constEnd(); ++score)
+    {
+        if (matches.value(score.key()) != tokens.size())
+            continue;
+        Document const &document{mDocuments[static_cast<int>(score.key())]};
+        hits.push_back(Hit{document.dictionary, document.term, score.value()});
+    }
+    locker.unlock();
+
+    std::sort(hits.begin(), hits.end(), [](Hit const &a, Hit const &b) {
+        return a.score > b.score;
+    });
+    if (hits.size() > limit)
+        hits.resize(limit);
+    return hits;
+}
+
+/**
+ * @brief FullTextIndex::compact
+ * Renumbers the live documents and rewrites the postings
+ * without removed ids. The caller holds the lock.
+ */
+void FullTextIndex::compact()
+{
+    QVector<quint32> newIds(mDocuments.size(), 0);
+    QVector<Document> documents;
+    documents.reserve(mLiveDocuments + 1);
+    documents.push_back(mDocuments[0]);
+    for (int id = 1; id < mDocuments.size(); id++)
+    {
+        if (!mDocuments[id].live)
+            continue;
+        newIds[id] = static_cast<quint32>(documents.size());
+        documents.push_back(mDocuments[id]);
+    }
+
+    for (auto postings = mPostings.begin(); postings != mPostings.end();)
+    {
+        Postings compacted{QByteArray{}, 0, 0};
+        char const *position{postings.value().data.constData()};
+        char const *const end{position + postings.value().data.size()};
+        quint32 id{0};
+        while (position < end)
+        {
+            id += readVarint(position);
+            quint32 const frequency{readVarint(position)};
+            quint32 const newId{newIds[static_cast<int>(id)]};
+            if (newId == 0)
+                continue;
+            appendVarint(compacted.data, newId - compacted.lastDocument);
+            appendVarint(compacted.data, frequency);
+            compacted.lastDocument = newId;
+            compacted.count++;
+        }
+
+        if (compacted.count == 0)
+            postings = mPostings.erase(postings);
+        else
+        {
+            postings.value() = compacted;
+            ++postings;
+        }
+    }
+
+    mDocuments = documents;
+    mDocumentIds.clear();
+    for (int id = 1; id < mDocuments.size(); id++)
+        mDocumentIds.insert(Key{mDocuments[id].dictionary, mDocuments[id].term},
+                            static_cast<quint32>(id));
+}
+
+/**
+ * @brief FullTextIndex::stamp
+ * @param storage the storage holding the dictionaries
+ * @param dictionary the dictionary name
+ * @return the size and modification time of its pack
+ */
+FullTextIndex::Stamp FullTextIndex::stamp(Storage *storage, QString const &dictionary)
+{
+    QFileInfo const pack{storage->packPath(dictionary)};
+    if (!pack.exists())
+        return Stamp{-1, -1};
+    return Stamp{pack.size(), pack.lastModified().toMSecsSinceEpoch()};
+}
+
+/**
+ * @brief FullTextIndex::removeDictionary
+ * Marks every definition of a dictionary as removed, except
+ * those updated while the index is being synchronized. The
+ * caller holds the lock.
+ * @param dictionary the dictionary name
+ */
+void FullTextIndex::removeDictionary(QString const &dictionary)
+{
+    QList<Key> keys;
+    for (auto document = mDocumentIds.constBegin(); document != mDocumentIds.constEnd(); ++document)
+        if (document.key().first == dictionary && !mTouched.contains(document.key()))
+            keys.push_back(document.key());
+    for (Key const &key: keys)
+        removeDocument(key);
+}
+
+/**
+ * @brief FullTextIndex::reindexDictionary
+ * Indexes every definition of a dictionary again.
+ * @param storage the storage holding the dictionaries
+ * @param dictionary the dictionary name
+ */
+void FullTextIndex::reindexDictionary(Storage *storage, QString const &dictionary)
+{
+    QSharedPointer<TermStore> const store{storage->store(dictionary)};
+    if (store.isNull())
+        return;
+
+    QMutexLocker locker{&mMutex};
+    removeDictionary(dictionary);
+    locker.unlock();
+
+    //The definitions are decoded into the same buffer one after another
+    QByteArray contents;
+    QString text;
+    for (QString const &term: store->terms())
+    {
+        if (!store->read(term, contents))
+            continue;
+        TextCodec::decode(contents, text);
+        QHash<QString, quint32> const frequencies{tokenize(text)};
+
+        //Definitions saved meanwhile have already been indexed
+        Key const key{dictionary, term};
+        locker.relock();
+        if (!mTouched.contains(key))
+        {
+            removeDocument(key);
+            addDocument(key, frequencies);
+        }
+        locker.unlock();
+    }
+}
+
+/**
+ * @brief FullTextIndex::synchronize
+ * Indexes the dictionaries whose pack changed since the index
+ * was saved and forgets those that no longer exist. Meant to
+ * run on a worker thread; terms updated meanwhile through
+ * update(), remove() and rename() are left alone.
+ * @param storage the storage holding the dictionaries
+ * @return whether any dictionary was indexed or forgotten
+ */
+bool FullTextIndex::synchronize(Storage *storage)
+{
+    QStringList const dictionaries{storage->dictionaries()};
+
+    bool changed{false};
+    QMutexLocker locker{&mMutex};
+    mSynchronizing = true;
+    mTouched.clear();
+    for (QString const &dictionary: mStamps.keys())
+    {
+        if (dictionaries.contains(dictionary))
+            continue;
+        removeDictionary(dictionary);
+        mStamps.remove(dictionary);
+        changed = true;
+    }
+    locker.unlock();
+
+    for (QString const &dictionary: dictionaries)
+    {
+        //Take the stamp first, saves made while indexing are
+        //indexed on their own and stamped when the index is saved
+        Stamp const current{stamp(storage, dictionary)};
+        locker.relock();
+        bool const upToDate{mStamps.contains(dictionary) && mStamps.value(dictionary) == current};
+        locker.unlock();
+        if (upToDate)
+            continue;
+
+        reindexDictionary(storage, dictionary);
+        changed = true;
+
+        locker.relock();
+        mStamps.insert(dictionary, current);
+        locker.unlock();
+    }
+
+    locker.relock();
+    mSynchronizing = false;
+    mTouched.clear();
+    return changed;
+}
+
+/**
+ * @brief FullTextIndex::load
+ * Reads the index. A missing or damaged index is left empty,
+ * so that synchronize() builds it again.
+ * @return whether the index was read
+ */
+bool FullTextIndex::load()
+{
+    QFile file{mPath};
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream inStream{&file};
+    inStream.setVersion(QDataStream::Qt_5_0);
+
+    char magic[4];
+    quint32 version{0};
+    if (inStream.readRawData(magic, 4) != 4 ||
+            std::memcmp(magic, indexMagic, 4) != 0)
+        return false;
+    inStream >> version;
+    if (version != indexVersion)
+        return false;
+
+    QHash<QString, Stamp> stamps;
+    quint32 count{0};
+    inStream >> count;
+    for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+    {
+        QByteArray dictionary;
+        Stamp stamp;
+        inStream >> dictionary >> stamp.size >> stamp.modified;
+        stamps.insert(QString::fromUtf8(dictionary), stamp);
+    }
+
+    QVector<Document> documents;
+    documents.push_back(Document{QString{}, QString{}, false, {}});
+    inStream >> count;
+    for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+    {
+        QByteArray dictionary;
+        QByteArray term;
+        inStream >> dictionary >> term;
+        documents.push_back(Document{QString::fromUtf8(dictionary), QString::fromUtf8(term), true, {}});
+    }
+
+    QHash<QString, Postings> postings;
+    inStream >> count;
+    postings.reserve(static_cast<int>(count));
+    for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+    {
+        QByteArray token;
+        Postings list;
+        inStream >> token >> list.count >> list.lastDocument >> list.data;
+        postings.insert(QString::fromUtf8(token), list);
+    }
+
+    //The tokens of each document are only kept in the postings
+    for (auto list = postings.constBegin(); list != postings.constEnd(); ++list)
+    {
+        char const *position{list.value().data.constData()};
+        char const *const end{position + list.value().data.size()};
+        quint32 id{0};
+        while (position < end)
+        {
+            id += readVarint(position);
+            readVarint(position);
+            if (id < static_cast<quint32>(documents.size()))
+                documents[static_cast<int>(id)].tokens.push_back(list.key());
+        }
+    }
+
+    if (inStream.status() != QDataStream::Ok)
+        return false;
+
+    QMutexLocker locker{&mMutex};
+    mStamps = stamps;
+    mDocuments = documents;
+    mPostings = postings;
+    mLiveDocuments = documents.size() - 1;
+    mDocumentIds.clear();
+    for (int id = 1; id < mDocuments.size(); id++)
+        mDocumentIds.insert(Key{mDocuments[id].dictionary, mDocuments[id].term},
+                            static_cast<quint32>(id));
+    return true;
+}
+
+/**
+ * @brief FullTextIndex::save
+ * Compacts the index and writes it, stamped with the current
+ * state of every pack. Call it once the dictionaries have been
+ * closed, so that the stamps match what will be found on disk.
+ * @param storage the storage holding the dictionaries
+ * @return whether the index was written
+ */
+bool FullTextIndex::save(Storage *storage)
+{
+    QMutexLocker locker{&mMutex};
+    compact();
+
+    for (QString const &dictionary: mStamps.keys())
+        mStamps.insert(dictionary, stamp(storage, dictionary));
+
+    QSaveFile file{mPath};
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream outStream{&file};
+    outStream.setVersion(QDataStream::Qt_5_0);
+    outStream.writeRawData(indexMagic, 4);
+    outStream << indexVersion;
+
+    outStream << static_cast<quint32>(mStamps.size());
+    for (auto stamp = mStamps.constBegin(); stamp != mStamps.constEnd(); ++stamp)
+        outStream << stamp.key().toUtf8() << stamp.value().size << stamp.value().modified;
+
+    //After compacting, ids are the positions of the documents
+    outStream << static_cast<quint32>(mDocuments.size() - 1);
+    for (int id = 1; id < mDocuments.size(); id++)
+        outStream << mDocuments[id].dictionary.toUtf8() << mDocuments[id].term.toUtf8();
+
+    outStream << static_cast<quint32>(mPostings.size());
+    for (auto postings = mPostings.constBegin(); postings != mPostings.constEnd(); ++postings)
+        outStream << postings.key().toUtf8() << postings.value().count
+                  << postings.value().lastDocument << postings.value().data;
+
+    return outStream.status() == QDataStream::Ok && file.commit();
+}
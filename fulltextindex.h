@@ -0,0 +1,105 @@
+#ifndef FULLTEXTINDEX_H
+#define FULLTEXTINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+#include <QMutex>
+
+class Storage;
+
+class FullTextIndex
+{
+public:
+    struct Hit
+    {
+        QString dictionary;
+        QString term;
+        double score;
+    };
+
+    explicit FullTextIndex(QString const &path);
+
+    bool load();
+
+    bool save(Storage *storage);
+
+    bool synchronize(Storage *storage);
+
+    void update(QString const &dictionary, QString const &term, QString const &definition);
+
+    void update(QString const &dictionary, QString const &term, QVector<QByteArray> const &parts);
+
+    void remove(QString const &dictionary, QString const &term);
+
+    void rename(QString const &dictionary, QString const &term, QString const &newName);
+
+    void renameDictionary(QString const &dictionary, QString const &newName);
+
+    void forgetDictionary(QString const &dictionary);
+
+    QVector<Hit> search(QString const &query, int limit) const;
+
+    static QHash<QString, quint32> tokenize(QString const &text);
+
+private:
+    typedef QPair<QString, QString> Key;
+
+    struct Document
+    {
+        QString dictionary;
+        QString term;
+        bool live;
+        //So that removing the document can update the counts
+        //of its postings
+        QVector<QString> tokens;
+    };
+
+    struct Postings
+    {
+        //Pairs of document id deltas and term frequencies as varints
+        QByteArray data;
+        quint32 lastDocument;
+        //Live documents in the list, removed ones stay until compacted
+        quint32 count;
+    };
+
+    struct Stamp
+    {
+        qint64 size;
+        qint64 modified;
+
+        bool operator==(Stamp const &other) const
+        {
+            return size == other.size && modified == other.modified;
+        }
+    };
+
+    void addDocument(Key const &key, QHash<QString, quint32> const &frequencies);
+
+    void removeDocument(Key const &key);
+
+    void removeDictionary(QString const &dictionary);
+
+    void reindexDictionary(Storage *storage, QString const &dictionary);
+
+    void compact();
+
+    static Stamp stamp(Storage *storage, QString const &dictionary);
+
+    QString const mPath;
+    mutable QMutex mMutex;
+    QVector<Document> mDocuments;
+    QHash<Key, quint32> mDocumentIds;
+    QHash<QString, Postings> mPostings;
+    QHash<QString, Stamp> mStamps;
+    int mLiveDocuments;
+    bool mSynchronizing;
+    QSet<Key> mTouched;
+};
+
+#endif // FULLTEXTINDEX_H
@@ -0,0 +1,221 @@
+#include "fuzzymatcher.h"
+
+#include <QPair>
+#include <algorithm>
+#include <cstdlib>
+
+/* The terms are kept in a BK-tree: every node is a folded term
+ * and its children are grouped by their edit distance to it.
+ * By the triangle inequality, a child at distance e from a node
+ * at distance d from the query can only hold matches within t
+ * of the query if |e - d| <= t, so most of the tree is skipped.
+ */
+
+/**
+ * @brief maxDistance
+ * @param query the folded query
+ * @return how many edits are tolerated for a query of its length
+ */
+static int maxDistance(QString const &query)
+{
+    if (query.size() <= 3)
+        return 1;
+    if (query.size() <= 7)
+        return 2;
+    return 3;
+}
+
+/**
+ * @brief FuzzyMatcher::FuzzyMatcher
+ * Creates an empty matcher.
+ */
+FuzzyMatcher::FuzzyMatcher() :
+    mSize{0}
+{
+}
+
+/**
+ * @brief FuzzyMatcher::fold
+ * Folds case and strips diacritics, so that "Ёлка", "елка"
+ * and "ЕЛКА" are the same key, as are "café" and "Cafe".
+ * @param text the text to fold
+ * @return the folded text
+ */
+QString FuzzyMatcher::fold(QString const &text)
+{
+    QString const decomposed{text.normalized(QString::NormalizationForm_KD)};
+    QString folded;
+    folded.reserve(decomposed.size());
+    for (QChar const character: decomposed)
+        if (character.category() != QChar::Mark_NonSpacing)
+            folded += character.toCaseFolded();
+    return folded;
+}
+
+/**
+ * @brief FuzzyMatcher::distance
+ * @param a the first folded text
+ * @param b the second folded text
+ * @return the Levenshtein distance between them
+ */
+int FuzzyMatcher::distance(QString const &a, QString const &b) const
+{
+    //Only one row of the table is kept, diagonal holds the
+    //value above and to the left of the cell being computed
+    mRow.resize(b.size() + 1);
+    for (int j = 0; j <= b.size(); j++)
+        mRow[j] = j;
+
+    for (int i = 1; i <= a.size(); i++)
+    {
+        int diagonal{mRow[0]};
+        mRow[0] = i;
+        QChar const character{a[i - 1]};
+        for (int j = 1; j <= b.size(); j++)
+        {
+            int const above{mRow[j]};
+            int const substitution{diagonal + (character == b[j - 1] ? 0 : 1)};
+            mRow[j] = std::min({above + 1, mRow[j - 1] + 1, substitution});
+            diagonal = above;
+        }
+    }
+    return mRow[b.size()];
+}
+
+/**
+ * @brief FuzzyMatcher::insert
+ * Adds a term, unless it is already known.
+ * @param term the term name
+ */
+void FuzzyMatcher::insert(QString const &term)
+{
+    QString const key{fold(term)};
+    if (mNodes.isEmpty())
+    {
+        mNodes.push_back(Node{key, QStringList{term}, 0, -1, -1});
+        mSize++;
+        return;
+    }
+
+    int node{0};
+    while (true)
+    {
+        int const d{distance(key, mNodes[node].key)};
+        if (d == 0)
+        {
+            if (!mNodes[node].terms.contains(term))
+            {
+                mNodes[node].terms.push_back(term);
+                mSize++;
+            }
+            return;
+        }
+
+        int child{mNodes[node].firstChild};
+        while (child != -1 && mNodes[child].distance != d)
+            child = mNodes[child].nextSibling;
+
+        if (child == -1)
+        {
+            //Link the new node as the first child of the node
+            mNodes.push_back(Node{key, QStringList{term}, d, -1, mNodes[node].firstChild});
+            mNodes[node].firstChild = mNodes.size() - 1;
+            mSize++;
+            return;
+        }
+        node = child;
+    }
+}
+
+/**
+ * @brief FuzzyMatcher::remove
+ * Forgets a term. Its node stays in the tree, since its
+ * children are placed by their distance to it.
+ * @param term the term name
+ */
+void FuzzyMatcher::remove(QString const &term)
+{
+    QString const key{fold(term)};
+    int node{mNodes.isEmpty() ? -1 : 0};
+    while (node != -1)
+    {
+        int const d{distance(key, mNodes[node].key)};
+        if (d == 0)
+        {
+            if (mNodes[node].terms.removeOne(term))
+                mSize--;
+            return;
+        }
+
+        int child{mNodes[node].firstChild};
+        while (child != -1 && mNodes[child].distance != d)
+            child = mNodes[child].nextSibling;
+        node = child;
+    }
+}
+
+/**
+ * @brief FuzzyMatcher::search
+ * Finds the terms closest to the query. Only a few edits
+ * are tolerated, and fewer once enough terms are found.
+ * @param query the text to match
+ * @param count the maximum number of terms
+ * @return the terms, closest first
+ */
+QStringList FuzzyMatcher::search(QString const &query, int count) const
+{
+    if (mNodes.isEmpty() || count <= 0)
+        return QStringList{};
+
+    QString const key{fold(query)};
+    int tolerance{maxDistance(key)};
+
+    //The closest nodes so far, as distance and node pairs
+    QVector<QPair<int, int>> best;
+    int found{0};
+
+    QVector<int> pending{0};
+    while (!pending.isEmpty())
+    {
+        int const node{pending.takeLast()};
+        int const d{distance(key, mNodes[node].key)};
+
+        if (d <= tolerance && !mNodes[node].terms.isEmpty())
+        {
+            QPair<int, int> const match{d, node};
+            best.insert(std::upper_bound(best.begin(), best.end(), match), match);
+            found += mNodes[node].terms.size();
+
+            //Once enough terms are found, only closer ones matter
+            while (found - mNodes[best.last().second].terms.size() >= count)
+            {
+                found -= mNodes[best.last().second].terms.size();
+                best.removeLast();
+            }
+            if (found >= count)
+                tolerance = best.last().first;
+        }
+
+        for (int child = mNodes[node].firstChild; child != -1; child = mNodes[child].nextSibling)
+            if (std::abs(mNodes[child].distance - d) <= tolerance)
+                pending.push_back(child);
+    }
+
+    QStringList terms;
+    for (QPair<int, int> const &match: best)
+    {
+        QStringList names{mNodes[match.second].terms};
+        names.sort(Qt::CaseInsensitive);
+        terms << names;
+    }
+    return terms.mid(0, count);
+}
+
+/**
+ * @brief FuzzyMatcher::size
+ * @return the number of terms
+ */
+int FuzzyMatcher::size() const
+{
+    return mSize;
+}
@@ -0,0 +1,48 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+#include <QMetaType>
+
+class FuzzyMatcher
+{
+public:
+    FuzzyMatcher();
+
+    void insert(QString const &term);
+
+    void remove(QString const &term);
+
+    QStringList search(QString const &query, int count) const;
+
+    int size() const;
+
+    static QString fold(QString const &text);
+
+private:
+    struct Node
+    {
+        //The folded term, every term folding to it is kept in terms
+        QString key;
+        QStringList terms;
+        //Distance to the parent key
+        int distance;
+        int firstChild;
+        int nextSibling;
+    };
+
+    int distance(QString const &a, QString const &b) const;
+
+    QVector<Node> mNodes;
+    int mSize;
+
+    //Reused by distance to avoid allocating on every comparison
+    mutable QVector<int> mRow;
+};
+
+Q_DECLARE_METATYPE(QSharedPointer<FuzzyMatcher>)
+
+#endif // FUZZYMATCHER_H
@@ -0,0 +1,494 @@
+#include "history.h"
+
+#include <QDataStream>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <cstring>
+#include <iterator>
+
+/* The snapshot stores each dictionary and term name once,
+ * followed by the entries as pairs of ids:
+ *
+ * header   "NSHS", version
+ * names    dictionary count and names, then term count and names
+ * entries  entry count, then the dictionary id and term id of
+ *          every entry, most recent first
+ *
+ * The journal starts with "NSHJ" and the version, followed by
+ * records. The name behind an id is written the first time the
+ * journal uses it, and each visit is a pair of ids, so visiting
+ * a term again appends nine bytes. Names are UTF-8 with their
+ * size in front, so they may contain any character, slashes
+ * included.
+ */
+char const snapshotMagic[4]{'N', 'S', 'H', 'S'};
+char const journalMagic[4]{'N', 'S', 'H', 'J'};
+quint32 const formatVersion{1};
+
+QDataStream::Version const streamVersion{QDataStream::Qt_5_0};
+
+//The records of the journal
+enum JournalRecord : quint8
+{
+    DictionaryName = 1,
+    TermName = 2,
+    Visit = 3
+};
+
+//Keep at most this many entries, older ones fall off the end
+int const maxLength{50};
+
+//Rewrite the snapshot once this many visits have been journaled
+int const compactionThreshold{64};
+
+/**
+ * @brief History::Names::intern
+ * @param name a dictionary or term name
+ * @return the id of the name, added if it is new
+ */
+quint32 History::Names::intern(QString const &name)
+{
+    auto const id = ids.constFind(name);
+    if (id != ids.constEnd())
+        return id.value();
+
+    names.push_back(name);
+    ids.insert(name, static_cast<quint32>(names.size() - 1));
+    return static_cast<quint32>(names.size() - 1);
+}
+
+/**
+ * @brief History::History
+ * Creates an empty history. Call load() to read the
+ * snapshot and the journal from disk.
+ * @param snapshotPath the file holding the compacted history
+ * @param journalPath the file where visits are appended
+ * until the next compaction
+ */
+History::History(QString const &snapshotPath, QString const &journalPath) :
+    mSnapshotPath{snapshotPath},
+    mJournalPath{journalPath},
+    mRotatedJournalPath{journalPath + ".old"},
+    mJournal{journalPath},
+    mJournalLength{0}
+{
+}
+
+/**
+ * @brief History::~History
+ * Waits for a running compaction so that the snapshot
+ * is never left half written.
+ */
+History::~History()
+{
+    mCompaction.waitForFinished();
+    mJournal.close();
+}
+
+/**
+ * @brief History::load
+ * Reads the snapshot and replays the journals on top of it.
+ * A journal left behind by an interrupted compaction is
+ * replayed too; replaying visits that are already part of
+ * the snapshot does not change the order of the entries.
+ */
+void History::load()
+{
+    mEntries.clear();
+    mPositions.clear();
+    mDictionaries = Names{};
+    mTerms = Names{};
+
+    QFile snapshot{mSnapshotPath};
+    if (snapshot.open(QIODevice::ReadOnly))
+    {
+        QDataStream inStream{&snapshot};
+        inStream.setVersion(streamVersion);
+
+        char magic[4];
+        quint32 version{0};
+        if (inStream.readRawData(magic, 4) == 4 &&
+                std::memcmp(magic, snapshotMagic, 4) == 0)
+            inStream >> version;
+
+        auto const readNames = [&inStream](QStringList &names) {
+            quint32 count{0};
+            inStream >> count;
+            for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+            {
+                QByteArray name;
+                inStream >> name;
+                names.push_back(QString::fromUtf8(name));
+            }
+        };
+
+        QStringList dictionaries;
+        QStringList terms;
+        QVector<Record> records;
+        if (version == formatVersion)
+        {
+            readNames(dictionaries);
+            readNames(terms);
+            quint32 count{0};
+            inStream >> count;
+            for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+            {
+                Record record;
+                inStream >> record.first >> record.second;
+                if (inStream.status() == QDataStream::Ok &&
+                        record.first < static_cast<quint32>(dictionaries.size()) &&
+                        record.second < static_cast<quint32>(terms.size()))
+                    records.push_back(record);
+            }
+        }
+
+        //The snapshot is stored most recent first, so read it
+        //backwards to rebuild the order with moveToFront
+        for (int i = records.size() - 1; i >= 0; i--)
+            moveToFront(Record{mDictionaries.intern(dictionaries[static_cast<int>(records[i].first)]),
+                               mTerms.intern(terms[static_cast<int>(records[i].second)])});
+    }
+
+    replay(mRotatedJournalPath);
+    replay(mJournalPath);
+}
+
+/**
+ * @brief History::replay
+ * Applies every visit recorded in the given journal.
+ * A record cut short by a crash ends the journal.
+ * @param path the journal to replay
+ */
+void History::replay(QString const &path)
+{
+    QFile journal{path};
+    if (!journal.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream inStream{&journal};
+    inStream.setVersion(streamVersion);
+
+    char magic[4];
+    quint32 version{0};
+    if (inStream.readRawData(magic, 4) != 4 || std::memcmp(magic, journalMagic, 4) != 0)
+        return;
+    inStream >> version;
+    if (version != formatVersion)
+        return;
+
+    //Ids are only meaningful inside the journal that names them,
+    //and a later name for the same id replaces the earlier one
+    QHash<quint32, QString> dictionaries;
+    QHash<quint32, QString> terms;
+    while (!inStream.atEnd() && inStream.status() == QDataStream::Ok)
+    {
+        quint8 type{0};
+        quint32 id{0};
+        inStream >> type >> id;
+        if (type == DictionaryName || type == TermName)
+        {
+            QByteArray name;
+            inStream >> name;
+            if (inStream.status() == QDataStream::Ok)
+                (type == DictionaryName ? dictionaries : terms).insert(id, QString::fromUtf8(name));
+        }
+        else if (type == Visit)
+        {
+            quint32 term{0};
+            inStream >> term;
+            if (inStream.status() != QDataStream::Ok ||
+                    !dictionaries.contains(id) || !terms.contains(term))
+                continue;
+            moveToFront(Record{mDictionaries.intern(dictionaries.value(id)),
+                               mTerms.intern(terms.value(term))});
+            if (path == mJournalPath)
+                mJournalLength++;
+        }
+        else
+            break;
+    }
+}
+
+/**
+ * @brief History::importText
+ * Reads the history saved as text by earlier versions, one
+ * "resources/<dictionary>/<term>" path per line, saves it
+ * in the current format, and removes the text files. Terms
+ * containing a slash could not be told apart in that format.
+ * @param snapshotPath the text snapshot, most recent first
+ * @param journalPath the text journal, oldest first
+ * @return whether there was a text history to import
+ */
+bool History::importText(QString const &snapshotPath, QString const &journalPath)
+{
+    QString const rotatedJournalPath{journalPath + ".old"};
+    if (!QFile::exists(snapshotPath) && !QFile::exists(journalPath) &&
+            !QFile::exists(rotatedJournalPath))
+        return false;
+
+    auto const readLines = [](QString const &path) {
+        QStringList lines;
+        QFile file{path};
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+            while (!file.atEnd())
+                lines.push_back(QString::fromUtf8(file.readLine().trimmed()));
+        return lines;
+    };
+
+    //Put the snapshot in the order of the journals, oldest first
+    QStringList lines{readLines(snapshotPath)};
+    std::reverse(lines.begin(), lines.end());
+    lines += readLines(rotatedJournalPath) + readLines(journalPath);
+
+    //Visits recorded in the current format are more recent
+    std::list<Record> const recent{mEntries};
+    for (QString const &line: lines)
+    {
+        int const termStart{line.lastIndexOf('/')};
+        if (termStart <= 0 || termStart == line.size() - 1)
+            continue;
+        int const dictionaryStart{line.lastIndexOf('/', termStart - 1) + 1};
+        QString const dictionary{line.mid(dictionaryStart, termStart - dictionaryStart)};
+        if (dictionary != "")
+            moveToFront(Record{mDictionaries.intern(dictionary), mTerms.intern(line.mid(termStart + 1))});
+    }
+    for (auto record = recent.rbegin(); record != recent.rend(); ++record)
+        moveToFront(*record);
+
+    compact();
+    mCompaction.waitForFinished();
+    if (!mCompaction.result())
+        return false;
+
+    QFile::remove(snapshotPath);
+    QFile::remove(journalPath);
+    QFile::remove(rotatedJournalPath);
+    return true;
+}
+
+/**
+ * @brief History::visit
+ * Moves the entry to the top of the history and records
+ * the visit in the journal. Visiting the entry that is
+ * already at the top does not touch the disk.
+ * @param dictionary the dictionary of the visited term
+ * @param term the visited term
+ */
+void History::visit(QString const &dictionary, QString const &term)
+{
+    Record const record{mDictionaries.intern(dictionary), mTerms.intern(term)};
+    if (!mEntries.empty() && mEntries.front() == record)
+        return;
+
+    moveToFront(record);
+    appendToJournal(record);
+
+    if (mJournalLength >= compactionThreshold)
+        compact();
+}
+
+/**
+ * @brief History::moveToFront
+ * Puts the entry at the top of the list, removing any
+ * previous occurrence, and drops the oldest entries
+ * once the history grows beyond its maximum length.
+ * @param record the entry to move
+ */
+void History::moveToFront(Record const &record)
+{
+    auto const position = mPositions.find(record);
+    if (position != mPositions.end())
+        mEntries.splice(mEntries.begin(), mEntries, position.value());
+    else
+    {
+        mEntries.push_front(record);
+        mPositions.insert(record, mEntries.begin());
+    }
+
+    while (mEntries.size() > static_cast<size_t>(maxLength))
+    {
+        mPositions.remove(mEntries.back());
+        mEntries.pop_back();
+    }
+}
+
+/**
+ * @brief History::appendToJournal
+ * Appends a visit to the journal, preceded by the names
+ * of its ids the first time the journal uses them.
+ * The journal is opened the first time it is needed.
+ * @param record the visited entry
+ */
+void History::appendToJournal(Record const &record)
+{
+    QByteArray bytes;
+    QDataStream outStream{&bytes, QIODevice::WriteOnly};
+    outStream.setVersion(streamVersion);
+
+    if (!mJournal.isOpen())
+    {
+        if (!mJournal.open(QIODevice::WriteOnly | QIODevice::Append))
+            return;
+
+        //Ids change between sessions and compactions, so each
+        //time the journal is opened the names are written again
+        mJournalDictionaries.clear();
+        mJournalTerms.clear();
+        if (mJournal.size() == 0)
+        {
+            outStream.writeRawData(journalMagic, 4);
+            outStream << formatVersion;
+        }
+    }
+
+    if (!mJournalDictionaries.contains(record.first))
+    {
+        outStream << static_cast<quint8>(DictionaryName) << record.first
+                  << mDictionaries.names[static_cast<int>(record.first)].toUtf8();
+        mJournalDictionaries.insert(record.first);
+    }
+    if (!mJournalTerms.contains(record.second))
+    {
+        outStream << static_cast<quint8>(TermName) << record.second
+                  << mTerms.names[static_cast<int>(record.second)].toUtf8();
+        mJournalTerms.insert(record.second);
+    }
+    outStream << static_cast<quint8>(Visit) << record.first << record.second;
+
+    mJournal.write(bytes);
+    mJournal.flush();
+    mJournalLength++;
+}
+
+/**
+ * @brief History::prune
+ * Forgets the names no entry uses any more and numbers
+ * the remaining ones again from zero.
+ */
+void History::prune()
+{
+    Names dictionaries;
+    Names terms;
+    std::list<Record> entries;
+    QHash<Record, std::list<Record>::iterator> positions;
+    for (Record const &record: mEntries)
+    {
+        entries.push_back(Record{dictionaries.intern(mDictionaries.names[static_cast<int>(record.first)]),
+                                 terms.intern(mTerms.names[static_cast<int>(record.second)])});
+        positions.insert(entries.back(), std::prev(entries.end()));
+    }
+
+    mEntries.swap(entries);
+    mPositions = positions;
+    mDictionaries = dictionaries;
+    mTerms = terms;
+}
+
+/**
+ * @brief History::compact
+ * Rotates the journal and rewrites the snapshot in the
+ * background. Visits made while the snapshot is being
+ * written go to the fresh journal.
+ */
+void History::compact()
+{
+    if (mCompaction.isRunning())
+        return;
+
+    //If the rotated journal is still around, the last compaction
+    //failed; keep appending to the current journal and replace
+    //the snapshot anyway, since replaying is harmless
+    mJournal.close();
+    if (!QFile::exists(mRotatedJournalPath))
+        QFile::rename(mJournalPath, mRotatedJournalPath);
+    mJournalLength = 0;
+
+    prune();
+    QVector<Record> records;
+    records.reserve(size());
+    for (Record const &record: mEntries)
+        records.push_back(record);
+    mCompaction = QtConcurrent::run(&History::writeSnapshot, mDictionaries.names, mTerms.names,
+                                    records, mSnapshotPath, mRotatedJournalPath);
+}
+
+/**
+ * @brief History::writeSnapshot
+ * Atomically replaces the snapshot with the given entries
+ * and removes the rotated journal they already include.
+ * Runs on a worker thread.
+ * @param dictionaries the dictionary names, by id
+ * @param terms the term names, by id
+ * @param records the entries to save, most recent first
+ * @param snapshotPath the snapshot file
+ * @param rotatedJournalPath the journal included in entries
+ * @return whether the snapshot was written
+ */
+bool History::writeSnapshot(QStringList const &dictionaries,
+                            QStringList const &terms,
+                            QVector<Record> const &records,
+                            QString const &snapshotPath,
+                            QString const &rotatedJournalPath)
+{
+    QSaveFile snapshot{snapshotPath};
+    if (!snapshot.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream outStream{&snapshot};
+    outStream.setVersion(streamVersion);
+    outStream.writeRawData(snapshotMagic, 4);
+    outStream << formatVersion;
+    for (QStringList const *names: {&dictionaries, &terms})
+    {
+        outStream << static_cast<quint32>(names->size());
+        for (QString const &name: *names)
+            outStream << name.toUtf8();
+    }
+    outStream << static_cast<quint32>(records.size());
+    for (Record const &record: records)
+        outStream << record.first << record.second;
+
+    if (outStream.status() != QDataStream::Ok || !snapshot.commit())
+        return false;
+
+    QFile::remove(rotatedJournalPath);
+    return true;
+}
+
+/**
+ * @brief History::size
+ * @return the number of entries in the history
+ */
+int History::size() const
+{
+    return static_cast<int>(mEntries.size());
+}
+
+/**
+ * @brief History::at
+ * @param index the position of the entry, where 0 is
+ * the most recent one
+ * @return the entry, or empty strings if out of range
+ */
+History::Entry History::at(int index) const
+{
+    if (index < 0 || index >= size())
+        return Entry{};
+    Record const &record{*std::next(mEntries.begin(), index)};
+    return Entry{mDictionaries.names[static_cast<int>(record.first)],
+                 mTerms.names[static_cast<int>(record.second)]};
+}
+
+/**
+ * @brief History::entries
+ * @return every entry, most recent first
+ */
+QVector<History::Entry> History::entries() const
+{
+    QVector<Entry> list;
+    list.reserve(size());
+    for (Record const &record: mEntries)
+        list.push_back(Entry{mDictionaries.names[static_cast<int>(record.first)],
+                             mTerms.names[static_cast<int>(record.second)]});
+    return list;
+}
@@ -0,0 +1,83 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QFile>
+#include <QFuture>
+#include <list>
+
+class History
+{
+public:
+    //The dictionary and the term of a visit
+    typedef QPair<QString, QString> Entry;
+
+    History(QString const &snapshotPath, QString const &journalPath);
+    ~History();
+
+    void load();
+
+    bool importText(QString const &snapshotPath, QString const &journalPath);
+
+    void visit(QString const &dictionary, QString const &term);
+
+    int size() const;
+
+    Entry at(int index) const;
+
+    QVector<Entry> entries() const;
+
+private:
+    //The ids of the dictionary and the term of a visit
+    typedef QPair<quint32, quint32> Record;
+
+    //The names behind the ids of a snapshot, a journal, or the history
+    struct Names
+    {
+        QStringList names;
+        QHash<QString, quint32> ids;
+
+        quint32 intern(QString const &name);
+    };
+
+    void moveToFront(Record const &record);
+
+    void replay(QString const &path);
+
+    void appendToJournal(Record const &record);
+
+    void compact();
+
+    void prune();
+
+    static bool writeSnapshot(QStringList const &dictionaries,
+                              QStringList const &terms,
+                              QVector<Record> const &records,
+                              QString const &snapshotPath,
+                              QString const &rotatedJournalPath);
+
+    QString const mSnapshotPath;
+    QString const mJournalPath;
+    QString const mRotatedJournalPath;
+
+    Names mDictionaries;
+    Names mTerms;
+    //Most recent entry first
+    std::list<Record> mEntries;
+    QHash<Record, std::list<Record>::iterator> mPositions;
+
+    QFile mJournal;
+    int mJournalLength;
+    //Ids whose names are already written in the journal
+    QSet<quint32> mJournalDictionaries;
+    QSet<quint32> mJournalTerms;
+    QFuture<bool> mCompaction;
+};
+
+#endif // HISTORY_H
@@ -1,11 +1,21 @@
 #include "mainwindow.h"
+#include "commandline.h"
 #include <QApplication>
+#include <QCoreApplication>
 #include <QDir>
 #include <QDebug>
 #include "delete.h"
 
 int main(int argc, char *argv[])
 {
+    //Commands run without a window, so that scripts can query
+    //the dictionaries without loading the widgets
+    if (CommandLine::isCommand(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        return CommandLine{}.run(a.arguments().mid(1));
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.setWindowTitle("NoteSpisok");
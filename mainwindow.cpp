@@ -1,6 +1,17 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "dialog.h"
+#include "termstore.h"
+#include "textcodec.h"
+#include <QtConcurrent>
+#include <QListWidgetItem>
+#include <QAbstractItemView>
+#include <QMenu>
+#include <QLabel>
+#include <QFileDialog>
+#include <QRegularExpression>
+#include <QSignalBlocker>
+#include <QAction>
 #include <QFile>
 #include <QIODevice>
 #include <QTextStream>
@@ -9,20 +20,52 @@
 #include <QDir>
 #include <QDebug>
 #include <QList>
-#include <QListWidgetItem>
 
 //All the dictionaries are saved in the resources folder
 QString const resourcesFolder{"resources/"};
 
 //The history file keeps track of viewed terms
-QString const historyFile{"resources/history.txt"};
+QString const historyFile{"resources/history.dat"};
+
+//The history journal records visits until the history file is compacted
+QString const historyJournal{"resources/history.log"};
+
+//Earlier versions kept the history as text in these files
+QString const textHistoryFile{"resources/history.txt"};
+QString const textHistoryJournal{"resources/history.journal"};
+
+//The full-text index maps the words of every definition to their terms
+QString const fullTextIndexFile{"resources/fulltext.idx"};
+
+//Search modes of the search box, in the order of the search mode combo box
+int const termSearch{0};
+int const definitionSearch{1};
+int const allDictionariesSearch{2};
+
+//Show at most this many definition search results
+int const maxSearchResults{200};
+
+//Suggest at most this many similar terms for a misspelled term
+int const maxSuggestions{10};
+
+//Prefetch this many terms above and below the viewed term
+int const prefetchRadius{3};
+
+//Prefetch this many of the terms reached with the back button
+int const prefetchHistory{5};
+
+//Milliseconds without typing before the search box is looked up
+int const searchDelay{150};
+
+//Milliseconds a searched term must stay displayed to enter the history
+int const searchHistoryDelay{1500};
+
+//Milliseconds between updates of the performance shown in the status bar
+int const performanceInterval{1000};
 
 //Keep track of the term of interest inside the history file
 int static historyEntry{-1};
 
-//The temp file is used while saving files
-QString const temporaryFile{"resources/temp.txt"};
-
 //Keep track of the last dictionary viewed
 QString static lastDictionary;
 
@@ -30,19 +73,21 @@ QString static lastDictionary;
 QString static lastTerm;
 
 /**
- * @brief MainWindow::currentTermFolder
- * Returns the current folder where terms are being saved.
+ * @brief MainWindow::termStore
+ * Returns the store where the terms of a dictionary are saved.
  * @param dictionary the dictionary, if any, where the
  * term of interest is stored
- * @return the current folder where terms are being saved
+ * @return the store of the dictionary, or nullptr if
+ * the dictionary cannot be opened
  */
-QString MainWindow::currentTermFolder(QString const &dictionary) const
+TermStore *MainWindow::termStore(QString const &dictionary)
 {
     //If a target dictionary is not provided then obtain
     //the current dictionary name from the combo box name
+    //The storage keeps the store open, so it outlives the pointer
     if (dictionary.isNull())
-        return resourcesFolder + ui->comboBoxDictionaries->currentText() + "/";
-    return resourcesFolder + dictionary + "/";
+        return mStorage.store(ui->comboBoxDictionaries->currentText()).data();
+    return mStorage.store(dictionary).data();
 }
 
 /**
@@ -60,57 +105,175 @@ void MainWindow::loadTermFolders()
     if (!dir.exists())
         dir.mkdir("../" + resourcesFolder);
 
-    //Add every term directory in the resourcesFolder to the combo box
-    for(QFileInfo item: dir.entryInfoList())
-    {
-        if (item.isDir() && item.baseName() != "")
-            ui->comboBoxDictionaries->addItem(item.baseName());
-            //Only use qPrintable for debugging
-            //qPrintable(item.baseName()) causes errors displaying cyrillic
-    }
+    //Cached definitions may belong to renamed or deleted dictionaries
+    mDefinitionCache.clear();
+
+    //Add every dictionary in the resourcesFolder to the combo box
+    for (QString const &dictionary: mStorage.dictionaries())
+        ui->comboBoxDictionaries->addItem(dictionary);
+        //Only use qPrintable for debugging
+        //qPrintable(dictionary) causes errors displaying cyrillic
 }
 
 /**
  * @brief MainWindow::loadTerms
- * Loads the terms that are inside the specified term folder.
+ * Starts loading the terms that are inside the dictionary
+ * specified by the combo box. The terms are read on a worker
+ * thread and arrive in batches through addLoadedTerms, so the
+ * window stays responsive while large dictionaries load.
  */
 void MainWindow::loadTerms()
 {
-    QDir dir{resourcesFolder};
-
-    //Change directory to the term folder specified by the combo box
-    QString const comboBoxDictionariesContents{
-        ui->comboBoxDictionaries->currentText()};
-    dir.cd(comboBoxDictionariesContents);
+    //Timed until the loader reports that every term is listed
+    mLoadStarted = Metrics::instance().now();
 
     //Disable the delete, save, and rename buttons because no terms are selected
     //Disable text editing because no terms are selected
-    ui->pushButtonDelete->setEnabled(false);
-    ui->pushButtonSave->setEnabled(false);
-    ui->pushButtonRename->setEnabled(false);
-    ui->textEdit->setEnabled(false);
+    setTermControlsEnabled(false);
+
+    //Empty the term model, which is shared by the term list and
+    //the string completer, and cancel any load still running
+    //The fuzzy matcher is rebuilt once the terms are loaded
+    mTermModel->clear();
+    mFuzzyMatcher.reset();
+    mPendingFuzzyEdits.clear();
+    mTermLoader->load(ui->comboBoxDictionaries->currentText());
+    mTermWatcher->watch(ui->comboBoxDictionaries->currentText());
+}
 
-    //Create a termList that will be used in the string completer
-    QStringList termList;
+/**
+ * @brief MainWindow::finishLoadingTerms
+ * Records how long the terms of the dictionary took to load.
+ */
+void MainWindow::finishLoadingTerms()
+{
+    Metrics &metrics{Metrics::instance()};
+    metrics.record(Metrics::MainWindowLoadTerms, mLoadStarted, metrics.now() - mLoadStarted);
+    mTermWatcher->finishSeeding();
+}
 
-    //Add every file inside the term folder into the widget list
-    //Add every filename to the termList
-    for(QFileInfo item: dir.entryInfoList())
+/**
+ * @brief MainWindow::addLoadedTerms
+ * Adds a batch of loaded terms to the term model. The terms
+ * can be searched while the rest of the dictionary loads.
+ * @param terms the sorted term names
+ */
+void MainWindow::addLoadedTerms(QStringList const &terms)
+{
+    mTermModel->insertTerms(terms);
+    mTermWatcher->seed(terms);
+    //Only use qPrintable for debugging
+    //qPrintable(term) causes errors displaying cyrillic
+
+    //Select the last-viewed term once it has been loaded, since
+    //it may have been viewed before its dictionary finished loading
+    if (!isTermSelected() && lastTerm != "" &&
+            lastDictionary == ui->comboBoxDictionaries->currentText())
     {
-        if (item.isFile())
-        {
-            ui->listWidgetEntries->addItem(item.fileName());
-            termList << item.fileName();
-            //Only use qPrintable for debugging
-            //qPrintable(item.baseName()) causes errors displaying cyrillic
-        }
+        int const row{mTermModel->find(lastTerm)};
+        if (row != -1)
+            ui->listViewEntries->setCurrentIndex(mTermModel->index(row));
     }
+}
 
-    //Create a new string completer using the termList
-    //Disable case sensitivity and set the completer
-    mStringCompleter = new QCompleter(termList, this);
-    mStringCompleter->setCaseSensitivity(Qt::CaseInsensitive);
-    ui->lineEditSearch->setCompleter(mStringCompleter);
+/**
+ * @brief MainWindow::setFuzzyMatcher
+ * Starts using the fuzzy matcher built over the loaded
+ * terms, adding the changes made while it was built.
+ * @param matcher the matcher over the current dictionary
+ */
+void MainWindow::setFuzzyMatcher(QSharedPointer<FuzzyMatcher> const &matcher)
+{
+    mFuzzyMatcher = matcher;
+    for (QPair<QString, bool> const &edit: mPendingFuzzyEdits)
+        updateFuzzyMatcher(edit.first, edit.second);
+    mPendingFuzzyEdits.clear();
+}
+
+/**
+ * @brief MainWindow::updateFuzzyMatcher
+ * Keeps the fuzzy matcher in step with the term list.
+ * @param term the term name
+ * @param inserted whether the term was added or removed
+ */
+void MainWindow::updateFuzzyMatcher(QString const &term, bool inserted)
+{
+    if (mFuzzyMatcher.isNull())
+        mPendingFuzzyEdits.push_back(qMakePair(term, inserted));
+    else if (inserted)
+        mFuzzyMatcher->insert(term);
+    else
+        mFuzzyMatcher->remove(term);
+}
+
+/**
+ * @brief MainWindow::suggestTerms
+ * Shows the terms closest to a misspelled term in a popup
+ * under the search box. Nothing is suggested while prefix
+ * completion still has terms to offer.
+ * @param text the text of the search box
+ */
+void MainWindow::suggestTerms(QString const &text)
+{
+    QStringList suggestions;
+    if (text != "" && !mFuzzyMatcher.isNull() && !mTermModel->hasPrefix(text))
+        suggestions = mFuzzyMatcher->search(text, maxSuggestions);
+
+    if (suggestions.isEmpty())
+    {
+        mFuzzyCompleter->popup()->hide();
+        return;
+    }
+
+    mFuzzyModel->setStringList(suggestions);
+    mFuzzyCompleter->complete();
+}
+
+/**
+ * @brief MainWindow::lookUpSuggestion
+ * Looks up the suggested term chosen from the popup.
+ * @param term the term name
+ */
+void MainWindow::lookUpSuggestion(QString const &term)
+{
+    //The choice is final, do not wait for typing to pause
+    ui->lineEditSearch->setText(term);
+    mSearchTimer->stop();
+    lookUpSearch();
+}
+
+/**
+ * @brief MainWindow::setTermControlsEnabled
+ * Enables or disables the save, delete, and rename buttons
+ * and text editing, which need a selected term.
+ * @param enabled whether a term is selected
+ */
+void MainWindow::setTermControlsEnabled(bool enabled)
+{
+    ui->pushButtonDelete->setEnabled(enabled);
+    ui->pushButtonSave->setEnabled(enabled);
+    ui->pushButtonRename->setEnabled(enabled);
+    ui->textEdit->setEnabled(enabled);
+}
+
+/**
+ * @brief MainWindow::isTermSelected
+ * @return whether a term is selected in the term list
+ */
+bool MainWindow::isTermSelected() const
+{
+    QModelIndex const current{ui->listViewEntries->currentIndex()};
+    return current.isValid() &&
+            ui->listViewEntries->selectionModel()->isSelected(current);
+}
+
+/**
+ * @brief MainWindow::selectedTerm
+ * @return the name of the current term in the term list
+ */
+QString MainWindow::selectedTerm() const
+{
+    return mTermModel->term(ui->listViewEntries->currentIndex().row());
 }
 
 /**
@@ -119,14 +282,153 @@ void MainWindow::loadTerms()
  * @param parent
  */
 MainWindow::MainWindow(QWidget *parent) :
-    QMainWindow{parent}, ui{new Ui::MainWindow}
+    QMainWindow{parent}, ui{new Ui::MainWindow},
+    mLoadStarted{0},
+    mImporting{false},
+    mStorage{resourcesFolder},
+    mHistory{historyFile, historyJournal},
+    mFullTextIndex{fullTextIndexFile},
+    mDefinitionCache{Configuration::cacheBudget()}
 {
     ui->setupUi(this);
+
+    //Definitions may be stored compressed
+    mStorage.setCompression(Configuration::compression());
+
+    //The term list and the string completer share a single model
+    //Disable case sensitivity and set the completer
+    mTermModel = new TermListModel{this};
+    ui->listViewEntries->setModel(mTermModel);
+    mStringCompleter = new QCompleter{mTermModel, this};
+    mStringCompleter->setCaseSensitivity(Qt::CaseInsensitive);
+    mStringCompleter->setModelSorting(QCompleter::CaseInsensitivelySortedModel);
+    ui->lineEditSearch->setCompleter(mStringCompleter);
+
+    //Misspelled terms get suggestions from a second completer,
+    //which shows whatever it is given instead of filtering
+    mFuzzyModel = new QStringListModel{this};
+    mFuzzyCompleter = new QCompleter{mFuzzyModel, this};
+    mFuzzyCompleter->setWidget(ui->lineEditSearch);
+    mFuzzyCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    QObject::connect(mFuzzyCompleter, SIGNAL(activated(QString)),
+                     this, SLOT(lookUpSuggestion(QString)));
+
+    //Keystrokes only restart the search timer, the search box
+    //is looked up once typing pauses, and the term it shows is
+    //only added to the history once it has been left in view
+    mSearchTimer = new QTimer{this};
+    mSearchTimer->setSingleShot(true);
+    mSearchTimer->setInterval(searchDelay);
+    QObject::connect(mSearchTimer, SIGNAL(timeout()), this, SLOT(lookUpSearch()));
+    mHistoryTimer = new QTimer{this};
+    mHistoryTimer->setSingleShot(true);
+    mHistoryTimer->setInterval(searchHistoryDelay);
+    QObject::connect(mHistoryTimer, SIGNAL(timeout()), this, SLOT(commitSearchHistory()));
+
+    //Definitions are searched on a worker thread, watching a new
+    //search stops the results of the previous one from arriving
+    mDefinitionSearch = new QFutureWatcher<QVector<FullTextIndex::Hit>>{this};
+    QObject::connect(mDefinitionSearch, SIGNAL(finished()), this, SLOT(showDefinitionResults()));
+
+    //Term names are searched across every dictionary at once on
+    //a thread pool, each dictionary adding its matches when done
+    mTermSearch = new TermSearch{&mStorage, this};
+    QObject::connect(mTermSearch, SIGNAL(matchesFound(TermSearch::Matches)),
+                     this, SLOT(addTermMatches(TermSearch::Matches)));
+
+    //Dictionaries are renamed and deleted in the background
+    mDictionaryTask = new DictionaryTask{&mStorage, this};
+    QObject::connect(mDictionaryTask, SIGNAL(aboutToChange(QString)),
+                     this, SLOT(prepareDictionaryChange()));
+    QObject::connect(mDictionaryTask, SIGNAL(renamed(QString,QString,bool)),
+                     this, SLOT(followDictionaryRename(QString,QString,bool)));
+    QObject::connect(mDictionaryTask, SIGNAL(removed(QString,bool)),
+                     this, SLOT(followDictionaryDeletion(QString,bool)));
+
+    //Imports and exports run in the background
+    mTransfer = new QFutureWatcher<DictionaryFile::Result>{this};
+    QObject::connect(mTransfer, SIGNAL(finished()), this, SLOT(finishTransfer()));
+
+    //Large definitions are laid out as the user scrolls
+    mChunkedDefinition = new ChunkedDefinition{ui->textEdit, this};
+    QObject::connect(mChunkedDefinition, SIGNAL(invalidText()), this, SLOT(reportInvalidText()));
+
+    //Edits are followed so that saving writes only what changed
+    mEditTracker = new EditTracker{ui->textEdit->document(), this};
+
+    //Definitions are saved in the background
+    mSaveEngine = new SaveEngine{&mStorage, this};
+    QObject::connect(mSaveEngine, SIGNAL(saveFailed(QString,QString)),
+                     this, SLOT(reportSaveFailure(QString,QString)));
+
+    //Dictionaries are loaded in the background
+    mTermLoader = new TermLoader{&mStorage, this};
+    QObject::connect(mTermLoader, SIGNAL(termsLoaded(QStringList)),
+                     this, SLOT(addLoadedTerms(QStringList)));
+    QObject::connect(mTermLoader, SIGNAL(matcherReady(QSharedPointer<FuzzyMatcher>)),
+                     this, SLOT(setFuzzyMatcher(QSharedPointer<FuzzyMatcher>)));
+    QObject::connect(mTermLoader, SIGNAL(finished(QString)), this, SLOT(finishLoadingTerms()));
+
+    //Changes made by other programs, such as sync tools, are
+    //applied to the lists as they are, without reloading them
+    mTermWatcher = new TermWatcher{&mStorage, resourcesFolder, this};
+    QObject::connect(mTermWatcher, SIGNAL(dictionariesChanged()), this, SLOT(synchronizeDictionaries()));
+    QObject::connect(mTermWatcher, SIGNAL(termsChanged(QString,QStringList,QStringList)),
+                     this, SLOT(applyTermChanges(QString,QStringList,QStringList)));
+
+    //Timings can be shown in the status bar, they are refreshed
+    //every second while they are visible
+    mPerformanceLabel = new QLabel{this};
+    mPerformanceLabel->hide();
+    ui->statusBar->addPermanentWidget(mPerformanceLabel);
+    mPerformanceTimer = new QTimer{this};
+    mPerformanceTimer->setInterval(performanceInterval);
+    QObject::connect(mPerformanceTimer, SIGNAL(timeout()), this, SLOT(updatePerformance()));
+
     loadTermFolders();
+
+    //Finish removing the files of dictionaries deleted
+    //in an earlier session
+    mDictionaryTask->reclaim();
+
+    //Read the history once, every later visit is kept in memory
+    mHistory.load();
+    mHistory.importText(textHistoryFile, textHistoryJournal);
+
+    //Right-clicking the back button lists the whole history
+    ui->pushButtonBack->setContextMenuPolicy(Qt::CustomContextMenu);
+    QObject::connect(ui->pushButtonBack, SIGNAL(customContextMenuRequested(QPoint)),
+                     this, SLOT(showHistoryMenu(QPoint)));
+
+    //Definition search results are only shown in definitions mode
+    ui->listWidgetResults->hide();
+
+    //Read the full-text index and catch up in the background with
+    //dictionaries changed since it was saved; saves, renames, and
+    //deletions made meanwhile update the index directly
+    mFullTextIndex.load();
+    mIndexing = QtConcurrent::run(&mFullTextIndex, &FullTextIndex::synchronize, &mStorage);
 }
 
 MainWindow::~MainWindow()
 {
+    //Stop the loader before the storage it reads from goes away
+    delete mTermLoader;
+    delete mTermWatcher;
+    delete mTermSearch;
+    delete mDictionaryTask;
+    mTransfer->waitForFinished();
+
+    //Close the dictionaries first so that the index is
+    //stamped with the packs as they are left on disk
+    mDefinitionSearch->waitForFinished();
+    mIndexing.waitForFinished();
+    mChunkIndexing.waitForFinished();
+    mDefinitionCache.stopPrefetching();
+    //Deleting the save engine writes the pending saves
+    delete mSaveEngine;
+    mStorage.closeAll();
+    mFullTextIndex.save(&mStorage);
     delete ui;
 }
 
@@ -137,10 +439,166 @@ MainWindow::~MainWindow()
  */
 void MainWindow::on_actionDictionaries_triggered()
 {
-    mDictionaries = new Dictionaries{this};
+    mDictionaries = new Dictionaries{&mStorage, mDictionaryTask, this};
     mDictionaries->setWindowTitle("Dictionaries");
     mDictionaries->show();
-    QObject::connect(mDictionaries, SIGNAL(signalLoadTermFolders()), this, SLOT(loadTermFolders()));
+    QObject::connect(mDictionaries, SIGNAL(dictionaryAdded(QString)), this, SLOT(addDictionary(QString)));
+}
+
+/**
+ * @brief MainWindow::prepareDictionaryChange
+ * Writes pending saves before a dictionary is renamed or
+ * deleted, so that none of them is written under a name
+ * that no longer exists.
+ */
+void MainWindow::prepareDictionaryChange()
+{
+    on_pushButtonSave_clicked();
+    mSaveEngine->flush();
+}
+
+/**
+ * @brief MainWindow::synchronizeDictionaries
+ * Adds the dictionaries created by other programs to the
+ * combo box and removes those they deleted.
+ */
+void MainWindow::synchronizeDictionaries()
+{
+    QStringList const dictionaries{mStorage.dictionaries()};
+    for (int i = ui->comboBoxDictionaries->count() - 1; i >= 0; i--)
+        if (!dictionaries.contains(ui->comboBoxDictionaries->itemText(i)))
+            followDictionaryDeletion(ui->comboBoxDictionaries->itemText(i), true);
+    for (QString const &dictionary: dictionaries)
+        if (ui->comboBoxDictionaries->findText(dictionary) == -1)
+            addDictionary(dictionary);
+}
+
+/**
+ * @brief MainWindow::applyTermChanges
+ * Applies the terms added and removed by other programs to
+ * the term list, the completers, and the full-text index, in
+ * a single update however many files changed.
+ * @param dictionary the dictionary that changed
+ * @param removed the terms that are gone
+ * @param inserted the terms that are new
+ */
+void MainWindow::applyTermChanges(QString const &dictionary, QStringList const &removed,
+                                  QStringList const &inserted)
+{
+    //Stores replaced by the refresh are no longer in use here
+    mStorage.releaseRetired();
+    if (dictionary != ui->comboBoxDictionaries->currentText())
+        return;
+
+    //Definitions may have changed even if the terms did not
+    mDefinitionCache.clear();
+    mTermModel->applyChanges(removed, inserted);
+    for (QString const &term: removed)
+        updateFuzzyMatcher(term, false);
+    for (QString const &term: inserted)
+        updateFuzzyMatcher(term, true);
+
+    mIndexing.waitForFinished();
+    mIndexing = QtConcurrent::run(&mFullTextIndex, &FullTextIndex::synchronize, &mStorage);
+}
+
+/**
+ * @brief MainWindow::dictionaryPosition
+ * @param dictionary a dictionary name
+ * @return the position of the dictionary in the combo box,
+ * sorted ignoring case like the storage sorts them
+ */
+int MainWindow::dictionaryPosition(QString const &dictionary) const
+{
+    int position{0};
+    while (position < ui->comboBoxDictionaries->count() &&
+           QString::compare(ui->comboBoxDictionaries->itemText(position), dictionary,
+                            Qt::CaseInsensitive) < 0)
+        position++;
+    return position;
+}
+
+/**
+ * @brief MainWindow::addDictionary
+ * Adds a new dictionary to the combo box.
+ * @param dictionary the dictionary name
+ */
+void MainWindow::addDictionary(QString const &dictionary)
+{
+    ui->comboBoxDictionaries->insertItem(dictionaryPosition(dictionary), dictionary);
+}
+
+/**
+ * @brief MainWindow::followDictionaryRename
+ * Renames a dictionary in the combo box. If it is the current
+ * one it stays selected and its terms are not loaded again.
+ * @param dictionary the previous dictionary name
+ * @param newName the new dictionary name
+ * @param succeeded whether the dictionary was renamed
+ */
+void MainWindow::followDictionaryRename(QString const &dictionary, QString const &newName,
+                                        bool succeeded)
+{
+    //The store under the old name was dropped either way
+    mStorage.releaseRetired();
+    if (!succeeded)
+    {
+        ui->statusBar->showMessage("Could not rename " + dictionary + " to " + newName, 5000);
+        return;
+    }
+
+    //Cached definitions are looked up by dictionary name
+    mDefinitionCache.clear();
+    mFullTextIndex.renameDictionary(dictionary, newName);
+    if (lastDictionary == dictionary)
+        lastDictionary = newName;
+
+    int const index{ui->comboBoxDictionaries->findText(dictionary)};
+    if (index == -1)
+        return;
+
+    //The term list stays valid, the dictionary only changed name
+    bool const current{index == ui->comboBoxDictionaries->currentIndex()};
+    QSignalBlocker const blocker{ui->comboBoxDictionaries};
+    ui->comboBoxDictionaries->removeItem(index);
+    int const position{dictionaryPosition(newName)};
+    ui->comboBoxDictionaries->insertItem(position, newName);
+    if (current)
+        ui->comboBoxDictionaries->setCurrentIndex(position);
+}
+
+/**
+ * @brief MainWindow::followDictionaryDeletion
+ * Removes a deleted dictionary from the combo box. If it is
+ * the current one, the next dictionary is shown instead.
+ * @param dictionary the dictionary name
+ * @param succeeded whether the dictionary was deleted
+ */
+void MainWindow::followDictionaryDeletion(QString const &dictionary, bool succeeded)
+{
+    mStorage.releaseRetired();
+    if (!succeeded)
+    {
+        ui->statusBar->showMessage("Could not delete " + dictionary, 5000);
+        return;
+    }
+
+    mDefinitionCache.clear();
+    mFullTextIndex.forgetDictionary(dictionary);
+
+    //Nothing is left to save in the deleted dictionary
+    if (lastDictionary == dictionary)
+    {
+        lastTerm = "";
+        mChunkedDefinition->clear();
+        ui->textEdit->clear();
+        mEditTracker->reset(0);
+        ui->textEdit->document()->setModified(false);
+    }
+
+    int const index{ui->comboBoxDictionaries->findText(dictionary)};
+    if (index != -1)
+        ui->comboBoxDictionaries->removeItem(index);
 }
 
 /**
@@ -153,6 +611,17 @@ void MainWindow::on_actionConfiguration_triggered()
     mConfiguration = new Configuration{this};
     mConfiguration->setWindowTitle("Configuration");
     mConfiguration->show();
+    QObject::connect(mConfiguration, SIGNAL(settingsChanged()), this, SLOT(applySettings()));
+}
+
+/**
+ * @brief MainWindow::applySettings
+ * Applies the settings saved from the configuration window.
+ */
+void MainWindow::applySettings()
+{
+    mDefinitionCache.setBudget(Configuration::cacheBudget());
+    mStorage.setCompression(Configuration::compression());
 }
 
 /**
@@ -179,29 +648,263 @@ void MainWindow::on_actionExit_triggered()
     close();
 }
 
+/**
+ * @brief MainWindow::on_actionPerformance_toggled
+ * Shows or hides the timings in the status bar.
+ * @param checked whether the timings are shown
+ */
+void MainWindow::on_actionPerformance_toggled(bool checked)
+{
+    mPerformanceLabel->setVisible(checked);
+    if (checked)
+    {
+        updatePerformance();
+        mPerformanceTimer->start();
+    }
+    else
+        mPerformanceTimer->stop();
+}
+
+/**
+ * @brief MainWindow::updatePerformance
+ * Shows the median and 99th percentile of the timed operations,
+ * and the bytes read and written, in the status bar.
+ */
+void MainWindow::updatePerformance()
+{
+    mPerformanceLabel->setText(Metrics::instance().summary());
+}
+
+/**
+ * @brief MainWindow::on_actionSaveTrace_triggered
+ * Saves the recent timed operations as a trace that can be
+ * opened in chrome://tracing or Perfetto.
+ */
+void MainWindow::on_actionSaveTrace_triggered()
+{
+    QString const path{QFileDialog::getSaveFileName(this, "Save Performance Trace",
+                                                    "notespisok-trace.json",
+                                                    "Chrome trace (*.json)")};
+    if (path == "")
+        return;
+
+    if (Metrics::instance().writeTrace(path))
+        ui->statusBar->showMessage("Performance trace saved to " + path, 5000);
+    else
+        ui->statusBar->showMessage("Could not save the performance trace to " + path, 5000);
+}
+
+/**
+ * @brief MainWindow::on_actionImport_triggered
+ * Adds the terms of a file to the current dictionary, in the
+ * background. The dictionary can still be used meanwhile.
+ */
+void MainWindow::on_actionImport_triggered()
+{
+    QString const dictionary{ui->comboBoxDictionaries->currentText()};
+    if (dictionary == "" || mTransfer->isRunning())
+        return;
+
+    QString const path{QFileDialog::getOpenFileName(this, "Import Into " + dictionary, "",
+                                                    DictionaryFile::filter())};
+    if (path == "")
+        return;
+
+    //Write pending saves so that the import replaces them
+    on_pushButtonSave_clicked();
+    mSaveEngine->flush();
+
+    mImporting = true;
+    mTransferDictionary = dictionary;
+    ui->actionImport->setEnabled(false);
+    ui->actionExport->setEnabled(false);
+    ui->statusBar->showMessage("Importing " + path + " into " + dictionary + "...");
+    mTransfer->setFuture(QtConcurrent::run(&DictionaryFile::importFile, &mStorage, dictionary, path));
+}
+
+/**
+ * @brief MainWindow::on_actionExport_triggered
+ * Writes every term of the current dictionary to a file,
+ * in the background. The format follows the extension of
+ * the file, or the chosen filter if it has none.
+ */
+void MainWindow::on_actionExport_triggered()
+{
+    QString const dictionary{ui->comboBoxDictionaries->currentText()};
+    if (dictionary == "" || mTransfer->isRunning())
+        return;
+
+    QString filter;
+    QString path{QFileDialog::getSaveFileName(this, "Export " + dictionary, dictionary + ".tsv",
+                                              DictionaryFile::filter(), &filter)};
+    if (path == "")
+        return;
+    if (DictionaryFile::format(path) == DictionaryFile::Unknown)
+        path += "." + QRegularExpression{"\\*\\.(\\w+)"}.match(filter).captured(1);
+
+    //Write pending saves so that the export includes them
+    on_pushButtonSave_clicked();
+    mSaveEngine->flush();
+
+    mImporting = false;
+    mTransferDictionary = dictionary;
+    ui->actionImport->setEnabled(false);
+    ui->actionExport->setEnabled(false);
+    ui->statusBar->showMessage("Exporting " + dictionary + " to " + path + "...");
+    mTransfer->setFuture(QtConcurrent::run(&DictionaryFile::exportFile, &mStorage, dictionary, path));
+}
+
+/**
+ * @brief MainWindow::on_actionRevisions_triggered
+ * Launches a dialog window listing the revisions of the
+ * current term.
+ */
+void MainWindow::on_actionRevisions_triggered()
+{
+    if (!isTermSelected())
+        return;
+
+    //Write the pending save so that it is listed too
+    on_pushButtonSave_clicked();
+    mSaveEngine->flush();
+
+    QSharedPointer<RevisionStore> const revisions{mStorage.revisions(ui->comboBoxDictionaries->currentText())};
+    if (revisions.isNull())
+        return;
+
+    Revisions *dialog{new Revisions{revisions, selectedTerm(), this}};
+    QObject::connect(dialog, SIGNAL(restoreRevision(QByteArray)),
+                     this, SLOT(restoreRevision(QByteArray)));
+    dialog->setWindowTitle("Revisions of " + selectedTerm());
+    dialog->show();
+}
+
+/**
+ * @brief MainWindow::restoreRevision
+ * Saves an earlier revision as the definition of the
+ * current term. It is saved like any edit, so it becomes
+ * the newest revision and can itself be undone.
+ * @param contents the UTF-8 encoded definition
+ */
+void MainWindow::restoreRevision(QByteArray const &contents)
+{
+    if (!isTermSelected())
+        return;
+
+    QString const dictionary{ui->comboBoxDictionaries->currentText()};
+    QString const term{selectedTerm()};
+    mSaveEngine->save(dictionary, term, contents);
+    mDefinitionCache.remove(dictionary, term);
+    mFullTextIndex.update(dictionary, term, TermStore::Parts{contents});
+    viewContents(term, true, false);
+}
+
+/**
+ * @brief MainWindow::finishTransfer
+ * Reports the outcome of an import or an export. After an
+ * import, the terms of the dictionary are listed again and
+ * the full-text index catches up with the new definitions.
+ */
+void MainWindow::finishTransfer()
+{
+    ui->actionImport->setEnabled(true);
+    ui->actionExport->setEnabled(true);
+
+    DictionaryFile::Result const result{mTransfer->result()};
+    QString message{(mImporting ? "Imported " : "Exported ") + QString::number(result.terms) + " terms"};
+    if (result.skipped > 0)
+        message += ", skipped " + QString::number(result.skipped);
+    if (result.error != "")
+        message += ": " + result.error;
+    ui->statusBar->showMessage(message);
+
+    if (!mImporting || result.terms == 0)
+        return;
+
+    //Imported definitions replace cached ones
+    mDefinitionCache.clear();
+    if (mTransferDictionary == ui->comboBoxDictionaries->currentText())
+        loadTerms();
+    mIndexing.waitForFinished();
+    mIndexing = QtConcurrent::run(&mFullTextIndex, &FullTextIndex::synchronize, &mStorage);
+}
+
 /**
  * @brief MainWindow::on_pushButtonSave_clicked
  * Saves the edit-box contents into the file
- * of the last-viewed term.
+ * of the last-viewed term. Nothing is written unless
+ * the definition has been edited since it was loaded
+ * or last saved, and the write itself happens in the
+ * background.
  */
 void MainWindow::on_pushButtonSave_clicked()
 {
+    ScopedTimer const timer{Metrics::MainWindowSave};
+
     //Get the name of the last-viewed term
-    //Use the term name to open its corresponding file
-    QFile file{currentTermFolder(lastDictionary) + lastTerm};
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    //Skip saving if the definition has not been edited
+    if (lastTerm == "" || !ui->textEdit->document()->isModified())
+        return;
+
+    //A large definition is saved as its chunks, encoding and
+    //writing only the edited ones, and indexed one chunk at a time
+    if (mChunkedDefinition->isActive())
+    {
+        TermStore::Delta delta;
+        TermStore::Parts const parts{mChunkedDefinition->parts(delta)};
+        mSaveEngine->save(lastDictionary, lastTerm, parts, delta);
+        ui->textEdit->document()->setModified(false);
+        mDefinitionCache.remove(lastDictionary, lastTerm);
+        QString const dictionary{lastDictionary};
+        QString const term{lastTerm};
+        mChunkIndexing.waitForFinished();
+        mChunkIndexing = QtConcurrent::run([this, dictionary, term, parts] {
+            mFullTextIndex.update(dictionary, term, parts);
+        });
         return;
+    }
 
     //Get the edit-box contents
-    //Store the contents into the term's file
+    //Store the contents as the term's definition
     QString textEditContents{ui->textEdit->toPlainText()};
-    QTextStream outStream(&file);
-    outStream.setCodec("UTF-8");
+    QByteArray contents;
     if (textEditContents != "" && textEditContents[0] != " ")
-        outStream << textEditContents;
+        TextCodec::encode(textEditContents, contents);
+
+    //Queue the definition, writing only the edited region when
+    //the definition was not emptied, then cache it and index its words.
+    //The text is the definition already, so it is not decoded back
+    QString const definition{contents.isEmpty() ? QString{} : textEditContents};
+    TermStore::Delta const delta{contents.isEmpty() ? TermStore::Delta{} :
+                                                      mEditTracker->delta(textEditContents)};
+    mSaveEngine->save(lastDictionary, lastTerm, TermStore::Parts{contents}, delta);
+    mEditTracker->reset(contents.size());
+    ui->textEdit->document()->setModified(false);
+    mDefinitionCache.insert(lastDictionary, lastTerm, definition);
+    mFullTextIndex.update(lastDictionary, lastTerm, definition);
+}
+
+/**
+ * @brief MainWindow::reportSaveFailure
+ * Tells the user that a definition could not be written.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ */
+void MainWindow::reportSaveFailure(QString const &dictionary, QString const &term)
+{
+    ui->statusBar->showMessage("Could not save \"" + term + "\" in " + dictionary);
+}
 
-    file.flush();
-    file.close();
+/**
+ * @brief MainWindow::reportInvalidText
+ * Tells the user that the definition being viewed is not
+ * valid UTF-8, so that saving it would lose the bytes shown
+ * as replacement characters.
+ */
+void MainWindow::reportInvalidText()
+{
+    ui->statusBar->showMessage("The definition is not valid UTF-8; saving it keeps "
+                               "replacement characters in place of the invalid bytes", 5000);
 }
 
 /**
@@ -212,7 +915,7 @@ void MainWindow::on_pushButtonAdd_clicked()
 {
     //Save current term definition before adding another term
     //Do not save unless an item is selected
-    if (ui->listWidgetEntries->isItemSelected(ui->listWidgetEntries->currentItem()))
+    if (isTermSelected())
         on_pushButtonSave_clicked();
 
     //Get the new term from the search-box
@@ -220,20 +923,21 @@ void MainWindow::on_pushButtonAdd_clicked()
     QString const newTerm{ui->lineEditSearch->text()};
     if (newTerm != "" && newTerm[0] != " ")
     {
-        //Check that the file does does not exists or it will be overwritten
-        QFile file{currentTermFolder() + newTerm};
-        if(!file.exists())
+        //Check that the term does not exist or it will be overwritten
+        TermStore *store{termStore()};
+        if (store == nullptr)
+            return;
+        if (!store->contains(newTerm))
         {
-            //Create an empty file by opening it
-            if (!file.open(QIODevice::WriteOnly))
+            //Create the term with an empty definition
+            if (!store->write(newTerm, QByteArray{}))
                 return;
-            file.close();
         }
-    }
 
-    //Clear the widget list and reload it
-    ui->listWidgetEntries->clear();
-    loadTerms();
+        //Add the new term to the term list
+        mTermModel->insertTerm(newTerm);
+        updateFuzzyMatcher(newTerm, true);
+    }
 
     //Set the new term as the current item
     //And add new term to history file
@@ -241,11 +945,11 @@ void MainWindow::on_pushButtonAdd_clicked()
 }
 
 /**
- * @brief MainWindow::on_listWidgetEntries_itemClicked
+ * @brief MainWindow::on_listViewEntries_clicked
  * Enables the Save and Delete buttons for ther selected
  * term. Also displays the term's contents, if any.
  */
-void MainWindow::on_listWidgetEntries_itemClicked()
+void MainWindow::on_listViewEntries_clicked()
 {
     //Get the current term name and view its definition
     /* Uses the text from the selected item
@@ -253,8 +957,7 @@ void MainWindow::on_listWidgetEntries_itemClicked()
      * the definition. The contents are then
      * displayed.
      */
-    QString const currentTerm{
-        ui->listWidgetEntries->currentItem()->text()};
+    QString const currentTerm{selectedTerm()};
 
     //If the same term has been clicked, save its contents,
     //otherwise the file will be loaded again and changes lost
@@ -273,11 +976,16 @@ void MainWindow::on_comboBoxDictionaries_currentTextChanged()
 {
     //Save current term definition before changing dictionaries,
     //and save definition in the last dictionary and term visited
-    if (ui->listWidgetEntries->isItemSelected(ui->listWidgetEntries->currentItem()))
+    if (isTermSelected())
         on_pushButtonSave_clicked();
 
-    //Clear the list widget and reload it
-    ui->listWidgetEntries->clear();
+    //Compact the dictionary that is being left if it has grown
+    //with too many superseded definitions
+    TermStore *store{termStore(lastDictionary)};
+    if (store != nullptr)
+        store->maybeCompact();
+
+    //Reload the term list
     loadTerms();
 }
 
@@ -287,7 +995,7 @@ void MainWindow::on_pushButtonDelete_clicked()
     mDelete->setWindowTitle("Delete");
     QObject::connect(mDelete, SIGNAL(accepted()), this, SLOT(deleteTerm()));
     QObject::connect(this, SIGNAL(relayTerm(QString)), mDelete, SLOT(showDeleteWarning(QString)));
-    emit relayTerm(ui->listWidgetEntries->currentItem()->text());
+    emit relayTerm(selectedTerm());
     mDelete->show();
 }
 
@@ -298,23 +1006,42 @@ void MainWindow::on_pushButtonDelete_clicked()
 void MainWindow::deleteTerm()
 {
     //Get the selected term name and remove if it exists
-    QString listWidgetItem{ui->listWidgetEntries->currentItem()->text()};
-    QFile file{currentTermFolder() + listWidgetItem};
-    if(file.exists())
-        file.remove();
-
-    //Clear the list widget and reload it
-    ui->listWidgetEntries->clear();
-    loadTerms();
+    //Pending saves are written first, or they would bring it back
+    QString const term{selectedTerm()};
+    mSaveEngine->flush();
+    TermStore *store{termStore()};
+    if (store == nullptr || !store->remove(term))
+        return;
+    mFullTextIndex.remove(ui->comboBoxDictionaries->currentText(), term);
+    mDefinitionCache.remove(ui->comboBoxDictionaries->currentText(), term);
+
+    //Remove the term from the term list
+    //Disable editing because no terms are selected
+    mTermModel->removeTerm(term);
+    updateFuzzyMatcher(term, false);
+    setTermControlsEnabled(false);
 }
 
 /**
  * @brief MainWindow::on_lineEditSearch_textChanged
+ * Restarts the search timer, so that nothing is looked
+ * up or saved until typing pauses.
+ */
+void MainWindow::on_lineEditSearch_textChanged()
+{
+    ScopedTimer const timer{Metrics::MainWindowSearchTextChanged};
+    mSearchTimer->start();
+}
+
+/**
+ * @brief MainWindow::lookUpSearch
  * Displays any matching definitions for the term written
  * in the search box.
  */
-void MainWindow::on_lineEditSearch_textChanged()
+void MainWindow::lookUpSearch()
 {
+    ScopedTimer const timer{Metrics::MainWindowLookUpSearch};
+
     //Get the searched term and view its definition
     /* Uses the text from the selected item
      * to find the file name that contains
@@ -323,14 +1050,47 @@ void MainWindow::on_lineEditSearch_textChanged()
      */
     QString const currentTerm {ui->lineEditSearch->text()};
 
+    //In definitions mode, list the terms whose definitions match
+    if (ui->comboBoxSearchMode->currentIndex() == definitionSearch)
+    {
+        searchDefinitions(currentTerm);
+        return;
+    }
+
+    //In all dictionaries mode, list the matching terms of every dictionary
+    if (ui->comboBoxSearchMode->currentIndex() == allDictionariesSearch)
+    {
+        searchAllDictionaries(currentTerm);
+        return;
+    }
+
     //If the same term has looked up, save its contents,
     //otherwise the file will be loaded again and changes lost
     if (currentTerm == lastTerm)
         on_pushButtonSave_clicked();
 
-    //Set the searched term as the current item
-    //And add the searched term to history file
-    viewContents(currentTerm, false, true, true);
+    //Set the searched term as the current item, it is added
+    //to the history file if it is not replaced in a while
+    //If there is no such term, suggest similar ones
+    if (viewContents(currentTerm, false, false, true))
+    {
+        mFuzzyCompleter->popup()->hide();
+        mPendingHistoryEntry = History::Entry{ui->comboBoxDictionaries->currentText(), currentTerm};
+        mHistoryTimer->start();
+    }
+    else
+        suggestTerms(currentTerm);
+}
+
+/**
+ * @brief MainWindow::commitSearchHistory
+ * Adds the searched term to the history once it has
+ * stayed in view long enough to be what was looked for.
+ */
+void MainWindow::commitSearchHistory()
+{
+    mHistory.visit(mPendingHistoryEntry.first, mPendingHistoryEntry.second);
+    historyEntry = 0;
 }
 
 /**
@@ -349,28 +1109,61 @@ void MainWindow::on_lineEditSearch_textChanged()
  * of saving the term, while other do not, so those functions
  * that do not save the term should mark this as true as a
  * security measure).
+ * @return whether the term exists and is being viewed
  */
-void MainWindow::viewContents(QString const &currentTerm,
+bool MainWindow::viewContents(QString const &currentTerm,
                               bool isCurrentItem,
                               bool historyUpdateNeeded,
                               bool savePreviousTermNeeded)
 {
-    //Open the given term's file and store its contents
-    QFile file{currentTermFolder() + currentTerm};
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-        return;
-    QByteArray contents{file.readAll()};
-    file.close();
+    ScopedTimer const timer{Metrics::MainWindowViewContents};
+
+    //Viewing another term drops a searched term still waiting
+    //to be added to the history
+    mHistoryTimer->stop();
+
+    //A definition that is still being saved is newer than the
+    //stored one, otherwise use the cached definition if any, or
+    //read it from the dictionary. It is copied rather than viewed,
+    //since an import may compact the pack from a worker thread
+    //and unmap a slice while it is being decoded
+    QString const dictionary{ui->comboBoxDictionaries->currentText()};
+    QByteArray contents;
+    QString definition;
+    bool const pending{mSaveEngine->pending(dictionary, currentTerm, contents)};
+    bool const cached{!pending && mDefinitionCache.find(dictionary, currentTerm, definition)};
+    if (!pending && !cached)
+    {
+        TermStore *store{termStore()};
+        if (store == nullptr || !store->read(currentTerm, contents))
+            return false;
+    }
+
+    //Large definitions are never decoded as a whole, nor cached
+    QVector<QByteArray> chunks;
+    if (!cached && ChunkedDefinition::isLarge(contents))
+        chunks = ChunkedDefinition::split(contents);
+    else if (!cached)
+    {
+        //Invalid definitions are left out of the cache, so that
+        //the user is told about them each time they are viewed
+        if (!TextCodec::decode(contents, definition))
+            reportInvalidText();
+        else if (!pending)
+            mDefinitionCache.insert(dictionary, currentTerm, definition);
+    }
 
     //Set the searched item as the current item
     /* Not setting a searched item as the current item may cause
      * problems because the save function must know which is the
      * current item in order to save contents to it.
     */
+    //The term may not be listed yet while its dictionary loads,
+    //in which case it is selected once it arrives
     if (!isCurrentItem)
     {
-        QListWidgetItem *term{ui->listWidgetEntries->findItems(currentTerm, Qt::MatchFixedString).first()};
-        ui->listWidgetEntries->setCurrentItem(term);
+        int const row{mTermModel->find(currentTerm)};
+        ui->listViewEntries->setCurrentIndex(row != -1 ? mTermModel->index(row) : QModelIndex{});
     }
 
     if (savePreviousTermNeeded)
@@ -378,25 +1171,31 @@ void MainWindow::viewContents(QString const &currentTerm,
         //Save current term definition before loading another term
         //Save if the item clicked is different in name or dictionary
         //from the current one
-        //qDebug() << "current item: " << ui->listWidgetEntries->currentItem()->text();
-        if (ui->listWidgetEntries->currentItem()->text() != lastTerm ||
+        //qDebug() << "current item: " << selectedTerm();
+        if (selectedTerm() != lastTerm ||
                 ui->comboBoxDictionaries->currentText() != lastDictionary)
         {
             //Check if term still exists, and if it does, save it
-            QFile file{currentTermFolder(lastDictionary) + lastTerm};
-            //qDebug() << file.fileName();
-            if (file.exists())
+            TermStore *previousStore{termStore(lastDictionary)};
+            if (previousStore != nullptr && previousStore->contains(lastTerm))
                 on_pushButtonSave_clicked();
         }
     }
 
     //Load the contents and enable the save, delete, and rename buttons
     //Enable text editing because a term has been selected
-    ui->textEdit->setPlainText(contents);
-    ui->pushButtonSave->setEnabled(true);
-    ui->pushButtonDelete->setEnabled(true);
-    ui->pushButtonRename->setEnabled(true);
-    ui->textEdit->setEnabled(true);
+    //The loaded definition has nothing left to save
+    if (!chunks.isEmpty())
+        mChunkedDefinition->load(chunks);
+    else
+    {
+        mChunkedDefinition->clear();
+        ui->textEdit->setPlainText(definition);
+        mEditTracker->reset(cached ? TextCodec::utf8Size(definition.constData(), definition.size()) :
+                                     contents.size());
+    }
+    ui->textEdit->document()->setModified(false);
+    setTermControlsEnabled(true);
 
     //If the history file is updated, reset the history entry number
     //back to zero, so that the the user can only see previous terms
@@ -413,229 +1212,86 @@ void MainWindow::viewContents(QString const &currentTerm,
     //Keep track of the last item that has been clicked
     lastTerm = currentTerm;
     //qDebug() << "last term: " << lastTerm;
-}
 
-/**
- * @brief MainWindow::viewContents
- * Loads the definition of the given term if it
- * exists in the specified path
- * @param termPath the relative path of the term's location,
- * where the parent folder is the resources folder
- */
-void MainWindow::viewContents(QString const &termPath)
-{
-    //Take the path and split it into three parts, like so:
-    //"resources" "dictionary name" "term name"
-    QStringList parts = termPath.split(QRegExp("/"));
-    //qDebug() << historyEntry << parts;
-    QString dictionary = parts[1];
-    QString term = parts[2];
-
-    //Set the dictionary that contains the term
-    /* Once the dictionary has been set, its terms should
-     * be loaded automatically because of the funciton
-     * on_comboBoxDictionaries_currentTextChanged.
-     */
-    ui->comboBoxDictionaries->setCurrentText(dictionary);
-
-    //Set the term as the current item
-    //But do not add the term to history file
-    viewContents(term, false, false);
+    //Read the terms likely to be viewed next in the background
+    prefetchDefinitions(currentTerm);
+    return true;
 }
 
 /**
- * @brief MainWindow::updateHistory
- * Updates the history file and keeps track
- * of the terms that have been viewed.
- * @param currentTerm the selected or searched term name
+ * @brief MainWindow::prefetchDefinitions
+ * Warms the definition cache with the terms around the
+ * viewed one in the term list, and with the terms reached
+ * by going back and forth through the history.
+ * @param currentTerm the viewed term name
  */
-void MainWindow::updateHistory(QString const &currentTerm) const
-{
-    /*Function summary:
-    If the given term exists and is the first one
-    in the history file, then do nothing.
-
-    If the given term exists but is not the
-    first one in the history file,
-    create a new temporary file,
-    put the given term at the top of the list,
-    place the rest of the terms beneath it,
-    but remove any duplicates of the given term.
-    Delete the original history file,
-    and rename the temporary history file.
-
-    If the given term does not exist,
-    create new temporary file,
-    put the given term at the top of the list,
-    place the rest of the terms beneath it,
-    Delete the original history file,
-    and rename the temporary history file.
-   */
-
-    //Open the history file. If does not exist, create it
-    QFile history{historyFile};
-    if (!history.open(QIODevice::ReadWrite))
-        return;
-
-    //Create an input stream for the history file
-    //Read all the terms in history file
-    //Encode toLocat8Bit to prevent cyrillic encoding erros
-    //Close the hitory file
-    QTextStream inStream{&history};
-    QString contents{inStream.readAll().toLocal8Bit()};
-    history.close();
-
-    bool termExists{false};
-    const int firstLine{0};
-    int termLocation{0};
-    int documentLength{0};
-    QString term = currentTermFolder() + currentTerm;
-    for (QString row: contents.split("\r\n"))
-    {
-        //Check if the given term exists
-        if(row == term)
-        {
-            termExists = true;
-            //Indicate that the term is at top
-            //of list when equal to 0
-            termLocation = documentLength;
-        }
-    //Count the number of terms in the file
-    documentLength++;
-    }
-
-    //Ignore if the term exists and
-    //is the first one in the list
-    if(termExists && termLocation == firstLine) {}
-
-    else if(termExists && termLocation != firstLine)
-    {
-        //Create a temporary file
-        QFile tempFile{temporaryFile};
-        if(!tempFile.open(QIODevice::WriteOnly | QIODevice::Text))
-            return;
-
-        //Create an out stream
-        //Set the encoding to utf-8
-        QTextStream outStream(&tempFile);
-        outStream.setCodec("UTF-8");
+void MainWindow::prefetchDefinitions(QString const &currentTerm)
+{
+    QString const dictionary{ui->comboBoxDictionaries->currentText()};
+    QList<DefinitionCache::Key> keys;
 
-        //Put the given term at the top of the list
-        outStream << term << "\n";
-        for (QString row: contents.split("\r\n"))
+    //Nearest neighbours first, alternating above and below
+    int const row{mTermModel->find(currentTerm)};
+    if (row != -1)
+        for (int distance = 1; distance <= prefetchRadius; distance++)
         {
-            //Add the remaining terms into the list but remove
-            //any duplicates of the given term or empty lines
-            if (row != term && row != "")
-                outStream << row << "\n";
+            if (row - distance >= 0)
+                keys << DefinitionCache::Key{dictionary, mTermModel->term(row - distance)};
+            if (row + distance < mTermModel->rowCount())
+                keys << DefinitionCache::Key{dictionary, mTermModel->term(row + distance)};
         }
-        //Save the new temporary file
-        tempFile.flush();
-        tempFile.close();
-
-        //Remove and replace the old history file
-        history.remove();
-        tempFile.rename(historyFile);
-    }
 
-    //Add the term if it does not exist
-    else if(!termExists)
-    {
-        //Create a temporary file
-        QFile tempFile{temporaryFile};
-        if(!tempFile.open(QIODevice::WriteOnly | QIODevice::Text))
-            return;
-
-        //Create an out stream
-        //Set the encoding to utf-8
-        QTextStream outStream(&tempFile);
-        outStream.setCodec("UTF-8");
-
-        //Put the given term at the top of the list
-        outStream << term << "\n";
-        for (QString row: contents.split("\r\n"))
-        {
-            //Add the remaining terms into the list
-            if (row != "")
-                outStream << row << "\n";
-        }
-        //Save the new temporary file
-        tempFile.flush();
-        tempFile.close();
+    //History entries are already dictionary and term pairs
+    int const first{qMax(0, historyEntry - 1)};
+    int const last{qMin(mHistory.size(), historyEntry + 1 + prefetchHistory)};
+    for (int i = first; i < last; i++)
+        keys << mHistory.at(i);
 
-        //Remove and replace the old history file
-        history.remove();
-        tempFile.rename(historyFile);
-    }
-    checkHistoryLength(documentLength);
+    mDefinitionCache.prefetch(&mStorage, mSaveEngine, keys);
 }
 
 /**
- * @brief MainWindow::checkHistoryLength
- * Checks the length of the history file and
- * ensures that it does not grow too large.
- * @param documentLength the current document
- * length represented by the number of lines
- * in the document
+ * @brief MainWindow::viewHistoryEntry
+ * Loads the definition of a term in the history, without
+ * updating the history file.
+ * @param index the position of the term in the history,
+ * where 0 is the most recent one
  */
-void MainWindow::checkHistoryLength(const int documentLength) const
+void MainWindow::viewHistoryEntry(int index)
 {
-    //Save the las 20 terms whenever the
-    //history goes beyond a max of 50 entries
-    int const maxLength = 50;
-    int const goodLength = 20;
-    if (documentLength > maxLength)
-    {
-        //Create a temporary file
-        //Create an input stream
-        //Set the encoding to utf-8
-        QFile temp{temporaryFile};
-        if (!temp.open(QIODevice::WriteOnly | QIODevice::Text))
-            return;
-        QTextStream inStream(&temp);
-        inStream.setCodec("UTF-8");
-
-        //Open the history file
-        //Create an output file
-        QFile history{historyFile};
-        if (!history.open(QIODevice::ReadOnly | QIODevice::Text))
-            return;
-        QTextStream outSream(&history);
+    if (index < 0 || index >= mHistory.size())
+        return;
 
-        //Save the first 20 words and ignore the rest
-        for (int i = 0; i < goodLength; i++)
-            inStream << outSream.readLine().toLocal8Bit() << "\n";
+    //Point to the entry before viewing it, so that the
+    //terms around it are the ones prefetched
+    historyEntry = index;
+    QString const dictionary{mHistory.at(index).first};
+    QString const term{mHistory.at(index).second};
 
-        //Save and close the temporary file
-        temp.flush();
-        temp.close();
+    //Set the dictionary that contains the term
+    /* Once the dictionary has been set, its terms should
+     * be loaded automatically because of the funciton
+     * on_comboBoxDictionaries_currentTextChanged.
+     */
+    ui->comboBoxDictionaries->setCurrentText(dictionary);
 
-        //Remove and replace the old history file
-        history.close();
-        history.remove();
-        temp.rename(historyFile);
-    }
+    //Set the term as the current item
+    //But do not add the term to history file
+    if (!viewContents(term, false, false))
+        ui->statusBar->showMessage("\"" + term + "\" no longer exists in " + dictionary, 5000);
 }
 
 /**
- * @brief MainWindow::getHistoryList
- * Gets the contents of the history file and stores
- * them into the provided variable
- * @param terms the list where all the terms in the
- * history file will be stored
+ * @brief MainWindow::updateHistory
+ * Moves the given term to the top of the history. The
+ * history is kept in memory and only the visit itself is
+ * appended to the history journal.
+ * @param currentTerm the selected or searched term name
  */
-void MainWindow::getHistoryList(QList<QString> &terms)
+void MainWindow::updateHistory(QString const &currentTerm)
 {
-    //Open the history file in text mode
-    QFile history{historyFile};
-    if (!history.open(QIODevice::ReadOnly | QIODevice::Text))
-        return;
-
-    //Save every line of the history file into the terms list
-    while(!history.atEnd())
-    {
-        terms.push_back(history.readLine().trimmed());
-    }
+    ScopedTimer const timer{Metrics::MainWindowUpdateHistory};
+    mHistory.visit(ui->comboBoxDictionaries->currentText(), currentTerm);
 }
 
 /**
@@ -646,16 +1302,12 @@ void MainWindow::getHistoryList(QList<QString> &terms)
 void MainWindow::on_pushButtonBack_clicked()
 {
     //Save current term definition before going back
-    if (ui->listWidgetEntries->isItemSelected(ui->listWidgetEntries->currentItem()))
+    if (isTermSelected())
         on_pushButtonSave_clicked();
 
-    //Obtain all the terms in the history file
-    QList<QString> terms;
-    getHistoryList(terms);
-
     //Icrease historyEntry to point to previoius term
-    if (historyEntry < terms.length() - 1)
-        viewContents(terms[++historyEntry]);
+    if (historyEntry < mHistory.size() - 1)
+        viewHistoryEntry(historyEntry + 1);
 }
 
 /**
@@ -666,16 +1318,44 @@ void MainWindow::on_pushButtonBack_clicked()
 void MainWindow::on_pushButtonNext_clicked()
 {
     //Save current term definition before returning
-    if (ui->listWidgetEntries->isItemSelected(ui->listWidgetEntries->currentItem()))
+    if (isTermSelected())
         on_pushButtonSave_clicked();
 
-    //Obtain all the terms in the history file
-    QList<QString> terms;
-    getHistoryList(terms);
-
     //Decrease historyEntry to point to next term
     if (historyEntry > 0)
-        viewContents(terms[--historyEntry]);
+        viewHistoryEntry(historyEntry - 1);
+}
+
+/**
+ * @brief MainWindow::showHistoryMenu
+ * Lists the history under the back button, so that any
+ * term in it can be reached at once, without updating
+ * the history file.
+ * @param position where the back button was right-clicked
+ */
+void MainWindow::showHistoryMenu(QPoint const &position)
+{
+    Q_UNUSED(position)
+
+    QMenu menu{this};
+    for (int i = 0; i < mHistory.size(); i++)
+    {
+        History::Entry const entry{mHistory.at(i)};
+        QAction *action{menu.addAction(entry.second + " (" + entry.first + ")")};
+        action->setData(i);
+        action->setCheckable(true);
+        action->setChecked(i == historyEntry);
+    }
+
+    QAction const *chosen{menu.exec(ui->pushButtonBack->mapToGlobal(
+                                        QPoint{0, ui->pushButtonBack->height()}))};
+    if (chosen == nullptr)
+        return;
+
+    //Save current term definition before jumping
+    if (isTermSelected())
+        on_pushButtonSave_clicked();
+    viewHistoryEntry(chosen->data().toInt());
 }
 
 /**
@@ -699,19 +1379,169 @@ void MainWindow::on_pushButtonRename_clicked()
 void MainWindow::renameTerm(QString const &newName)
 {
     //Save current term definition before renaming term
+    //And wait for it, so that it is renamed along with the term
     on_pushButtonSave_clicked();
+    mSaveEngine->flush();
 
     //Get name of the current term and rename it
-    QString currentTerm{ui->listWidgetEntries->currentItem()->text()};
-    QFile file{currentTermFolder() + currentTerm};
-    file.rename(currentTermFolder() + newName);
-
-    //Clear the widget list and reload it
-    ui->listWidgetEntries->clear();
-    loadTerms();
+    QString currentTerm{selectedTerm()};
+    TermStore *store{termStore()};
+    if (store == nullptr || !store->rename(currentTerm, newName))
+        return;
+    QSharedPointer<RevisionStore> const revisions{mStorage.revisions(ui->comboBoxDictionaries->currentText())};
+    if (!revisions.isNull())
+        revisions->rename(currentTerm, newName);
+    mFullTextIndex.rename(ui->comboBoxDictionaries->currentText(), currentTerm, newName);
+    mDefinitionCache.remove(ui->comboBoxDictionaries->currentText(), currentTerm);
+    mDefinitionCache.remove(ui->comboBoxDictionaries->currentText(), newName);
+
+    //Replace the term in the term list
+    mTermModel->removeTerm(currentTerm);
+    mTermModel->insertTerm(newName);
+    updateFuzzyMatcher(currentTerm, false);
+    updateFuzzyMatcher(newName, true);
 
     //Set the renamed term as the current item
     //And add the renamed term to the history file
     viewContents(newName, false, true);
 }
 
+
+/**
+ * @brief MainWindow::on_comboBoxSearchMode_currentIndexChanged
+ * Switches the search box between looking up term names in
+ * the current dictionary, searching the words of the
+ * definitions, and searching term names in every dictionary.
+ * @param index the search mode
+ */
+void MainWindow::on_comboBoxSearchMode_currentIndexChanged(int index)
+{
+    //Only the terms of the current dictionary are completed,
+    //the other modes list their results instead
+    ui->lineEditSearch->setCompleter(index == termSearch ? mStringCompleter : nullptr);
+    ui->listWidgetResults->setVisible(index != termSearch);
+    ui->listWidgetResults->clear();
+    mTermSearch->cancel();
+
+    if (index == definitionSearch)
+        searchDefinitions(ui->lineEditSearch->text());
+    else if (index == allDictionariesSearch)
+        searchAllDictionaries(ui->lineEditSearch->text());
+}
+
+/**
+ * @brief MainWindow::searchAllDictionaries
+ * Lists the terms of every dictionary containing the query,
+ * best match first. The current dictionary is searched
+ * first and the others add their matches as they finish.
+ * @param query the text to look for
+ */
+void MainWindow::searchAllDictionaries(QString const &query)
+{
+    ui->listWidgetResults->clear();
+    mTermSearch->search(query, ui->comboBoxDictionaries->currentText(), maxSearchResults);
+}
+
+/**
+ * @brief MainWindow::addTermMatches
+ * Merges the matches of one dictionary into the results,
+ * keeping the best ones.
+ * @param matches the matches of one dictionary
+ */
+void MainWindow::addTermMatches(TermSearch::Matches const &matches)
+{
+    QListWidget *const results{ui->listWidgetResults};
+    auto const matchAt = [results](int row) {
+        QListWidgetItem const *item{results->item(row)};
+        return TermSearch::Match{item->data(Qt::UserRole).toString(),
+                                 item->data(Qt::UserRole + 1).toString(),
+                                 static_cast<TermSearch::Rank>(item->data(Qt::UserRole + 2).toInt())};
+    };
+
+    for (TermSearch::Match const &match: matches)
+    {
+        //Find the first result that is not better than the match
+        int first{0};
+        int count{results->count()};
+        while (count > 0)
+        {
+            int const step{count / 2};
+            if (TermSearch::isBetter(matchAt(first + step), match))
+            {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+                count = step;
+        }
+        if (first >= maxSearchResults)
+            continue;
+
+        QListWidgetItem *item{new QListWidgetItem{match.term + " (" + match.dictionary + ")"}};
+        item->setData(Qt::UserRole, match.dictionary);
+        item->setData(Qt::UserRole + 1, match.term);
+        item->setData(Qt::UserRole + 2, static_cast<int>(match.rank));
+        results->insertItem(first, item);
+        if (results->count() > maxSearchResults)
+            delete results->takeItem(results->count() - 1);
+    }
+}
+
+/**
+ * @brief MainWindow::searchDefinitions
+ * Lists the terms of every dictionary whose definitions
+ * contain all the words of the query, best match first.
+ * @param query the words to look for
+ */
+void MainWindow::searchDefinitions(QString const &query)
+{
+    mDefinitionSearch->setFuture(QtConcurrent::run(&mFullTextIndex, &FullTextIndex::search,
+                                                   query, maxSearchResults));
+}
+
+/**
+ * @brief MainWindow::showDefinitionResults
+ * Lists the results of the latest definition search.
+ */
+void MainWindow::showDefinitionResults()
+{
+    //The search mode may have changed since the search started
+    if (ui->comboBoxSearchMode->currentIndex() != definitionSearch)
+        return;
+
+    ui->listWidgetResults->clear();
+
+    for (FullTextIndex::Hit const &hit: mDefinitionSearch->result())
+    {
+        //Skip dictionaries deleted since the index was synchronized
+        if (ui->comboBoxDictionaries->findText(hit.dictionary) == -1)
+            continue;
+
+        //Keep the dictionary and term apart from the displayed text
+        QListWidgetItem *item{new QListWidgetItem{hit.term + " (" + hit.dictionary + ")"}};
+        item->setData(Qt::UserRole, hit.dictionary);
+        item->setData(Qt::UserRole + 1, hit.term);
+        ui->listWidgetResults->addItem(item);
+    }
+}
+
+/**
+ * @brief MainWindow::on_listWidgetResults_itemClicked
+ * Opens the dictionary of the clicked search result
+ * and displays the definition of its term.
+ * @param item the clicked search result
+ */
+void MainWindow::on_listWidgetResults_itemClicked(QListWidgetItem *item)
+{
+    //Save current term definition before viewing the result
+    if (isTermSelected())
+        on_pushButtonSave_clicked();
+
+    //Set the dictionary that contains the term, its terms are
+    //loaded automatically and the term selected once loaded
+    ui->comboBoxDictionaries->setCurrentText(item->data(Qt::UserRole).toString());
+
+    //Set the term as the current item
+    //And add the term to history file
+    viewContents(item->data(Qt::UserRole + 1).toString(), false, true);
+}
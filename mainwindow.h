@@ -7,8 +7,32 @@
 #include "aboutapp.h"
 #include "delete.h"
 #include "rename.h"
-#include <QListWidgetItem>
+#include "revisions.h"
+#include "history.h"
+#include "storage.h"
+#include "termlistmodel.h"
+#include "termloader.h"
+#include "fulltextindex.h"
+#include "saveengine.h"
+#include "definitioncache.h"
+#include "dictionaryfile.h"
+#include "dictionarytask.h"
+#include "termwatcher.h"
+#include "termsearch.h"
+#include "chunkeddefinition.h"
+#include "edittracker.h"
+#include "metrics.h"
 #include <QCompleter>
+#include <QStringListModel>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QVector>
+#include <QPair>
+
+class QListWidgetItem;
+class QLabel;
 
 namespace Ui {
 class MainWindow;
@@ -35,11 +59,29 @@ private slots:
 
     void on_actionExit_triggered();
 
+    void on_actionPerformance_toggled(bool checked);
+
+    void on_actionSaveTrace_triggered();
+
+    void on_actionImport_triggered();
+
+    void on_actionExport_triggered();
+
+    void on_actionRevisions_triggered();
+
+    void restoreRevision(QByteArray const &contents);
+
+    void finishTransfer();
+
+    void updatePerformance();
+
+    void finishLoadingTerms();
+
     void on_pushButtonSave_clicked();
 
     void on_pushButtonAdd_clicked();
 
-    void on_listWidgetEntries_itemClicked();
+    void on_listViewEntries_clicked();
 
     void on_comboBoxDictionaries_currentTextChanged();
 
@@ -47,44 +89,129 @@ private slots:
 
     void loadTerms();
 
-    QString currentTermFolder(QString const &dictionary = NULL) const;
+    void addLoadedTerms(QStringList const &terms);
+
+    void setFuzzyMatcher(QSharedPointer<FuzzyMatcher> const &matcher);
+
+    void lookUpSuggestion(QString const &term);
+
+    void lookUpSearch();
+
+    void commitSearchHistory();
+
+    void showDefinitionResults();
+
+    void addTermMatches(TermSearch::Matches const &matches);
+
+    void reportSaveFailure(QString const &dictionary, QString const &term);
+
+    void reportInvalidText();
+
+    void applySettings();
 
     void loadTermFolders();
 
-    void deleteTerm();
+    void prepareDictionaryChange();
+
+    void addDictionary(QString const &dictionary);
 
-    void checkHistoryLength(const int documentLength) const;
+    void followDictionaryRename(QString const &dictionary, QString const &newName, bool succeeded);
 
-    void viewContents(QString const &currentTerm,
+    void followDictionaryDeletion(QString const &dictionary, bool succeeded);
+
+    void synchronizeDictionaries();
+
+    void applyTermChanges(QString const &dictionary, QStringList const &removed,
+                          QStringList const &inserted);
+
+    void deleteTerm();
+
+    bool viewContents(QString const &currentTerm,
                       bool isCurrentItem,
                       bool historyUpdateNeeded,
                       bool savePreviousTermNeeded = false);
 
-    void viewContents(QString const &termPath);
+    void viewHistoryEntry(int index);
 
-    void updateHistory(QString const &currentTerm) const;
+    void updateHistory(QString const &currentTerm);
 
     void renameTerm(QString const &newName);
 
     void on_lineEditSearch_textChanged();
 
-    void getHistoryList(QList<QString> &terms);
-
     void on_pushButtonBack_clicked();
 
     void on_pushButtonNext_clicked();
 
+    void showHistoryMenu(QPoint const &position);
+
     void on_pushButtonRename_clicked();
 
+    void on_comboBoxSearchMode_currentIndexChanged(int index);
+
+    void on_listWidgetResults_itemClicked(QListWidgetItem *item);
+
 private:
+    int dictionaryPosition(QString const &dictionary) const;
+
+    void searchDefinitions(QString const &query);
+
+    void searchAllDictionaries(QString const &query);
+
+    void suggestTerms(QString const &text);
+
+    void updateFuzzyMatcher(QString const &term, bool inserted);
+
+    void prefetchDefinitions(QString const &currentTerm);
+
+    TermStore *termStore(QString const &dictionary = NULL);
+
+    bool isTermSelected() const;
+
+    QString selectedTerm() const;
+
+    void setTermControlsEnabled(bool enabled);
+
     Ui::MainWindow *ui;
     Dictionaries *mDictionaries;
     Configuration *mConfiguration;
     AboutApp *mAboutApp;
     Delete *mDelete;
     QCompleter *mStringCompleter;
+    QCompleter *mFuzzyCompleter;
+    QStringListModel *mFuzzyModel;
+    SaveEngine *mSaveEngine;
+    ChunkedDefinition *mChunkedDefinition;
+    EditTracker *mEditTracker;
+    QTimer *mSearchTimer;
+    QTimer *mHistoryTimer;
+    QTimer *mPerformanceTimer;
+    QLabel *mPerformanceLabel;
+    //When the terms of the current dictionary started loading
+    qint64 mLoadStarted;
+    QFutureWatcher<QVector<FullTextIndex::Hit>> *mDefinitionSearch;
+    //The running import or export, one at a time
+    QFutureWatcher<DictionaryFile::Result> *mTransfer;
+    QString mTransferDictionary;
+    bool mImporting;
+    DictionaryTask *mDictionaryTask;
+    TermListModel *mTermModel;
+    TermLoader *mTermLoader;
+    TermWatcher *mTermWatcher;
+    TermSearch *mTermSearch;
     Rename *mRename;
-
+    Storage mStorage;
+    History mHistory;
+    FullTextIndex mFullTextIndex;
+    DefinitionCache mDefinitionCache;
+    QFuture<void> mIndexing;
+    //Indexing of the last saved large definition
+    QFuture<void> mChunkIndexing;
+    QSharedPointer<FuzzyMatcher> mFuzzyMatcher;
+    //Terms added (true) or removed (false) while the matcher is built
+    QVector<QPair<QString, bool>> mPendingFuzzyEdits;
+    //The searched term, committed to the history once it settles
+    History::Entry mPendingHistoryEntry;
 };
 
 #endif // MAINWINDOW_H
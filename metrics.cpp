@@ -0,0 +1,299 @@
+#include "metrics.h"
+
+#include <QThread>
+#include <QHash>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#include <cmath>
+
+//The names of the timed operations, in the order of Metrics::Id
+char const *const metricNames[]{
+    "ChunkedDefinition::load",
+    "ChunkedDefinition::parts",
+    "ChunkedDefinition::split",
+    "DictionaryFile::export",
+    "DictionaryFile::import",
+    "DictionaryTask::reclaim",
+    "DictionaryTask::rename",
+    "MainWindow::loadTerms",
+    "MainWindow::lookUpSearch",
+    "MainWindow::on_lineEditSearch_textChanged",
+    "MainWindow::on_pushButtonSave_clicked",
+    "MainWindow::updateHistory",
+    "MainWindow::viewContents",
+    "RevisionStore::compactFiles",
+    "RevisionStore::record",
+    "SaveEngine::write",
+    "TermLoader::run",
+    "TermSearch::run",
+    "TermWatcher::run"
+};
+static_assert(sizeof(metricNames) / sizeof(metricNames[0]) == Metrics::IdCount,
+              "every timed operation needs a name");
+
+//Keep this many of the most recent events for the trace,
+//a power of two so that the slots wrap with the counter
+int const maxEvents{65536};
+
+//Durations are in microseconds; the last bucket holds
+//everything from about 17 minutes on
+int const bucketsPerDoubling{4};
+int const bucketCount{40 * bucketsPerDoubling};
+
+/**
+ * @brief bucket
+ * @param duration a duration in microseconds
+ * @return the histogram bucket counting it
+ */
+static int bucket(qint64 duration)
+{
+    if (duration <= 1)
+        return 0;
+    int const index{static_cast<int>(std::log2(static_cast<double>(duration)) * bucketsPerDoubling)};
+    return qMin(index, bucketCount - 1);
+}
+
+/**
+ * @brief formatDuration
+ * @param duration a duration in microseconds
+ * @return the duration in readable units
+ */
+static QString formatDuration(qint64 duration)
+{
+    if (duration < 1000)
+        return QString::number(duration) + " us";
+    if (duration < 1000000)
+        return QString::number(duration / 1000.0, 'f', 1) + " ms";
+    return QString::number(duration / 1000000.0, 'f', 2) + " s";
+}
+
+/**
+ * @brief formatBytes
+ * @param bytes a number of bytes
+ * @return the number in readable units
+ */
+static QString formatBytes(qint64 bytes)
+{
+    if (bytes < 1024)
+        return QString::number(bytes) + " B";
+    if (bytes < 1024 * 1024)
+        return QString::number(bytes / 1024.0, 'f', 1) + " KB";
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+}
+
+/**
+ * @brief Metrics::Metrics
+ * Starts the clock that every event is timed against.
+ * Every histogram and event slot is allocated up front, so
+ * recording never allocates or locks.
+ */
+Metrics::Metrics() :
+    mBuckets(IdCount * bucketCount),
+    mEvents(maxEvents),
+    mRecorded{0},
+    mBytesRead{0},
+    mBytesWritten{0}
+{
+    mClock.start();
+    //Slots that were never written are skipped by the trace
+    for (Event &event: mEvents)
+        event.id.storeRelease(-1);
+}
+
+/**
+ * @brief Metrics::instance
+ * @return the metrics of the program, shared by every thread
+ */
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * @brief Metrics::now
+ * @return the microseconds elapsed since the program started
+ */
+qint64 Metrics::now() const
+{
+    return mClock.nsecsElapsed() / 1000;
+}
+
+/**
+ * @brief Metrics::record
+ * Counts a timed operation in its histogram and keeps it
+ * for the trace. Threads only share counters, which are
+ * updated atomically.
+ * @param id the operation
+ * @param start when it started, in microseconds
+ * @param duration how long it took, in microseconds
+ */
+void Metrics::record(Id id, qint64 start, qint64 duration)
+{
+    mBuckets[id * bucketCount + bucket(duration)].fetchAndAddRelaxed(1);
+
+    Event &event{mEvents[mRecorded.fetchAndAddRelaxed(1) % maxEvents]};
+    event.start.storeRelease(start);
+    event.duration.storeRelease(duration);
+    event.thread.storeRelease(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    event.id.storeRelease(id);
+}
+
+/**
+ * @brief Metrics::addBytesRead
+ * @param bytes how many bytes of definitions were read
+ */
+void Metrics::addBytesRead(qint64 bytes)
+{
+    mBytesRead.fetchAndAddRelaxed(bytes);
+}
+
+/**
+ * @brief Metrics::addBytesWritten
+ * @param bytes how many bytes were written to the packs
+ */
+void Metrics::addBytesWritten(qint64 bytes)
+{
+    mBytesWritten.fetchAndAddRelaxed(bytes);
+}
+
+/**
+ * @brief Metrics::percentile
+ * @param id the operation
+ * @param fraction the fraction of operations, such as 0.99
+ * @return the duration that many operations did not exceed,
+ * rounded up to the end of its bucket, in microseconds, or
+ * -1 if the operation never ran
+ */
+qint64 Metrics::percentile(Id id, double fraction) const
+{
+    //Copy the buckets, since other threads may still count
+    QVector<quint32> buckets(bucketCount);
+    quint64 count{0};
+    for (int i = 0; i < bucketCount; i++)
+    {
+        buckets[i] = mBuckets[id * bucketCount + i].loadAcquire();
+        count += buckets[i];
+    }
+    if (count == 0)
+        return -1;
+
+    quint64 const target{static_cast<quint64>(std::ceil(count * fraction))};
+    quint64 seen{0};
+    for (int i = 0; i < bucketCount; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+            return static_cast<qint64>(std::exp2(static_cast<double>(i + 1) / bucketsPerDoubling));
+    }
+    return 0;
+}
+
+/**
+ * @brief Metrics::summary
+ * @return the median and 99th percentile of every timed
+ * operation, and the bytes read and written, on one line
+ */
+QString Metrics::summary() const
+{
+    QStringList parts;
+
+    for (int id = 0; id < IdCount; id++)
+    {
+        qint64 const median{percentile(static_cast<Id>(id), 0.5)};
+        if (median < 0)
+            continue;
+        //Class names only make the line longer
+        QString const name{QString::fromLatin1(metricNames[id]).section("::", -1)};
+        parts << name + " " + formatDuration(median) +
+                 "/" + formatDuration(percentile(static_cast<Id>(id), 0.99));
+    }
+
+    parts << "read " + formatBytes(mBytesRead.loadAcquire()) +
+             ", written " + formatBytes(mBytesWritten.loadAcquire());
+    return parts.join(" | ");
+}
+
+/**
+ * @brief Metrics::writeTrace
+ * Writes the recent events in the Chrome trace format, which
+ * chrome://tracing and Perfetto can open.
+ * @param path the trace file
+ * @return whether the trace was written
+ */
+bool Metrics::writeTrace(QString const &path) const
+{
+    QJsonArray events;
+    QHash<quintptr, int> threads;
+    qint64 const pid{QCoreApplication::applicationPid()};
+
+    //Once the buffer is full, the oldest event is the next to be overwritten
+    quint64 const recorded{mRecorded.loadAcquire()};
+    int const first{recorded < maxEvents ? 0 : static_cast<int>(recorded % maxEvents)};
+    for (int i = 0; i < maxEvents; i++)
+    {
+        Event const &event{mEvents[(first + i) % maxEvents]};
+        int const id{event.id.loadAcquire()};
+        if (id < 0)
+            continue;
+        quintptr const thread{event.thread.loadAcquire()};
+        if (!threads.contains(thread))
+            threads.insert(thread, threads.size() + 1);
+
+        QJsonObject object;
+        object.insert("name", QString::fromLatin1(metricNames[id]));
+        object.insert("ph", "X");
+        object.insert("ts", static_cast<double>(event.start.loadAcquire()));
+        object.insert("dur", static_cast<double>(event.duration.loadAcquire()));
+        object.insert("pid", static_cast<double>(pid));
+        object.insert("tid", threads.value(thread));
+        events.append(object);
+    }
+
+    //Record the totals once, at the time of writing
+    QJsonObject bytes;
+    bytes.insert("read", static_cast<double>(mBytesRead.loadAcquire()));
+    bytes.insert("written", static_cast<double>(mBytesWritten.loadAcquire()));
+    QJsonObject counter;
+    counter.insert("name", "bytes");
+    counter.insert("ph", "C");
+    counter.insert("ts", static_cast<double>(now()));
+    counter.insert("pid", static_cast<double>(pid));
+    counter.insert("args", bytes);
+    events.append(counter);
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", "ms");
+
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument{trace}.toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+/**
+ * @brief ScopedTimer::ScopedTimer
+ * Starts timing an operation, which ends when the timer
+ * goes out of scope.
+ * @param id the operation
+ */
+ScopedTimer::ScopedTimer(Metrics::Id id) :
+    mId{id},
+    mStart{Metrics::instance().now()}
+{
+}
+
+/**
+ * @brief ScopedTimer::~ScopedTimer
+ * Records the timed operation.
+ */
+ScopedTimer::~ScopedTimer()
+{
+    Metrics &metrics{Metrics::instance()};
+    metrics.record(mId, mStart, metrics.now() - mStart);
+}
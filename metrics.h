@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+
+class Metrics
+{
+public:
+    //The timed operations, each named in metrics.cpp
+    enum Id
+    {
+        ChunkedDefinitionLoad,
+        ChunkedDefinitionParts,
+        ChunkedDefinitionSplit,
+        DictionaryFileExport,
+        DictionaryFileImport,
+        DictionaryTaskReclaim,
+        DictionaryTaskRename,
+        MainWindowLoadTerms,
+        MainWindowLookUpSearch,
+        MainWindowSearchTextChanged,
+        MainWindowSave,
+        MainWindowUpdateHistory,
+        MainWindowViewContents,
+        RevisionStoreCompactFiles,
+        RevisionStoreRecord,
+        SaveEngineWrite,
+        TermLoaderRun,
+        TermSearchRun,
+        TermWatcherRun,
+        IdCount
+    };
+
+    static Metrics &instance();
+
+    qint64 now() const;
+
+    void record(Id id, qint64 start, qint64 duration);
+
+    void addBytesRead(qint64 bytes);
+
+    void addBytesWritten(qint64 bytes);
+
+    QString summary() const;
+
+    bool writeTrace(QString const &path) const;
+
+private:
+    //Written by whichever thread claims the slot, so a trace
+    //written meanwhile may mix the fields of two events
+    struct Event
+    {
+        QAtomicInteger<int> id;
+        QAtomicInteger<qint64> start;
+        QAtomicInteger<qint64> duration;
+        QAtomicInteger<quintptr> thread;
+    };
+
+    Metrics();
+
+    qint64 percentile(Id id, double fraction) const;
+
+    QElapsedTimer mClock;
+    //Durations counted in buckets a quarter of a power of two
+    //wide, one run of buckets per operation
+    QVector<QAtomicInteger<quint32>> mBuckets;
+    //The most recent events, oldest overwritten first
+    QVector<Event> mEvents;
+    QAtomicInteger<quint64> mRecorded;
+    QAtomicInteger<qint64> mBytesRead;
+    QAtomicInteger<qint64> mBytesWritten;
+};
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Metrics::Id id);
+    ~ScopedTimer();
+
+private:
+    Metrics::Id const mId;
+    qint64 const mStart;
+};
+
+#endif // METRICS_H
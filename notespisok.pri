@@ -0,0 +1,67 @@
+# Sources shared by the application and the benchmarks
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+        $$PWD/aboutapp.cpp \
+        $$PWD/chunkeddefinition.cpp \
+        $$PWD/configuration.cpp \
+        $$PWD/definitioncache.cpp \
+        $$PWD/delete.cpp \
+        $$PWD/dictionaries.cpp \
+        $$PWD/dictionaryfile.cpp \
+        $$PWD/dictionarytask.cpp \
+        $$PWD/edittracker.cpp \
+        $$PWD/fulltextindex.cpp \
+        $$PWD/fuzzymatcher.cpp \
+        $$PWD/history.cpp \
+        $$PWD/mainwindow.cpp \
+        $$PWD/metrics.cpp \
+        $$PWD/packedtermstore.cpp \
+        $$PWD/rename.cpp \
+        $$PWD/revisions.cpp \
+        $$PWD/revisionstore.cpp \
+        $$PWD/saveengine.cpp \
+        $$PWD/storage.cpp \
+        $$PWD/termlistmodel.cpp \
+        $$PWD/termloader.cpp \
+        $$PWD/termsearch.cpp \
+        $$PWD/termwatcher.cpp \
+        $$PWD/textcodec.cpp
+
+HEADERS += \
+        $$PWD/aboutapp.h \
+        $$PWD/chunkeddefinition.h \
+        $$PWD/configuration.h \
+        $$PWD/definitioncache.h \
+        $$PWD/delete.h \
+        $$PWD/dictionaries.h \
+        $$PWD/dictionaryfile.h \
+        $$PWD/dictionarytask.h \
+        $$PWD/edittracker.h \
+        $$PWD/fulltextindex.h \
+        $$PWD/fuzzymatcher.h \
+        $$PWD/history.h \
+        $$PWD/mainwindow.h \
+        $$PWD/metrics.h \
+        $$PWD/packedtermstore.h \
+        $$PWD/rename.h \
+        $$PWD/revisions.h \
+        $$PWD/revisionstore.h \
+        $$PWD/saveengine.h \
+        $$PWD/storage.h \
+        $$PWD/termlistmodel.h \
+        $$PWD/termloader.h \
+        $$PWD/termsearch.h \
+        $$PWD/termstore.h \
+        $$PWD/termwatcher.h \
+        $$PWD/textcodec.h
+
+FORMS += \
+        $$PWD/aboutapp.ui \
+        $$PWD/configuration.ui \
+        $$PWD/delete.ui \
+        $$PWD/dictionaries.ui \
+        $$PWD/mainwindow.ui \
+        $$PWD/rename.ui \
+        $$PWD/revisions.ui
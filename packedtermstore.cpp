@@ -0,0 +1,1024 @@
+#include "packedtermstore.h"
+#include "metrics.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+/* Pack file layout:
+ *
+ * header  "NSPK", version, index offset, tail offset
+ * blob    the definitions, one after another
+ * index   term count, then name, offset, size,
+ *         modification time and flags of every term
+ * tail    records appended since the last compaction
+ *
+ * Every write appends a record to the tail, so the blob
+ * and index are only rewritten when the pack is compacted.
+ * A small edit to a definition is appended as a patch,
+ * holding only the bytes that changed; patches are folded
+ * into the definition when the pack is compacted, or when
+ * a term gathers too many of them.
+ *
+ * When compression is turned on, definitions that shrink
+ * noticeably are stored compressed with qCompress, in
+ * their own kind of record and flagged in the index.
+ * Version 1 packs have no flags and are read as they are.
+ *
+ * Every public function takes the store's lock, so a store
+ * can be shared between the interface and worker threads.
+ */
+char const packMagic[4]{'N', 'S', 'P', 'K'};
+quint32 const packVersion{2};
+qint64 const headerSize{4 + 4 + 8 + 8};
+QDataStream::Version const streamVersion{QDataStream::Qt_5_0};
+
+//Do not bother compacting packs that waste less than this
+qint64 const minimumWaste{64 * 1024};
+
+//Write the whole definition instead of one more patch once
+//a term has this many
+int const maxPatches{16};
+
+//Smaller definitions are never compressed, they gain too little
+qint64 const minimumCompressedSize{512};
+
+//Flags of the entries in the index
+quint8 const compressedFlag{1};
+
+/**
+ * @brief compress
+ * Compresses a definition, unless that saves too little
+ * to be worth decompressing it on every read.
+ * @param parts the pieces of the definition, in order
+ * @param size the size of the definition
+ * @return the compressed definition, or nothing if it
+ * should be stored as it is
+ */
+static QByteArray compress(TermStore::Parts const &parts, qint64 size)
+{
+    if (size < minimumCompressedSize)
+        return QByteArray{};
+
+    QByteArray contents;
+    if (parts.size() == 1)
+        contents = parts.first();
+    else
+    {
+        contents.reserve(static_cast<int>(size));
+        for (QByteArray const &part: parts)
+            contents += part;
+    }
+
+    //Keep the definition as it is unless it shrinks by an eighth
+    QByteArray const compressed{qCompress(contents)};
+    if (compressed.size() > size - size / 8)
+        return QByteArray{};
+    return compressed;
+}
+
+/**
+ * @brief applySplice
+ * Replaces a range of a definition.
+ * @param splice the range and its replacement
+ * @param contents the definition
+ * @return whether the range lies inside the definition
+ */
+static bool applySplice(TermStore::Splice const &splice, QByteArray &contents)
+{
+    if (static_cast<qint64>(splice.offset) + splice.removed > contents.size())
+        return false;
+    contents.replace(static_cast<int>(splice.offset), static_cast<int>(splice.removed),
+                     splice.inserted);
+    return true;
+}
+
+/**
+ * @brief sameContents
+ * @param contents a definition
+ * @param parts the pieces of another definition
+ * @return whether both definitions are the same
+ */
+static bool sameContents(QByteArray const &contents, TermStore::Parts const &parts)
+{
+    int offset{0};
+    for (QByteArray const &part: parts)
+    {
+        if (part.size() > contents.size() - offset ||
+                std::memcmp(contents.constData() + offset, part.constData(),
+                            static_cast<size_t>(part.size())) != 0)
+            return false;
+        offset += part.size();
+    }
+    return offset == contents.size();
+}
+
+/**
+ * @brief PackedTermStore::PackedTermStore
+ * Creates a store backed by a single pack file.
+ * Call open() before using it.
+ * @param path the pack file
+ */
+PackedTermStore::PackedTermStore(QString const &path) :
+    mPath{path},
+    mFile{path},
+    mMap{nullptr},
+    mMappedSize{0},
+    mLiveBytes{0},
+    mNameBytes{0},
+    mCompression{false},
+    mSorted{false}
+{
+}
+
+PackedTermStore::~PackedTermStore()
+{
+    unmap();
+    mFile.close();
+}
+
+/**
+ * @brief PackedTermStore::open
+ * Opens the pack file, creating it if needed, reads the
+ * index and replays the records appended after it. A record
+ * cut short by a crash is discarded.
+ * @return whether the pack could be opened
+ */
+bool PackedTermStore::open()
+{
+    QMutexLocker locker{&mMutex};
+
+    if (!QFile::exists(mPath) && !create())
+        return false;
+
+    if (!mFile.open(QIODevice::ReadWrite))
+        return false;
+
+    QDataStream inStream{&mFile};
+    inStream.setVersion(streamVersion);
+
+    char magic[4];
+    quint32 version{0};
+    qint64 indexOffset{0};
+    qint64 tailOffset{0};
+    if (inStream.readRawData(magic, 4) != 4 ||
+            std::memcmp(magic, packMagic, 4) != 0)
+        return false;
+    inStream >> version >> indexOffset >> tailOffset;
+    if (inStream.status() != QDataStream::Ok || version < 1 || version > packVersion)
+        return false;
+
+    if (!readIndex(inStream, indexOffset, version))
+        return false;
+    replayTail(inStream, tailOffset);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::create
+ * Writes an empty pack: a header followed by an empty index.
+ * @return whether the pack was created
+ */
+bool PackedTermStore::create()
+{
+    QSaveFile pack{mPath};
+    if (!pack.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream outStream{&pack};
+    outStream.setVersion(streamVersion);
+    outStream.writeRawData(packMagic, 4);
+    outStream << packVersion << headerSize << headerSize + 4 << quint32{0};
+
+    return outStream.status() == QDataStream::Ok && pack.commit();
+}
+
+/**
+ * @brief PackedTermStore::readIndex
+ * Loads the index written by the last compaction.
+ * @param inStream a stream over the pack file
+ * @param indexOffset where the index starts
+ * @param version the version of the pack
+ * @return whether the index could be read
+ */
+bool PackedTermStore::readIndex(QDataStream &inStream, qint64 indexOffset, quint32 version)
+{
+    if (!mFile.seek(indexOffset))
+        return false;
+
+    quint32 count{0};
+    inStream >> count;
+    mEntries.reserve(static_cast<int>(count));
+    for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+    {
+        QByteArray name;
+        Entry entry{0, 0, 0, 0, {}, false};
+        quint8 flags{0};
+        inStream >> name >> entry.offset >> entry.size >> entry.modified;
+        if (version >= 2)
+            inStream >> flags;
+        entry.compressed = (flags & compressedFlag) != 0;
+        insertEntry(QString::fromUtf8(name), entry);
+    }
+    return inStream.status() == QDataStream::Ok;
+}
+
+/**
+ * @brief PackedTermStore::replayTail
+ * Applies the records appended since the last compaction.
+ * @param inStream a stream over the pack file
+ * @param tailOffset where the first record starts
+ */
+void PackedTermStore::replayTail(QDataStream &inStream, qint64 tailOffset)
+{
+    if (!mFile.seek(tailOffset))
+        return;
+
+    while (!mFile.atEnd())
+    {
+        qint64 const recordStart{mFile.pos()};
+
+        quint8 operation{0};
+        QByteArray name;
+        QByteArray newName;
+        Entry entry{0, 0, 0};
+        inStream >> operation >> name;
+        if (operation == Put || operation == CompressedPut)
+        {
+            inStream >> entry.modified >> entry.size;
+            entry.offset = mFile.pos();
+            entry.compressed = operation == CompressedPut;
+            if (inStream.skipRawData(static_cast<int>(entry.size)) !=
+                    static_cast<int>(entry.size))
+                inStream.setStatus(QDataStream::ReadPastEnd);
+        }
+        else if (operation == Rename)
+            inStream >> newName >> entry.modified;
+        else if (operation == Patch)
+        {
+            inStream >> entry.modified >> entry.size;
+            entry.offset = mFile.pos();
+            quint32 count{0};
+            inStream >> count;
+            for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+            {
+                Splice splice;
+                inStream >> splice.offset >> splice.removed >> splice.inserted;
+            }
+        }
+        else if (operation != Remove)
+            inStream.setStatus(QDataStream::ReadCorruptData);
+
+        //The record was cut short, drop it and everything after it
+        if (inStream.status() != QDataStream::Ok)
+        {
+            mFile.resize(recordStart);
+            return;
+        }
+
+        QString const term{QString::fromUtf8(name)};
+        if (operation == Put || operation == CompressedPut)
+            insertEntry(term, entry);
+        else if (operation == Remove)
+            removeEntry(term);
+        else if (operation == Patch && mEntries.contains(term))
+        {
+            Entry patched{mEntries.value(term)};
+            if (patched.patches.isEmpty())
+                patched.baseSize = patched.size;
+            patched.patches.push_back(entry.offset);
+            patched.size = entry.size;
+            patched.modified = entry.modified;
+            insertEntry(term, patched);
+        }
+        else if (operation == Rename && mEntries.contains(term))
+        {
+            Entry renamed{mEntries.value(term)};
+            renamed.modified = entry.modified;
+            removeEntry(term);
+            insertEntry(QString::fromUtf8(newName), renamed);
+        }
+    }
+}
+
+/**
+ * @brief PackedTermStore::insertEntry
+ * Adds or replaces a term in the in-memory index.
+ * @param term the term name
+ * @param entry where the definition is stored
+ */
+void PackedTermStore::insertEntry(QString const &term, Entry const &entry)
+{
+    //A new definition of a listed term keeps the list as it is
+    auto const existing = mEntries.find(term);
+    if (existing != mEntries.end())
+    {
+        mLiveBytes += static_cast<qint64>(entry.size) - existing.value().size;
+        existing.value() = entry;
+        return;
+    }
+
+    mEntries.insert(term, entry);
+    mLiveBytes += entry.size;
+    mNameBytes += term.toUtf8().size();
+    mSorted = false;
+}
+
+/**
+ * @brief PackedTermStore::removeEntry
+ * Removes a term from the in-memory index.
+ * @param term the term name
+ */
+void PackedTermStore::removeEntry(QString const &term)
+{
+    auto const entry = mEntries.find(term);
+    if (entry == mEntries.end())
+        return;
+    mLiveBytes -= entry.value().size;
+    mNameBytes -= term.toUtf8().size();
+    mEntries.erase(entry);
+    mSorted = false;
+}
+
+/**
+ * @brief PackedTermStore::terms
+ * @return every term name, sorted ignoring case
+ */
+QStringList PackedTermStore::terms() const
+{
+    QMutexLocker locker{&mMutex};
+    return sortedTerms();
+}
+
+/**
+ * @brief PackedTermStore::sortedTerms
+ * Sorts the names once and keeps them until a term is
+ * added or removed, so listing the terms again, as every
+ * search across dictionaries does, costs nothing.
+ * @return every term name, sorted ignoring case; the
+ * caller holds the lock
+ */
+QStringList PackedTermStore::sortedTerms() const
+{
+    if (mSorted)
+        return mSortedTerms;
+
+    mSortedTerms = mEntries.keys();
+    std::sort(mSortedTerms.begin(), mSortedTerms.end(), [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    mSorted = true;
+    return mSortedTerms;
+}
+
+/**
+ * @brief PackedTermStore::contains
+ * @param term the term name
+ * @return whether the term is stored
+ */
+bool PackedTermStore::contains(QString const &term) const
+{
+    QMutexLocker locker{&mMutex};
+    return mEntries.contains(term);
+}
+
+/**
+ * @brief PackedTermStore::count
+ * @return the number of terms
+ */
+int PackedTermStore::count() const
+{
+    QMutexLocker locker{&mMutex};
+    return mEntries.size();
+}
+
+/**
+ * @brief PackedTermStore::modified
+ * @param term the term name
+ * @return when the term was last written, in milliseconds
+ * since the epoch, or -1 if it is not stored
+ */
+qint64 PackedTermStore::modified(QString const &term) const
+{
+    QMutexLocker locker{&mMutex};
+
+    auto const entry = mEntries.constFind(term);
+    if (entry == mEntries.constEnd())
+        return -1;
+    return entry.value().modified;
+}
+
+/**
+ * @brief PackedTermStore::read
+ * Reads a copy of the definition of a term. The pack is
+ * never mapped again here, so reading from a worker thread
+ * does not invalidate a slice returned by view().
+ * @param term the term name
+ * @param contents where the definition is stored
+ * @return whether the term exists and could be read
+ */
+bool PackedTermStore::read(QString const &term, QByteArray &contents)
+{
+    QMutexLocker locker{&mMutex};
+
+    auto const entry = mEntries.constFind(term);
+    if (entry == mEntries.constEnd() || !viewEntry(entry.value(), contents, false))
+        return false;
+
+    //Detach the contents from the mapping
+    contents = QByteArray{contents.constData(), contents.size()};
+    Metrics::instance().addBytesRead(contents.size());
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::view
+ * Returns the definition of a term as a slice of the
+ * memory-mapped pack, without copying it. The slice stays
+ * valid until a later view() has to map the pack again,
+ * or until the store is compacted or closed, so use read()
+ * to keep the definition around. Only call view() where no
+ * other thread may use the store meanwhile, such as the
+ * command line.
+ * @param term the term name
+ * @param contents the slice of the mapping holding the definition
+ * @return whether the term exists and could be read
+ */
+bool PackedTermStore::view(QString const &term, QByteArray &contents)
+{
+    QMutexLocker locker{&mMutex};
+
+    auto const entry = mEntries.constFind(term);
+    if (entry == mEntries.constEnd() || !viewEntry(entry.value(), contents, true))
+        return false;
+    Metrics::instance().addBytesRead(contents.size());
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::viewEntry
+ * Returns a slice of the mapping holding a definition, or
+ * a copy read from the file if the mapping does not reach it.
+ * Compressed and patched definitions are decoded into a copy.
+ * @param entry where the definition is stored
+ * @param contents the definition
+ * @param remapAllowed whether the pack may be mapped again
+ * to reach definitions appended after the current mapping
+ * @return whether the definition could be read
+ */
+bool PackedTermStore::viewEntry(Entry const &entry, QByteArray &contents,
+                                bool remapAllowed)
+{
+    //A patched definition is rebuilt from the one it started as
+    if (!entry.patches.isEmpty())
+    {
+        QByteArray base;
+        if (!viewEntry(Entry{entry.offset, entry.baseSize, entry.modified, 0, {}, entry.compressed},
+                       base, remapAllowed))
+            return false;
+        contents = QByteArray{base.constData(), base.size()};
+        for (qint64 const patch: entry.patches)
+            if (!applyPatch(patch, contents))
+                return false;
+        return contents.size() == static_cast<int>(entry.size);
+    }
+
+    if (!viewRecord(entry.offset, entry.size, contents, remapAllowed))
+        return false;
+    if (entry.compressed)
+    {
+        contents = qUncompress(contents);
+        return !contents.isEmpty();
+    }
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::viewRecord
+ * Returns a slice of the mapping holding the bytes of a
+ * record, or a copy read from the file if the mapping does
+ * not reach them.
+ * @param offset where the bytes start
+ * @param storedSize the number of bytes
+ * @param contents the bytes
+ * @param remapAllowed whether the pack may be mapped again
+ * to reach records appended after the current mapping
+ * @return whether the bytes could be read
+ */
+bool PackedTermStore::viewRecord(qint64 offset, quint32 storedSize, QByteArray &contents,
+                                 bool remapAllowed)
+{
+    //Only map the pack again if the record was appended
+    //after the current mapping was made
+    int const size{static_cast<int>(storedSize)};
+    if (offset + size > mMappedSize && (!remapAllowed || !map(offset + size)))
+    {
+        //Fall back to reading the file if it cannot be mapped
+        if (!mFile.seek(offset))
+            return false;
+        contents = mFile.read(size);
+        return contents.size() == size;
+    }
+
+    contents = QByteArray::fromRawData(reinterpret_cast<char const *>(mMap) + offset, size);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::applyPatch
+ * Applies the splices of a patch record to a definition.
+ * @param offset where the splices of the record start
+ * @param contents the definition as left by earlier records
+ * @return whether the record could be read and applied
+ */
+bool PackedTermStore::applyPatch(qint64 offset, QByteArray &contents)
+{
+    if (!mFile.seek(offset))
+        return false;
+
+    QDataStream inStream{&mFile};
+    inStream.setVersion(streamVersion);
+    quint32 count{0};
+    inStream >> count;
+    for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+    {
+        Splice splice;
+        inStream >> splice.offset >> splice.removed >> splice.inserted;
+        if (inStream.status() == QDataStream::Ok && !applySplice(splice, contents))
+            return false;
+    }
+    return inStream.status() == QDataStream::Ok;
+}
+
+/**
+ * @brief PackedTermStore::map
+ * Maps the whole pack into memory, replacing the
+ * previous mapping.
+ * @param end the offset the mapping has to reach
+ * @return whether the pack was mapped up to end
+ */
+bool PackedTermStore::map(qint64 end)
+{
+    unmap();
+
+    qint64 const size{mFile.size()};
+    if (size < end)
+        return false;
+
+    mMap = mFile.map(0, size);
+    if (mMap == nullptr)
+        return false;
+    mMappedSize = size;
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::unmap
+ * Releases the current mapping, if any.
+ */
+void PackedTermStore::unmap()
+{
+    if (mMap != nullptr)
+        mFile.unmap(mMap);
+    mMap = nullptr;
+    mMappedSize = 0;
+}
+
+/**
+ * @brief PackedTermStore::changedOnDisk
+ * Tells whether another program changed the pack since
+ * the store last read or wrote it, either by replacing
+ * the file or by writing to it.
+ * @return whether the file at the path of the pack is
+ * not the one the store has open, as it left it
+ */
+bool PackedTermStore::changedOnDisk() const
+{
+    QMutexLocker locker{&mMutex};
+
+    QFileInfo const onDisk{mPath};
+    return !onDisk.exists() || onDisk.size() != mFile.size() ||
+            onDisk.lastModified() != mFile.fileTime(QFileDevice::FileModificationTime);
+}
+
+/**
+ * @brief PackedTermStore::setCompression
+ * Chooses whether definitions written from now on are
+ * compressed. Definitions already stored are converted
+ * when the pack is next compacted.
+ * @param enabled whether to compress definitions
+ */
+void PackedTermStore::setCompression(bool enabled)
+{
+    QMutexLocker locker{&mMutex};
+    mCompression = enabled;
+}
+
+/**
+ * @brief PackedTermStore::write
+ * Stores the definition of a term, creating the term
+ * if it does not exist.
+ * @param term the term name
+ * @param contents the definition
+ * @return whether the definition was stored
+ */
+bool PackedTermStore::write(QString const &term, QByteArray const &contents)
+{
+    return write(term, contents, QDateTime::currentMSecsSinceEpoch());
+}
+
+/**
+ * @brief PackedTermStore::write
+ * Appends a record with the definition of a term.
+ * @param term the term name
+ * @param contents the definition
+ * @param modified the modification time, in milliseconds
+ * since the epoch
+ * @return whether the definition was stored
+ */
+bool PackedTermStore::write(QString const &term, QByteArray const &contents,
+                            qint64 modified)
+{
+    QMutexLocker locker{&mMutex};
+    return writeRecord(term, Parts{contents}, modified);
+}
+
+/**
+ * @brief PackedTermStore::writeParts
+ * Stores a definition given in pieces, which are written
+ * one after another into a single record, so that large
+ * definitions never need to be joined in memory.
+ * @param term the term name
+ * @param parts the pieces of the definition, in order
+ * @return whether the definition was stored
+ */
+bool PackedTermStore::writeParts(QString const &term, Parts const &parts)
+{
+    QMutexLocker locker{&mMutex};
+    return writeRecord(term, parts, QDateTime::currentMSecsSinceEpoch());
+}
+
+/**
+ * @brief PackedTermStore::writeDelta
+ * Stores a definition by appending only what changed, when
+ * the delta turns the stored definition into it. Otherwise,
+ * as when the definition was changed by another program,
+ * or when the delta is nearly as large as the definition,
+ * or the term already has many patches, the whole
+ * definition is written instead.
+ * @param term the term name
+ * @param delta the changes made to the stored definition
+ * @param parts the pieces of the new definition, in order
+ * @return whether the definition was stored
+ */
+bool PackedTermStore::writeDelta(QString const &term, Delta const &delta, Parts const &parts)
+{
+    qint64 const modified{QDateTime::currentMSecsSinceEpoch()};
+    QMutexLocker locker{&mMutex};
+
+    qint64 size{0};
+    for (QByteArray const &part: parts)
+        size += part.size();
+    qint64 deltaSize{4};
+    for (Splice const &splice: delta)
+        deltaSize += 4 + 4 + 4 + splice.inserted.size();
+
+    auto const entry = mEntries.constFind(term);
+    if (entry == mEntries.constEnd() || entry.value().patches.size() >= maxPatches ||
+            deltaSize * 2 > size)
+        return writeRecord(term, parts, modified);
+
+    //Check the delta against the stored definition, so that a
+    //patch never applies to a definition it was not made for
+    QByteArray contents;
+    if (!viewEntry(entry.value(), contents, false))
+        return writeRecord(term, parts, modified);
+    contents = QByteArray{contents.constData(), contents.size()};
+    for (Splice const &splice: delta)
+        if (!applySplice(splice, contents))
+            return writeRecord(term, parts, modified);
+    if (!sameContents(contents, parts))
+        return writeRecord(term, parts, modified);
+
+    qint64 const recordOffset{mFile.size()};
+    if (!mFile.seek(recordOffset))
+        return false;
+
+    QDataStream outStream{&mFile};
+    outStream.setVersion(streamVersion);
+    outStream << static_cast<quint8>(Patch) << term.toUtf8() << modified
+              << static_cast<quint32>(size);
+    qint64 const patchOffset{mFile.pos()};
+    outStream << static_cast<quint32>(delta.size());
+    for (Splice const &splice: delta)
+        outStream << splice.offset << splice.removed << splice.inserted;
+    if (outStream.status() != QDataStream::Ok || !mFile.flush())
+        return false;
+    Metrics::instance().addBytesWritten(mFile.pos() - recordOffset);
+
+    Entry patched{entry.value()};
+    if (patched.patches.isEmpty())
+        patched.baseSize = patched.size;
+    patched.patches.push_back(patchOffset);
+    patched.size = static_cast<quint32>(size);
+    patched.modified = modified;
+    insertEntry(term, patched);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::writeRecord
+ * Appends a record with the definition of a term.
+ * The caller holds the lock.
+ * @param term the term name
+ * @param parts the pieces of the definition, in order
+ * @param modified the modification time, in milliseconds
+ * since the epoch
+ * @return whether the definition was stored
+ */
+bool PackedTermStore::writeRecord(QString const &term, Parts const &parts, qint64 modified)
+{
+    qint64 const recordOffset{mFile.size()};
+    if (!mFile.seek(recordOffset))
+        return false;
+
+    qint64 size{0};
+    for (QByteArray const &part: parts)
+        size += part.size();
+    if (size > std::numeric_limits<quint32>::max())
+        return false;
+
+    QByteArray const compressed{mCompression ? compress(parts, size) : QByteArray{}};
+    bool const isCompressed{!compressed.isEmpty()};
+    Parts const stored{isCompressed ? Parts{compressed} : parts};
+    qint64 const storedSize{isCompressed ? compressed.size() : size};
+
+    QDataStream outStream{&mFile};
+    outStream.setVersion(streamVersion);
+    outStream << static_cast<quint8>(isCompressed ? CompressedPut : Put) << term.toUtf8()
+              << modified << static_cast<quint32>(storedSize);
+    qint64 const offset{mFile.pos()};
+    for (QByteArray const &part: stored)
+        outStream.writeRawData(part.constData(), part.size());
+    if (outStream.status() != QDataStream::Ok || !mFile.flush())
+        return false;
+    Metrics::instance().addBytesWritten(mFile.pos() - recordOffset);
+
+    insertEntry(term, Entry{offset, static_cast<quint32>(storedSize), modified, 0, {}, isCompressed});
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::writeBatch
+ * Appends a record for each definition with a single
+ * write to the pack, which is how bulk imports avoid
+ * paying a flush per term. A term appearing twice
+ * keeps its last definition.
+ * @param terms the term names and their definitions
+ * @return whether every definition was stored
+ */
+bool PackedTermStore::writeBatch(QVector<Term> const &terms)
+{
+    qint64 const modified{QDateTime::currentMSecsSinceEpoch()};
+    QMutexLocker locker{&mMutex};
+    bool const compression{mCompression};
+    locker.unlock();
+
+    //Build the records in memory, compressing the definitions
+    //without holding up readers, and note where each one will
+    //land relative to the end of the pack
+    QByteArray records;
+    QVector<Entry> entries;
+    entries.reserve(terms.size());
+    {
+        QDataStream outStream{&records, QIODevice::WriteOnly};
+        outStream.setVersion(streamVersion);
+        for (Term const &term: terms)
+        {
+            QByteArray const compressed{compression ?
+                        compress(Parts{term.second}, term.second.size()) : QByteArray{}};
+            bool const isCompressed{!compressed.isEmpty()};
+            QByteArray const &stored{isCompressed ? compressed : term.second};
+            outStream << static_cast<quint8>(isCompressed ? CompressedPut : Put)
+                      << term.first.toUtf8() << modified << static_cast<quint32>(stored.size());
+            entries.push_back(Entry{outStream.device()->pos(), static_cast<quint32>(stored.size()),
+                                    modified, 0, {}, isCompressed});
+            outStream.writeRawData(stored.constData(), stored.size());
+        }
+    }
+
+    locker.relock();
+    qint64 const recordOffset{mFile.size()};
+    if (!mFile.seek(recordOffset))
+        return false;
+    for (Entry &entry: entries)
+        entry.offset += recordOffset;
+
+    if (mFile.write(records) != records.size() || !mFile.flush())
+        return false;
+    Metrics::instance().addBytesWritten(records.size());
+
+    for (int i = 0; i < terms.size(); i++)
+        insertEntry(terms[i].first, entries[i]);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::remove
+ * Appends a record removing a term.
+ * @param term the term name
+ * @return whether the term existed and was removed
+ */
+bool PackedTermStore::remove(QString const &term)
+{
+    QMutexLocker locker{&mMutex};
+
+    if (!mEntries.contains(term) || !mFile.seek(mFile.size()))
+        return false;
+
+    QDataStream outStream{&mFile};
+    outStream.setVersion(streamVersion);
+    outStream << static_cast<quint8>(Remove) << term.toUtf8();
+    if (outStream.status() != QDataStream::Ok || !mFile.flush())
+        return false;
+
+    removeEntry(term);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::rename
+ * Appends a record renaming a term. The definition
+ * itself is not copied.
+ * @param term the current term name
+ * @param newName the new term name
+ * @return whether the term existed and was renamed
+ */
+bool PackedTermStore::rename(QString const &term, QString const &newName)
+{
+    QMutexLocker locker{&mMutex};
+
+    if (!mEntries.contains(term) || newName == "")
+        return false;
+    if (term == newName)
+        return true;
+    if (!mFile.seek(mFile.size()))
+        return false;
+
+    Entry entry{mEntries.value(term)};
+    entry.modified = QDateTime::currentMSecsSinceEpoch();
+
+    QDataStream outStream{&mFile};
+    outStream.setVersion(streamVersion);
+    outStream << static_cast<quint8>(Rename) << term.toUtf8()
+              << newName.toUtf8() << entry.modified;
+    if (outStream.status() != QDataStream::Ok || !mFile.flush())
+        return false;
+
+    removeEntry(term);
+    insertEntry(newName, entry);
+    return true;
+}
+
+/**
+ * @brief PackedTermStore::indexSize
+ * @return the size of the index a compaction would write
+ */
+qint64 PackedTermStore::indexSize() const
+{
+    //Count, then length, name, offset, size, time and flags of every term
+    return 4 + mEntries.size() * (4 + 8 + 4 + 8 + 1) + mNameBytes;
+}
+
+/**
+ * @brief PackedTermStore::compactedSize
+ * @return the size of the pack right after a compaction
+ */
+qint64 PackedTermStore::compactedSize() const
+{
+    return headerSize + mLiveBytes + indexSize();
+}
+
+/**
+ * @brief PackedTermStore::maybeCompact
+ * Compacts the pack once superseded records take up
+ * more space than the live definitions.
+ */
+void PackedTermStore::maybeCompact()
+{
+    QMutexLocker locker{&mMutex};
+
+    qint64 const waste{mFile.size() - compactedSize()};
+    if (waste > minimumWaste && waste > compactedSize())
+        compactPack();
+}
+
+/**
+ * @brief PackedTermStore::compact
+ * Rewrites the pack with only the live definitions and
+ * a fresh index. The pack is replaced atomically, so a
+ * crash leaves either the old or the new pack.
+ * @return whether the pack was compacted
+ */
+bool PackedTermStore::compact()
+{
+    QMutexLocker locker{&mMutex};
+    return compactPack();
+}
+
+/**
+ * @brief PackedTermStore::compactPack
+ * Compacts the pack, the caller holds the lock.
+ * @return whether the pack was compacted
+ */
+bool PackedTermStore::compactPack()
+{
+    QStringList const names{sortedTerms()};
+
+    QSaveFile pack{mPath};
+    if (!pack.open(QIODevice::WriteOnly))
+        return false;
+
+    //The offsets in the header are only known once the blob is
+    //written, since definitions may be compressed or expanded
+    QDataStream outStream{&pack};
+    outStream.setVersion(streamVersion);
+    outStream.writeRawData(packMagic, 4);
+    outStream << packVersion << qint64{0} << qint64{0};
+
+    //Copy the live definitions into the blob, folding in their
+    //patches, and compress or expand those whose compression
+    //does not match the current choice
+    QHash<QString, Entry> entries;
+    entries.reserve(names.size());
+    qint64 offset{headerSize};
+    qint64 liveBytes{0};
+    for (QString const &name: names)
+    {
+        Entry const entry{mEntries.value(name)};
+        QByteArray contents;
+        bool compressed{entry.compressed};
+        bool const copied{entry.patches.isEmpty() && entry.compressed == mCompression};
+        if (copied ? !viewRecord(entry.offset, entry.size, contents, true) :
+                     !viewEntry(entry, contents, true))
+        {
+            pack.cancelWriting();
+            return false;
+        }
+        if (!copied)
+        {
+            QByteArray const packed{mCompression ? compress(Parts{contents}, contents.size()) :
+                                                   QByteArray{}};
+            compressed = !packed.isEmpty();
+            if (compressed)
+                contents = packed;
+        }
+        outStream.writeRawData(contents.constData(), contents.size());
+
+        entries.insert(name, Entry{offset, static_cast<quint32>(contents.size()), entry.modified,
+                                   0, {}, compressed});
+        offset += contents.size();
+        liveBytes += contents.size();
+    }
+
+    //Write the index after the blob
+    qint64 const indexOffset{offset};
+    outStream << static_cast<quint32>(names.size());
+    for (QString const &name: names)
+    {
+        Entry const &entry{entries[name]};
+        outStream << name.toUtf8() << entry.offset << entry.size << entry.modified
+                  << static_cast<quint8>(entry.compressed ? compressedFlag : 0);
+    }
+    qint64 const tailOffset{pack.pos()};
+    if (!pack.seek(4 + 4))
+    {
+        pack.cancelWriting();
+        return false;
+    }
+    outStream << indexOffset << tailOffset;
+
+    if (outStream.status() != QDataStream::Ok)
+    {
+        pack.cancelWriting();
+        return false;
+    }
+
+    //Release the old pack so that it can be replaced
+    qint64 const written{tailOffset};
+    unmap();
+    mFile.close();
+    bool const committed{pack.commit()};
+    if (committed)
+    {
+        mEntries = entries;
+        mLiveBytes = liveBytes;
+        Metrics::instance().addBytesWritten(written);
+    }
+    return mFile.open(QIODevice::ReadWrite) && committed;
+}
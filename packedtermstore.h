@@ -0,0 +1,120 @@
+#ifndef PACKEDTERMSTORE_H
+#define PACKEDTERMSTORE_H
+
+#include "termstore.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+class QDataStream;
+
+class PackedTermStore : public TermStore
+{
+public:
+    explicit PackedTermStore(QString const &path);
+    ~PackedTermStore() override;
+
+    bool open();
+
+    QStringList terms() const override;
+
+    bool contains(QString const &term) const override;
+
+    int count() const;
+
+    qint64 modified(QString const &term) const;
+
+    bool changedOnDisk() const;
+
+    void setCompression(bool enabled) override;
+
+    bool read(QString const &term, QByteArray &contents) override;
+
+    bool view(QString const &term, QByteArray &contents) override;
+
+    bool write(QString const &term, QByteArray const &contents) override;
+
+    bool write(QString const &term, QByteArray const &contents, qint64 modified);
+
+    bool writeParts(QString const &term, Parts const &parts) override;
+
+    bool writeDelta(QString const &term, Delta const &delta, Parts const &parts) override;
+
+    bool writeBatch(QVector<Term> const &terms) override;
+
+    bool remove(QString const &term) override;
+
+    bool rename(QString const &term, QString const &newName) override;
+
+    void maybeCompact() override;
+
+    bool compact() override;
+
+private:
+    struct Entry
+    {
+        qint64 offset;
+        quint32 size;
+        qint64 modified;
+        //The size of the definition at offset, and the patch
+        //records applied to it, oldest first
+        quint32 baseSize;
+        QVector<qint64> patches;
+        //Whether the definition at offset is compressed
+        bool compressed;
+    };
+
+    enum Operation : quint8
+    {
+        Put = 1,
+        Remove = 2,
+        Rename = 3,
+        Patch = 4,
+        CompressedPut = 5
+    };
+
+    bool create();
+
+    bool writeRecord(QString const &term, Parts const &parts, qint64 modified);
+
+    QStringList sortedTerms() const;
+
+    bool viewEntry(Entry const &entry, QByteArray &contents, bool remapAllowed);
+
+    bool viewRecord(qint64 offset, quint32 storedSize, QByteArray &contents, bool remapAllowed);
+
+    bool applyPatch(qint64 offset, QByteArray &contents);
+
+    bool compactPack();
+
+    bool map(qint64 end);
+
+    void unmap();
+
+    bool readIndex(QDataStream &inStream, qint64 indexOffset, quint32 version);
+
+    void replayTail(QDataStream &inStream, qint64 tailOffset);
+
+    void insertEntry(QString const &term, Entry const &entry);
+
+    void removeEntry(QString const &term);
+
+    qint64 indexSize() const;
+
+    qint64 compactedSize() const;
+
+    QString const mPath;
+    mutable QMutex mMutex;
+    QFile mFile;
+    uchar *mMap;
+    qint64 mMappedSize;
+    QHash<QString, Entry> mEntries;
+    qint64 mLiveBytes;
+    qint64 mNameBytes;
+    bool mCompression;
+    //The term names sorted ignoring case, while mSorted is set
+    mutable QStringList mSortedTerms;
+    mutable bool mSorted;
+};
+
+#endif // PACKEDTERMSTORE_H
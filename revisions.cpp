@@ -0,0 +1,104 @@
+#include "revisions.h"
+#include "ui_revisions.h"
+
+#include <QDateTime>
+
+/**
+ * @brief Revisions::Revisions
+ * Lists the revisions of a term, newest first, with how
+ * much each one changed from the one before it. The sizes
+ * come from the chunk lists, so nothing is read until a
+ * revision is picked.
+ * @param store the revision store of the dictionary
+ * @param term the term name
+ * @param parent
+ */
+Revisions::Revisions(QSharedPointer<RevisionStore> const &store, QString const &term,
+                     QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::Revisions),
+    mStore{store},
+    mRevisions{store->revisions(term)}
+{
+    ui->setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    for (int i = mRevisions.size() - 1; i >= 0; i--)
+    {
+        RevisionStore::Revision const &revision{mRevisions[i]};
+        QString text{QDateTime::fromMSecsSinceEpoch(revision.saved).toString("yyyy-MM-dd hh:mm:ss") +
+                     "  " + QString::number(revision.size) + " bytes"};
+        if (i > 0)
+            text += ", " + QString::number(mStore->changedSize(mRevisions[i - 1], revision)) +
+                    " changed";
+        ui->listWidgetRevisions->addItem(text);
+    }
+    ui->pushButtonCompare->setEnabled(false);
+    ui->pushButtonRestore->setEnabled(false);
+    ui->listWidgetRevisions->setCurrentRow(0);
+}
+
+Revisions::~Revisions()
+{
+    delete ui;
+}
+
+/**
+ * @brief Revisions::selectedRevision
+ * @return the index in mRevisions of the selected
+ * revision, or -1 if none is selected
+ */
+int Revisions::selectedRevision() const
+{
+    int const row{ui->listWidgetRevisions->currentRow()};
+    return row < 0 ? -1 : mRevisions.size() - 1 - row;
+}
+
+/**
+ * @brief Revisions::on_listWidgetRevisions_currentRowChanged
+ * Shows the selected revision.
+ * @param row the selected row
+ */
+void Revisions::on_listWidgetRevisions_currentRowChanged(int row)
+{
+    Q_UNUSED(row)
+    int const index{selectedRevision()};
+    QByteArray contents;
+    bool const read{index >= 0 && mStore->contents(mRevisions[index], contents)};
+    ui->plainTextEditPreview->setPlainText(read ? QString::fromUtf8(contents) :
+                                                  QString{"The revision could not be read."});
+    ui->pushButtonCompare->setEnabled(read && index > 0);
+    ui->pushButtonRestore->setEnabled(read);
+}
+
+/**
+ * @brief Revisions::on_pushButtonCompare_clicked
+ * Shows what the selected revision changed from the one
+ * before it. Only the chunks that differ are read.
+ */
+void Revisions::on_pushButtonCompare_clicked()
+{
+    int const index{selectedRevision()};
+    RevisionStore::Change change;
+    if (index <= 0 || !mStore->compare(mRevisions[index - 1], mRevisions[index], change))
+        return;
+
+    ui->plainTextEditPreview->setPlainText("At byte " + QString::number(change.offset) +
+                                           "\n\nRemoved:\n" + QString::fromUtf8(change.removed) +
+                                           "\n\nInserted:\n" + QString::fromUtf8(change.inserted));
+}
+
+/**
+ * @brief Revisions::on_pushButtonRestore_clicked
+ * Relays the selected revision, to replace the definition.
+ */
+void Revisions::on_pushButtonRestore_clicked()
+{
+    int const index{selectedRevision()};
+    QByteArray contents;
+    if (index < 0 || !mStore->contents(mRevisions[index], contents))
+        return;
+
+    emit restoreRevision(contents);
+    close();
+}
@@ -0,0 +1,42 @@
+#ifndef REVISIONS_H
+#define REVISIONS_H
+
+#include <QDialog>
+#include <QSharedPointer>
+#include <QVector>
+#include "revisionstore.h"
+
+namespace Ui {
+class Revisions;
+}
+
+class Revisions : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit Revisions(QSharedPointer<RevisionStore> const &store, QString const &term,
+                       QWidget *parent = nullptr);
+    ~Revisions();
+
+signals:
+    //Do not implement signals
+    void restoreRevision(QByteArray);
+
+private slots:
+    void on_listWidgetRevisions_currentRowChanged(int row);
+
+    void on_pushButtonCompare_clicked();
+
+    void on_pushButtonRestore_clicked();
+
+private:
+    int selectedRevision() const;
+
+    Ui::Revisions *ui;
+    QSharedPointer<RevisionStore> mStore;
+    //Oldest first, while the list shows the newest first
+    QVector<RevisionStore::Revision> mRevisions;
+};
+
+#endif // REVISIONS_H
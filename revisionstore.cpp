@@ -0,0 +1,641 @@
+#include "revisionstore.h"
+#include "metrics.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <cstring>
+
+/* Revision files, in the revisions folder of a dictionary:
+ *
+ * chunks.dat     "NSRC", version, then records of hash,
+ *                size and the bytes of a chunk
+ * revisions.log  "NSRV", version, then records naming a
+ *                lineage or listing the chunks of a revision
+ *
+ * A definition is cut into chunks where the content says
+ * so, not at fixed offsets, so an edit only changes the
+ * chunks around it and the others are shared with earlier
+ * revisions. Every chunk is stored once, keyed by the SHA-1
+ * of its bytes. Both files are only appended to, until they
+ * are compacted.
+ *
+ * Revisions belong to a lineage rather than to a name, so
+ * renaming a term keeps its revisions.
+ *
+ * Only the latest revisions of a term are kept. Older ones
+ * are forgotten at once, and the files are rewritten without
+ * them, and without the chunks no longer used, once enough
+ * have piled up.
+ */
+char const chunksMagic[4]{'N', 'S', 'R', 'C'};
+char const logMagic[4]{'N', 'S', 'R', 'V'};
+quint32 const revisionsVersion{1};
+QDataStream::Version const streamVersion{QDataStream::Qt_5_0};
+
+//Chunks are cut where the rolling hash has its top bits
+//clear, once they reach the minimum size; thirteen bits
+//make chunks of about 8KB
+int const minChunkSize{2 * 1024};
+int const maxChunkSize{64 * 1024};
+quint64 const boundaryMask{0xFFF8000000000000ULL};
+
+//Revisions kept for every term
+int const maxRevisions{50};
+
+//Forgotten revisions that make the files worth rewriting
+int const compactionThreshold{256};
+
+/**
+ * @brief makeGearTable
+ * @return the value mixed into the rolling hash for every
+ * byte value. They are fixed pseudo-random numbers, so the
+ * same text is always cut at the same places.
+ */
+static QVector<quint64> makeGearTable()
+{
+    QVector<quint64> table(256);
+    quint64 state{0};
+    for (quint64 &value: table)
+    {
+        //splitmix64
+        quint64 z{state += 0x9E3779B97F4A7C15ULL};
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+/**
+ * @brief RevisionStore::RevisionStore
+ * Creates the revision store of a dictionary. It keeps
+ * the definitions saved over time, sharing the unchanged
+ * parts between revisions, so a revision costs about as
+ * much as what changed. Call open() before using it.
+ * @param folder the folder of the revision files
+ */
+RevisionStore::RevisionStore(QString const &folder) :
+    mFolder{folder},
+    mChunkFile{QDir{folder}.filePath("chunks.dat")},
+    mLog{QDir{folder}.filePath("revisions.log")},
+    mNextLineage{1},
+    mDropped{0}
+{
+}
+
+/**
+ * @brief RevisionStore::open
+ * Opens the revision files, creating them if needed, and
+ * reads the chunk index and the revisions into memory. The
+ * bytes of the chunks are only read when needed.
+ * @return whether the files could be opened
+ */
+bool RevisionStore::open()
+{
+    QMutexLocker locker{&mMutex};
+    if (!QDir{}.mkpath(mFolder) || !openFile(mChunkFile, chunksMagic) ||
+            !openFile(mLog, logMagic))
+        return false;
+
+    readChunks();
+    readLog();
+    for (QVector<Revision> &revisions: mRevisions)
+        prune(revisions);
+    if (mDropped >= compactionThreshold)
+        compactFiles();
+    return true;
+}
+
+/**
+ * @brief RevisionStore::openFile
+ * Opens one of the revision files and checks its header,
+ * writing one if the file is new.
+ * @param file the file
+ * @param magic the four bytes it starts with
+ * @return whether the file is open after its header
+ */
+bool RevisionStore::openFile(QFile &file, char const *magic)
+{
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    QDataStream stream{&file};
+    stream.setVersion(streamVersion);
+    if (file.size() == 0)
+    {
+        stream.writeRawData(magic, 4);
+        stream << revisionsVersion;
+        return stream.status() == QDataStream::Ok && file.flush();
+    }
+
+    char header[4];
+    quint32 version{0};
+    if (stream.readRawData(header, 4) != 4 || std::memcmp(header, magic, 4) != 0)
+        return false;
+    stream >> version;
+    return stream.status() == QDataStream::Ok && version == revisionsVersion;
+}
+
+/**
+ * @brief RevisionStore::readChunks
+ * Indexes the chunks by hash, skipping over their bytes.
+ * A record cut short is dropped.
+ */
+void RevisionStore::readChunks()
+{
+    QDataStream inStream{&mChunkFile};
+    inStream.setVersion(streamVersion);
+    while (!mChunkFile.atEnd())
+    {
+        qint64 const recordStart{mChunkFile.pos()};
+        QByteArray hash;
+        Chunk chunk{0, 0};
+        inStream >> hash >> chunk.size;
+        chunk.offset = mChunkFile.pos();
+        if (inStream.skipRawData(static_cast<int>(chunk.size)) != static_cast<int>(chunk.size))
+            inStream.setStatus(QDataStream::ReadPastEnd);
+
+        if (inStream.status() != QDataStream::Ok)
+        {
+            mChunkFile.resize(recordStart);
+            return;
+        }
+        mChunks.insert(hash, chunk);
+    }
+}
+
+/**
+ * @brief RevisionStore::readLog
+ * Reads the lineages and revisions. A record cut short is
+ * dropped, as is a revision naming a chunk that was lost.
+ */
+void RevisionStore::readLog()
+{
+    QDataStream inStream{&mLog};
+    inStream.setVersion(streamVersion);
+    while (!mLog.atEnd())
+    {
+        qint64 const recordStart{mLog.pos()};
+        quint8 operation{0};
+        quint32 lineage{0};
+        QByteArray name;
+        Revision revision{0, 0, {}};
+        inStream >> operation;
+        if (operation == Name)
+            inStream >> name >> lineage;
+        else if (operation == Snapshot)
+        {
+            quint32 count{0};
+            inStream >> lineage >> revision.saved >> revision.size >> count;
+            for (quint32 i = 0; i < count && inStream.status() == QDataStream::Ok; i++)
+            {
+                QByteArray hash;
+                inStream >> hash;
+                revision.chunks.push_back(hash);
+            }
+        }
+        else
+            inStream.setStatus(QDataStream::ReadCorruptData);
+
+        if (inStream.status() != QDataStream::Ok)
+        {
+            mLog.resize(recordStart);
+            return;
+        }
+
+        mNextLineage = qMax(mNextLineage, lineage + 1);
+        if (operation == Name && lineage == 0)
+            mLineages.remove(QString::fromUtf8(name));
+        else if (operation == Name)
+            mLineages.insert(QString::fromUtf8(name), lineage);
+        else
+        {
+            bool complete{true};
+            for (QByteArray const &hash: revision.chunks)
+                complete = complete && mChunks.contains(hash);
+            if (complete)
+                mRevisions[lineage].push_back(revision);
+        }
+    }
+}
+
+/**
+ * @brief RevisionStore::split
+ * Cuts a definition into chunks with a rolling hash over
+ * its bytes, so that cuts depend only on the bytes right
+ * before them. The parts are walked as they are, without
+ * joining them.
+ * @param parts the definition
+ * @return the chunks, in order; an empty definition is a
+ * single empty chunk
+ */
+QVector<QByteArray> RevisionStore::split(TermStore::Parts const &parts)
+{
+    static QVector<quint64> const gearTable{makeGearTable()};
+    quint64 const *gear{gearTable.constData()};
+
+    QVector<QByteArray> chunks;
+    QByteArray chunk;
+    quint64 hash{0};
+    for (QByteArray const &part: parts)
+    {
+        char const *data{part.constData()};
+        int start{0};
+        for (int i = 0; i < part.size(); i++)
+        {
+            hash = (hash << 1) + gear[static_cast<uchar>(data[i])];
+            int const size{chunk.size() + i + 1 - start};
+            if (size >= maxChunkSize || (size >= minChunkSize && (hash & boundaryMask) == 0))
+            {
+                chunk.append(data + start, i + 1 - start);
+                chunks.push_back(chunk);
+                chunk.clear();
+                start = i + 1;
+                hash = 0;
+            }
+        }
+        chunk.append(data + start, part.size() - start);
+    }
+    if (!chunk.isEmpty() || chunks.isEmpty())
+        chunks.push_back(chunk);
+    return chunks;
+}
+
+/**
+ * @brief RevisionStore::appendName
+ * Writes the lineage of a term name. The caller holds the lock.
+ * @param term the term name
+ * @param lineage the lineage, or 0 to forget the name
+ * @return whether the record was written
+ */
+bool RevisionStore::appendName(QString const &term, quint32 lineage)
+{
+    if (!mLog.seek(mLog.size()))
+        return false;
+
+    QDataStream outStream{&mLog};
+    outStream.setVersion(streamVersion);
+    outStream << static_cast<quint8>(Name) << term.toUtf8() << lineage;
+    if (outStream.status() != QDataStream::Ok || !mLog.flush())
+        return false;
+
+    if (lineage == 0)
+        mLineages.remove(term);
+    else
+        mLineages.insert(term, lineage);
+    return true;
+}
+
+/**
+ * @brief RevisionStore::record
+ * Adds a revision of a definition. It is cut into chunks
+ * and hashed before taking the lock, and only chunks not
+ * stored yet are written, so the cost follows what changed
+ * rather than the size of the definition. Saving the same
+ * definition again adds nothing.
+ * @param term the term name
+ * @param parts the definition
+ * @return whether the revision was stored
+ */
+bool RevisionStore::record(QString const &term, TermStore::Parts const &parts)
+{
+    ScopedTimer const timer{Metrics::RevisionStoreRecord};
+    QVector<QByteArray> const chunks{split(parts)};
+    Revision revision{QDateTime::currentMSecsSinceEpoch(), 0, {}};
+    revision.chunks.reserve(chunks.size());
+    for (QByteArray const &chunk: chunks)
+    {
+        revision.chunks.push_back(QCryptographicHash::hash(chunk, QCryptographicHash::Sha1));
+        revision.size += static_cast<quint32>(chunk.size());
+    }
+
+    QMutexLocker locker{&mMutex};
+    quint32 lineage{mLineages.value(term)};
+    if (lineage == 0)
+    {
+        lineage = mNextLineage++;
+        if (!appendName(term, lineage))
+            return false;
+    }
+    QVector<Revision> const &revisions{mRevisions[lineage]};
+    if (!revisions.isEmpty() && revisions.last().chunks == revision.chunks)
+        return true;
+
+    //The new chunks go in a single write, the revision after
+    //them, so a revision never names a chunk not on disk
+    qint64 const chunksOffset{mChunkFile.size()};
+    QByteArray records;
+    QHash<QByteArray, Chunk> added;
+    QDataStream outStream{&records, QIODevice::WriteOnly};
+    outStream.setVersion(streamVersion);
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        QByteArray const &hash{revision.chunks[i]};
+        if (mChunks.contains(hash) || added.contains(hash))
+            continue;
+        outStream << hash << static_cast<quint32>(chunks[i].size());
+        added.insert(hash, Chunk{chunksOffset + outStream.device()->pos(),
+                                 static_cast<quint32>(chunks[i].size())});
+        outStream.writeRawData(chunks[i].constData(), chunks[i].size());
+    }
+    if (!records.isEmpty())
+    {
+        if (!mChunkFile.seek(chunksOffset) || mChunkFile.write(records) != records.size() ||
+                !mChunkFile.flush())
+            return false;
+        for (auto chunk = added.constBegin(); chunk != added.constEnd(); ++chunk)
+            mChunks.insert(chunk.key(), chunk.value());
+    }
+
+    if (!mLog.seek(mLog.size()))
+        return false;
+    qint64 const logOffset{mLog.pos()};
+    QDataStream logStream{&mLog};
+    logStream.setVersion(streamVersion);
+    logStream << static_cast<quint8>(Snapshot) << lineage << revision.saved << revision.size
+              << static_cast<quint32>(revision.chunks.size());
+    for (QByteArray const &hash: revision.chunks)
+        logStream << hash;
+    if (logStream.status() != QDataStream::Ok || !mLog.flush())
+        return false;
+    Metrics::instance().addBytesWritten(records.size() + mLog.pos() - logOffset);
+
+    QVector<Revision> &revisions{mRevisions[lineage]};
+    revisions.push_back(revision);
+    prune(revisions);
+    if (mDropped >= compactionThreshold)
+        compactFiles();
+    return true;
+}
+
+/**
+ * @brief RevisionStore::prune
+ * Forgets the oldest revisions of a term beyond those kept.
+ * The caller holds the lock.
+ * @param revisions the revisions of the term, oldest first
+ */
+void RevisionStore::prune(QVector<Revision> &revisions)
+{
+    int const excess{revisions.size() - maxRevisions};
+    if (excess <= 0)
+        return;
+    revisions.remove(0, excess);
+    mDropped += excess;
+}
+
+/**
+ * @brief RevisionStore::compactFiles
+ * Rewrites both files with only the names, the revisions
+ * kept and the chunks they use. Each file is replaced
+ * atomically; a crash between the two leaves revisions
+ * naming lost chunks, which are dropped when read, or
+ * chunks no revision uses, which only take space. The
+ * caller holds the lock.
+ * @return whether the files were rewritten
+ */
+bool RevisionStore::compactFiles()
+{
+    ScopedTimer const timer{Metrics::RevisionStoreCompactFiles};
+    //A failed compaction is only tried again once as many
+    //more revisions have been forgotten
+    mDropped = 0;
+    QSaveFile chunkFile{mChunkFile.fileName()};
+    QSaveFile log{mLog.fileName()};
+    if (!chunkFile.open(QIODevice::WriteOnly) || !log.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream chunkStream{&chunkFile};
+    chunkStream.setVersion(streamVersion);
+    chunkStream.writeRawData(chunksMagic, 4);
+    chunkStream << revisionsVersion;
+    QDataStream logStream{&log};
+    logStream.setVersion(streamVersion);
+    logStream.writeRawData(logMagic, 4);
+    logStream << revisionsVersion;
+
+    //Lineages no name leads to any more are dropped
+    QSet<quint32> named;
+    for (auto name = mLineages.constBegin(); name != mLineages.constEnd(); ++name)
+    {
+        logStream << static_cast<quint8>(Name) << name.key().toUtf8() << name.value();
+        named.insert(name.value());
+    }
+
+    QHash<QByteArray, Chunk> chunks;
+    QHash<quint32, QVector<Revision>> kept;
+    for (auto lineage = mRevisions.constBegin(); lineage != mRevisions.constEnd(); ++lineage)
+    {
+        if (!named.contains(lineage.key()))
+            continue;
+        for (Revision const &revision: lineage.value())
+        {
+            for (QByteArray const &hash: revision.chunks)
+            {
+                if (chunks.contains(hash))
+                    continue;
+                QByteArray bytes;
+                if (!readChunk(hash, bytes))
+                {
+                    chunkFile.cancelWriting();
+                    log.cancelWriting();
+                    return false;
+                }
+                chunkStream << hash << static_cast<quint32>(bytes.size());
+                chunks.insert(hash, Chunk{chunkFile.pos(), static_cast<quint32>(bytes.size())});
+                chunkStream.writeRawData(bytes.constData(), bytes.size());
+            }
+            logStream << static_cast<quint8>(Snapshot) << lineage.key() << revision.saved
+                      << revision.size << static_cast<quint32>(revision.chunks.size());
+            for (QByteArray const &hash: revision.chunks)
+                logStream << hash;
+        }
+        kept.insert(lineage.key(), lineage.value());
+    }
+
+    if (chunkStream.status() != QDataStream::Ok || logStream.status() != QDataStream::Ok)
+    {
+        chunkFile.cancelWriting();
+        log.cancelWriting();
+        return false;
+    }
+
+    //Release the old files so that they can be replaced
+    mChunkFile.close();
+    mLog.close();
+    bool const committed{chunkFile.commit() && log.commit()};
+    if (!mChunkFile.open(QIODevice::ReadWrite) || !mLog.open(QIODevice::ReadWrite))
+        return false;
+    if (!committed)
+    {
+        //The chunk file may have been replaced already
+        mChunks.clear();
+        mChunkFile.seek(4 + 4);
+        readChunks();
+        return false;
+    }
+
+    mChunks = chunks;
+    mRevisions = kept;
+    return true;
+}
+
+/**
+ * @brief RevisionStore::rename
+ * Moves the revisions of a term to its new name. Only the
+ * name is written; the revisions stay where they are.
+ * @param term the term name
+ * @param newName the new term name
+ * @return whether the revisions were moved, or the term
+ * has none
+ */
+bool RevisionStore::rename(QString const &term, QString const &newName)
+{
+    QMutexLocker locker{&mMutex};
+    quint32 const lineage{mLineages.value(term)};
+    if (lineage == 0 || term == newName)
+        return true;
+    return appendName(newName, lineage) && appendName(term, 0);
+}
+
+/**
+ * @brief RevisionStore::hasRevisions
+ * @param term the term name
+ * @return whether any revision of the term is stored
+ */
+bool RevisionStore::hasRevisions(QString const &term) const
+{
+    QMutexLocker locker{&mMutex};
+    return !mRevisions.value(mLineages.value(term)).isEmpty();
+}
+
+/**
+ * @brief RevisionStore::revisions
+ * @param term the term name
+ * @return the revisions of the term, oldest first
+ */
+QVector<RevisionStore::Revision> RevisionStore::revisions(QString const &term) const
+{
+    QMutexLocker locker{&mMutex};
+    return mRevisions.value(mLineages.value(term));
+}
+
+/**
+ * @brief RevisionStore::readChunk
+ * Reads the bytes of a chunk. The caller holds the lock.
+ * @param hash the hash of the chunk
+ * @param contents the chunk is appended to it
+ * @return whether the chunk could be read
+ */
+bool RevisionStore::readChunk(QByteArray const &hash, QByteArray &contents)
+{
+    auto const chunk = mChunks.constFind(hash);
+    if (chunk == mChunks.constEnd() || !mChunkFile.seek(chunk.value().offset))
+        return false;
+
+    int const start{contents.size()};
+    int const size{static_cast<int>(chunk.value().size)};
+    contents.resize(start + size);
+    if (mChunkFile.read(contents.data() + start, size) != size)
+        return false;
+    Metrics::instance().addBytesRead(size);
+    return true;
+}
+
+/**
+ * @brief RevisionStore::contents
+ * Reads a revision back. Only the chunks of that revision
+ * are read, however many revisions came before it.
+ * @param revision the revision
+ * @param contents set to the UTF-8 encoded definition
+ * @return whether the revision could be read
+ */
+bool RevisionStore::contents(Revision const &revision, QByteArray &contents)
+{
+    QMutexLocker locker{&mMutex};
+    contents.clear();
+    contents.reserve(static_cast<int>(revision.size));
+    for (QByteArray const &hash: revision.chunks)
+        if (!readChunk(hash, contents))
+            return false;
+    return true;
+}
+
+/**
+ * @brief RevisionStore::commonChunks
+ * Counts the chunks two revisions start and end with in
+ * common, the suffix not overlapping the prefix.
+ * @param from the older revision
+ * @param to the newer revision
+ * @param prefix set to the number of leading chunks in common
+ * @param suffix set to the number of trailing chunks in common
+ */
+void RevisionStore::commonChunks(Revision const &from, Revision const &to, int &prefix, int &suffix)
+{
+    int const shorter{qMin(from.chunks.size(), to.chunks.size())};
+    prefix = 0;
+    while (prefix < shorter && from.chunks[prefix] == to.chunks[prefix])
+        prefix++;
+    suffix = 0;
+    while (suffix < shorter - prefix &&
+           from.chunks[from.chunks.size() - 1 - suffix] == to.chunks[to.chunks.size() - 1 - suffix])
+        suffix++;
+}
+
+/**
+ * @brief RevisionStore::changedSize
+ * Measures how much changed between two revisions from
+ * the sizes of their chunks, without reading any of them.
+ * @param from the older revision
+ * @param to the newer revision
+ * @return the bytes removed plus the bytes inserted, as
+ * whole chunks
+ */
+quint32 RevisionStore::changedSize(Revision const &from, Revision const &to) const
+{
+    int prefix{0};
+    int suffix{0};
+    commonChunks(from, to, prefix, suffix);
+
+    QMutexLocker locker{&mMutex};
+    quint32 size{0};
+    for (int i = prefix; i < from.chunks.size() - suffix; i++)
+        size += mChunks.value(from.chunks[i]).size;
+    for (int i = prefix; i < to.chunks.size() - suffix; i++)
+        size += mChunks.value(to.chunks[i]).size;
+    return size;
+}
+
+/**
+ * @brief RevisionStore::compare
+ * Finds where two revisions differ. The chunks they start
+ * and end with in common are skipped unread, and only the
+ * chunks in between are read.
+ * @param from the older revision
+ * @param to the newer revision
+ * @param change set to the bytes of the older revision that
+ * the newer one replaces, and what it replaces them with
+ * @return whether the chunks could be read
+ */
+bool RevisionStore::compare(Revision const &from, Revision const &to, Change &change)
+{
+    int prefix{0};
+    int suffix{0};
+    commonChunks(from, to, prefix, suffix);
+
+    QMutexLocker locker{&mMutex};
+    change = Change{0, {}, {}};
+    for (int i = 0; i < prefix; i++)
+        change.offset += mChunks.value(from.chunks[i]).size;
+    for (int i = prefix; i < from.chunks.size() - suffix; i++)
+        if (!readChunk(from.chunks[i], change.removed))
+            return false;
+    for (int i = prefix; i < to.chunks.size() - suffix; i++)
+        if (!readChunk(to.chunks[i], change.inserted))
+            return false;
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef REVISIONSTORE_H
+#define REVISIONSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QFile>
+#include <QMutex>
+#include "termstore.h"
+
+class RevisionStore
+{
+public:
+    struct Revision
+    {
+        qint64 saved;
+        quint32 size;
+        //The hashes of the chunks making up the definition
+        QVector<QByteArray> chunks;
+    };
+
+    //Where two revisions differ; the rest of them is the same
+    struct Change
+    {
+        quint32 offset;
+        QByteArray removed;
+        QByteArray inserted;
+    };
+
+    explicit RevisionStore(QString const &folder);
+
+    bool open();
+
+    bool record(QString const &term, TermStore::Parts const &parts);
+
+    bool rename(QString const &term, QString const &newName);
+
+    bool hasRevisions(QString const &term) const;
+
+    QVector<Revision> revisions(QString const &term) const;
+
+    bool contents(Revision const &revision, QByteArray &contents);
+
+    bool compare(Revision const &from, Revision const &to, Change &change);
+
+    quint32 changedSize(Revision const &from, Revision const &to) const;
+
+private:
+    struct Chunk
+    {
+        qint64 offset;
+        quint32 size;
+    };
+
+    enum Operation : quint8
+    {
+        Name = 1,
+        Snapshot = 2
+    };
+
+    static QVector<QByteArray> split(TermStore::Parts const &parts);
+
+    static void commonChunks(Revision const &from, Revision const &to, int &prefix, int &suffix);
+
+    bool openFile(QFile &file, char const *magic);
+
+    void readChunks();
+
+    void readLog();
+
+    bool readChunk(QByteArray const &hash, QByteArray &contents);
+
+    bool appendName(QString const &term, quint32 lineage);
+
+    void prune(QVector<Revision> &revisions);
+
+    bool compactFiles();
+
+    QString const mFolder;
+    mutable QMutex mMutex;
+    QFile mChunkFile;
+    QFile mLog;
+    QHash<QByteArray, Chunk> mChunks;
+    //Terms keep their lineage, and so their revisions, when renamed
+    QHash<QString, quint32> mLineages;
+    QHash<quint32, QVector<Revision>> mRevisions;
+    quint32 mNextLineage;
+    //Revisions dropped by pruning that the files still hold
+    int mDropped;
+};
+
+#endif // REVISIONSTORE_H
@@ -0,0 +1,171 @@
+#include "saveengine.h"
+#include "storage.h"
+#include "termstore.h"
+#include "revisionstore.h"
+#include "metrics.h"
+
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+/**
+ * @brief SaveEngine::SaveEngine
+ * Creates an engine that writes definitions on a worker
+ * thread, so that saving never holds up the interface.
+ * @param storage the storage holding the dictionaries
+ * @param parent
+ */
+SaveEngine::SaveEngine(Storage *storage, QObject *parent) :
+    QObject{parent},
+    mStorage{storage},
+    mRunning{false}
+{
+}
+
+/**
+ * @brief SaveEngine::~SaveEngine
+ * Writes every pending save before going away.
+ */
+SaveEngine::~SaveEngine()
+{
+    flush();
+}
+
+/**
+ * @brief SaveEngine::save
+ * Queues a definition to be written. A definition still
+ * waiting to be written for the same term is replaced, so
+ * only the latest one reaches the disk.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param contents the UTF-8 encoded definition
+ */
+void SaveEngine::save(QString const &dictionary, QString const &term,
+                      QByteArray const &contents)
+{
+    save(dictionary, term, TermStore::Parts{contents});
+}
+
+/**
+ * @brief SaveEngine::save
+ * Queues a definition given in pieces, which are written
+ * as they are without joining them. When the changes made
+ * to the previous definition are given, only they are
+ * written, which saves rewriting a large definition after
+ * a small edit.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param parts the pieces of the UTF-8 encoded definition
+ * @param delta the changes made to the previous definition,
+ * or none to write the whole definition
+ */
+void SaveEngine::save(QString const &dictionary, QString const &term,
+                      TermStore::Parts const &parts, TermStore::Delta const &delta)
+{
+    Key const key{dictionary, term};
+
+    QMutexLocker locker{&mMutex};
+    //A replaced save never reaches the disk, so the new delta
+    //only applies after the one it replaces; after a whole
+    //definition, the new one is written whole too
+    auto const previous = mPending.constFind(key);
+    if (previous == mPending.constEnd() || delta.isEmpty())
+        mPending.insert(key, Save{parts, delta});
+    else if (previous.value().delta.isEmpty())
+        mPending.insert(key, Save{parts, TermStore::Delta{}});
+    else
+        mPending.insert(key, Save{parts, previous.value().delta + delta});
+    if (!mRunning)
+    {
+        mRunning = true;
+        QtConcurrent::run(this, &SaveEngine::run);
+    }
+}
+
+/**
+ * @brief SaveEngine::pending
+ * Finds a definition that has been saved but may not have
+ * reached the disk yet, so that it can be shown instead of
+ * the one stored in the dictionary.
+ * @param dictionary the dictionary of the term
+ * @param term the term name
+ * @param contents set to the latest definition, if any
+ * @return whether a save of the term is pending
+ */
+bool SaveEngine::pending(QString const &dictionary, QString const &term,
+                         QByteArray &contents) const
+{
+    Key const key{dictionary, term};
+
+    QMutexLocker locker{&mMutex};
+    auto pendingSave = mPending.constFind(key);
+    if (pendingSave == mPending.constEnd())
+    {
+        pendingSave = mWriting.constFind(key);
+        if (pendingSave == mWriting.constEnd())
+            return false;
+    }
+    contents.clear();
+    for (QByteArray const &part: pendingSave.value().parts)
+        contents += part;
+    return true;
+}
+
+/**
+ * @brief SaveEngine::flush
+ * Waits until every pending save has been written. Call it
+ * before terms or dictionaries are renamed or deleted.
+ */
+void SaveEngine::flush()
+{
+    QMutexLocker locker{&mMutex};
+    while (mRunning)
+        mIdle.wait(&mMutex);
+}
+
+/**
+ * @brief SaveEngine::run
+ * Writes the pending saves until none are left. Each one
+ * is appended to the dictionary's pack, which drops a
+ * record torn by a crash when it is next opened, so the
+ * previous definition survives. Every save written also
+ * becomes a revision of the term; the first time a term is
+ * saved, the definition it replaces is kept as well. Runs
+ * on a worker thread.
+ */
+void SaveEngine::run()
+{
+    QMutexLocker locker{&mMutex};
+    while (!mPending.isEmpty())
+    {
+        //Saves queued from now on wait for the next round
+        mWriting.swap(mPending);
+        locker.unlock();
+
+        for (auto save = mWriting.constBegin(); save != mWriting.constEnd(); ++save)
+        {
+            ScopedTimer const timer{Metrics::SaveEngineWrite};
+            QSharedPointer<TermStore> const store{mStorage->store(save.key().first)};
+            QString const &term{save.key().second};
+            Save const &contents{save.value()};
+            bool written{false};
+            QSharedPointer<RevisionStore> const revisions{mStorage->revisions(save.key().first)};
+            QByteArray previous;
+            if (!store.isNull() && !revisions.isNull() && !revisions->hasRevisions(term) &&
+                    store->read(term, previous))
+                revisions->record(term, TermStore::Parts{previous});
+            if (!store.isNull())
+                written = contents.delta.isEmpty() ?
+                            store->writeParts(term, contents.parts) :
+                            store->writeDelta(term, contents.delta, contents.parts);
+            if (!written)
+                emit saveFailed(save.key().first, save.key().second);
+            else if (!revisions.isNull())
+                revisions->record(term, contents.parts);
+        }
+
+        locker.relock();
+        mWriting.clear();
+    }
+    mRunning = false;
+    mIdle.wakeAll();
+}
@@ -0,0 +1,57 @@
+#ifndef SAVEENGINE_H
+#define SAVEENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include "termstore.h"
+
+class Storage;
+
+class SaveEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SaveEngine(Storage *storage, QObject *parent = nullptr);
+    ~SaveEngine();
+
+    void save(QString const &dictionary, QString const &term, QByteArray const &contents);
+
+    void save(QString const &dictionary, QString const &term, TermStore::Parts const &parts,
+              TermStore::Delta const &delta = TermStore::Delta{});
+
+    bool pending(QString const &dictionary, QString const &term, QByteArray &contents) const;
+
+    void flush();
+
+signals:
+    //Do not implement signals
+    void saveFailed(QString dictionary, QString term);
+
+private:
+    typedef QPair<QString, QString> Key;
+
+    struct Save
+    {
+        TermStore::Parts parts;
+        //The changes made to the stored definition, if known
+        TermStore::Delta delta;
+    };
+
+    void run();
+
+    Storage *mStorage;
+    mutable QMutex mMutex;
+    QWaitCondition mIdle;
+    //Saves waiting for the worker, and those it is writing
+    QHash<Key, Save> mPending;
+    QHash<Key, Save> mWriting;
+    bool mRunning;
+};
+
+#endif // SAVEENGINE_H
@@ -0,0 +1,501 @@
+#include "storage.h"
+#include "packedtermstore.h"
+#include "revisionstore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <algorithm>
+
+//Every dictionary folder keeps its terms in this pack file
+QString const packFileName{"terms.pack"};
+
+//A dictionary still using one file per term is packed under
+//this name first, and renamed to the pack once complete
+QString const migrationFileName{packFileName + ".migrating"};
+
+//Past revisions of the terms are kept in this subfolder
+QString const revisionsFolderName{"revisions"};
+
+//Term files older than the packed term, but not the same, are
+//moved into this subfolder rather than removed
+QString const conflictsFolderName{"conflicts"};
+
+//Earlier versions kept a catalog of the dictionaries in this file
+QString const catalogFileName{"catalog.dat"};
+
+//Deleted dictionaries are renamed to hidden folders starting with
+//this prefix, and their files are removed in the background
+QString const tombstonePrefix{".deleted-"};
+
+/**
+ * @brief hasLooseFiles
+ * @param folder a dictionary folder
+ * @return whether it holds term files besides the pack,
+ * left from before the dictionary was packed or copied in
+ * since; the pack, its temporary and partial copies and the
+ * revisions subfolder are the program's own
+ */
+static bool hasLooseFiles(QDir const &folder)
+{
+    for (QString const &name: folder.entryList(QDir::Files))
+        if (!name.startsWith(packFileName))
+            return true;
+    return false;
+}
+
+/**
+ * @brief Storage::Storage
+ * Creates the storage for the dictionaries kept
+ * in the given folder.
+ * @param resourcesFolder the folder containing one
+ * subfolder per dictionary
+ */
+Storage::Storage(QString const &resourcesFolder) :
+    mResourcesFolder{resourcesFolder},
+    mCompression{false}
+{
+    QFile::remove(resourcesFolder + catalogFileName);
+}
+
+/**
+ * @brief Storage::~Storage
+ * Compacts and closes every open dictionary.
+ */
+Storage::~Storage()
+{
+    closeAll();
+}
+
+/**
+ * @brief Storage::dictionaries
+ * Lists the dictionaries. Only the names of the folders are
+ * read, never their contents; the terms of each dictionary
+ * are listed by the index of its pack.
+ * @return the names of the dictionary folders, sorted
+ * ignoring case
+ */
+QStringList Storage::dictionaries()
+{
+    QMutexLocker locker{&mMutex};
+
+    //Folders starting with a dot are not dictionaries
+    QStringList names;
+    QDir const dir{mResourcesFolder};
+    for (QString const &name: dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+        if (!name.startsWith("."))
+            names << name;
+
+    std::sort(names.begin(), names.end(), [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    return names;
+}
+
+/**
+ * @brief Storage::createDictionary
+ * Creates the folder of a new dictionary.
+ * @param dictionary the dictionary name
+ * @return whether the dictionary was created
+ */
+bool Storage::createDictionary(QString const &dictionary)
+{
+    QMutexLocker locker{&mMutex};
+
+    QDir const dir{mResourcesFolder};
+    if (dictionary == "" || dictionary.startsWith(".") || dir.exists(dictionary))
+        return false;
+
+    return dir.mkdir(dictionary);
+}
+
+/**
+ * @brief Storage::removeDictionary
+ * Closes a dictionary and turns its folder into a tombstone,
+ * a hidden folder that is no longer listed. This is a single
+ * rename however large the dictionary is; the files are
+ * removed later, in the background.
+ * @param dictionary the dictionary name
+ * @return whether the dictionary was deleted
+ */
+bool Storage::removeDictionary(QString const &dictionary)
+{
+    QMutexLocker locker{&mMutex};
+    while (mOpening.contains(dictionary) || mOpeningRevisions.contains(dictionary))
+        mStoreOpened.wait(&mMutex);
+
+    //The pack is about to be deleted, so it is not compacted;
+    //the interface may still be using the store, see refresh()
+    QSharedPointer<TermStore> const store{mStores.take(dictionary)};
+    if (!store.isNull())
+        mRetired.push_back(store);
+    mRevisions.remove(dictionary);
+
+    QDir dir{mResourcesFolder};
+    if (dictionary == "" || dictionary.startsWith(".") || !dir.exists(dictionary))
+        return false;
+
+    QString const tombstone{tombstonePrefix + QString::number(QDateTime::currentMSecsSinceEpoch()) +
+                            "-" + dictionary};
+    return dir.rename(dictionary, tombstone);
+}
+
+/**
+ * @brief Storage::tombstones
+ * @return the paths of the folders of deleted dictionaries
+ * whose files have not been removed yet
+ */
+QStringList Storage::tombstones() const
+{
+    QStringList paths;
+    QDir const dir{mResourcesFolder};
+    for (QString const &name: dir.entryList(QStringList{tombstonePrefix + "*"},
+                                            QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot))
+        paths << dir.filePath(name);
+    return paths;
+}
+
+/**
+ * @brief Storage::renameDictionary
+ * Closes a dictionary and renames its folder without
+ * touching its contents. The lock is held from closing the
+ * store to renaming the folder, so that no other thread can
+ * open the dictionary under its old name in between. The
+ * pack is not compacted, since this runs on a worker thread
+ * while the interface may be using slices of its mapping;
+ * it is compacted when closed under its new name.
+ * @param dictionary the current dictionary name
+ * @param newName the new dictionary name, which must not
+ * exist yet
+ * @return whether the dictionary was renamed
+ */
+bool Storage::renameDictionary(QString const &dictionary, QString const &newName)
+{
+    if (dictionary == "" || newName == "" || dictionary.startsWith(".") || newName.startsWith("."))
+        return false;
+
+    QMutexLocker locker{&mMutex};
+    while (mOpening.contains(dictionary) || mOpeningRevisions.contains(dictionary) ||
+           mOpening.contains(newName) || mOpeningRevisions.contains(newName))
+        mStoreOpened.wait(&mMutex);
+
+    //Never rely on the platform to refuse replacing a folder
+    QDir dir{mResourcesFolder};
+    if (!dir.exists(dictionary) || dir.exists(newName) ||
+            mStores.contains(newName) || mRevisions.contains(newName))
+        return false;
+
+    //The interface may still be using the store, see refresh()
+    QSharedPointer<TermStore> const store{mStores.take(dictionary)};
+    if (!store.isNull())
+        mRetired.push_back(store);
+    mRevisions.remove(dictionary);
+
+    return dir.rename(dictionary, newName);
+}
+
+/**
+ * @brief Storage::store
+ * Returns the store of the given dictionary, opening it
+ * the first time it is requested. Dictionaries still using
+ * one file per term are migrated into a pack file, and term
+ * files found next to a pack are moved into it.
+ * Dictionaries may be opened from worker threads; the lock
+ * is not held while a pack is read, so only threads that
+ * need the same dictionary wait for it.
+ * @param dictionary the dictionary name
+ * @return the store, or a null pointer if the dictionary
+ * does not exist or cannot be opened
+ */
+QSharedPointer<TermStore> Storage::store(QString const &dictionary)
+{
+    if (dictionary == "")
+        return QSharedPointer<TermStore>{};
+
+    QMutexLocker locker{&mMutex};
+
+    //Wait if another thread is already opening the dictionary
+    while (mOpening.contains(dictionary))
+        mStoreOpened.wait(&mMutex);
+
+    auto const openStore = mStores.constFind(dictionary);
+    if (openStore != mStores.constEnd())
+        return openStore.value();
+
+    QDir const folder{mResourcesFolder + dictionary};
+    if (!folder.exists())
+        return QSharedPointer<TermStore>{};
+
+    bool const compression{mCompression};
+    mOpening.insert(dictionary);
+    locker.unlock();
+
+    QString const packPath{folder.filePath(packFileName)};
+
+    //A dictionary that cannot be migrated is not opened, since
+    //opening it would create an empty pack in front of its terms
+    QSharedPointer<PackedTermStore> store;
+    if (QFile::exists(packPath) || !hasLooseFiles(folder) || migrate(folder, compression))
+    {
+        store.reset(new PackedTermStore{packPath});
+        store->setCompression(compression);
+        if (!store->open())
+            store.reset();
+        else if (hasLooseFiles(folder))
+        {
+            //Pick up the term files copied into the folder since
+            //it was packed, or left by a failed removal
+            for (QString const &path: importLooseFiles(folder, store.data()))
+                QFile::remove(path);
+        }
+    }
+
+    locker.relock();
+    mOpening.remove(dictionary);
+    if (!store.isNull())
+    {
+        //The choice may have changed while the store was opening
+        if (mCompression != compression)
+            store->setCompression(mCompression);
+        mStores.insert(dictionary, store);
+    }
+    mStoreOpened.wakeAll();
+    return store;
+}
+
+/**
+ * @brief Storage::revisions
+ * Opens the revision store of a dictionary, kept in a
+ * subfolder of the dictionary folder so that its files are
+ * never taken for term files. Like store(), the files are
+ * read without holding the lock, and other threads that
+ * need the same revisions wait for them.
+ * @param dictionary the dictionary name
+ * @return the revision store, or a null pointer if the
+ * dictionary does not exist or its revisions cannot be opened
+ */
+QSharedPointer<RevisionStore> Storage::revisions(QString const &dictionary)
+{
+    if (dictionary == "")
+        return QSharedPointer<RevisionStore>{};
+
+    QMutexLocker locker{&mMutex};
+    while (mOpeningRevisions.contains(dictionary))
+        mStoreOpened.wait(&mMutex);
+
+    auto const openRevisions = mRevisions.constFind(dictionary);
+    if (openRevisions != mRevisions.constEnd())
+        return openRevisions.value();
+
+    QDir const folder{mResourcesFolder + dictionary};
+    if (!folder.exists())
+        return QSharedPointer<RevisionStore>{};
+    mOpeningRevisions.insert(dictionary);
+    locker.unlock();
+
+    QSharedPointer<RevisionStore> revisions{new RevisionStore{folder.filePath(revisionsFolderName)}};
+    if (!revisions->open())
+        revisions.reset();
+
+    locker.relock();
+    mOpeningRevisions.remove(dictionary);
+    if (!revisions.isNull())
+        mRevisions.insert(dictionary, revisions);
+    mStoreOpened.wakeAll();
+    return revisions;
+}
+
+/**
+ * @brief Storage::refresh
+ * Forgets the open store of a dictionary changed by another
+ * program, such as a tool syncing the resources folder: its
+ * pack was replaced or written to, or term files were copied
+ * into its folder. The next call to store() reads it again.
+ * The forgotten store is not compacted, since that would
+ * overwrite the changes.
+ * @param dictionary the dictionary name
+ * @return whether the terms have to be read again, which is
+ * also the case when the dictionary is not open
+ */
+bool Storage::refresh(QString const &dictionary)
+{
+    QMutexLocker locker{&mMutex};
+    while (mOpening.contains(dictionary))
+        mStoreOpened.wait(&mMutex);
+
+    auto const openStore = mStores.constFind(dictionary);
+    if (openStore == mStores.constEnd())
+        return true;
+
+    //Every store is a pack, see store()
+    PackedTermStore const *pack{static_cast<PackedTermStore const *>(openStore.value().data())};
+    if (!pack->changedOnDisk() && !hasLooseFiles(QDir{mResourcesFolder + dictionary}))
+        return false;
+
+    //Later calls to store() open the new pack and write to it,
+    //but the interface may be in the middle of using the old
+    //store, or a slice of its mapping, so it is kept alive
+    mRetired.push_back(mStores.take(dictionary));
+    return true;
+}
+
+/**
+ * @brief Storage::releaseRetired
+ * Closes the stores dropped by refresh(), renameDictionary()
+ * and removeDictionary(). Call it from the
+ * interface thread, between uses of the stores; worker
+ * threads keep their own references.
+ */
+void Storage::releaseRetired()
+{
+    QMutexLocker locker{&mMutex};
+    QList<QSharedPointer<TermStore>> const retired{mRetired};
+    mRetired.clear();
+    locker.unlock();
+}
+
+/**
+ * @brief Storage::packPath
+ * @param dictionary the dictionary name
+ * @return the path of the pack holding its terms
+ */
+QString Storage::packPath(QString const &dictionary) const
+{
+    return QDir{mResourcesFolder + dictionary}.filePath(packFileName);
+}
+
+/**
+ * @brief Storage::setCompression
+ * Chooses whether the dictionaries compress the definitions
+ * written from now on, both those already open and those
+ * opened later.
+ * @param enabled whether to compress definitions
+ */
+void Storage::setCompression(bool enabled)
+{
+    QMutexLocker locker{&mMutex};
+    mCompression = enabled;
+    for (QSharedPointer<TermStore> const &store: mStores)
+        store->setCompression(enabled);
+}
+
+/**
+ * @brief Storage::importLooseFiles
+ * Copies the terms stored as individual files inside the
+ * dictionary folder into its pack. A file only replaces a
+ * packed term if it is newer. A file that is not newer, such
+ * as one restored with its old time, only counts as packed
+ * if it holds the same definition; otherwise it is moved
+ * into the conflicts subfolder, where nothing removes it.
+ * @param folder the dictionary folder
+ * @param store the pack of the dictionary
+ * @return the files now held by the pack, which may be
+ * removed; none if the pack could not be written safely
+ */
+QStringList Storage::importLooseFiles(QDir const &folder, PackedTermStore *store)
+{
+    QStringList imported;
+    for (QFileInfo const &item: folder.entryInfoList(QDir::Files))
+    {
+        //Skip the pack and any temporary copy of it
+        if (item.fileName().startsWith(packFileName))
+            continue;
+
+        QFile file{item.filePath()};
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        QByteArray const contents{file.readAll()};
+        file.close();
+
+        qint64 const modified{item.lastModified().toMSecsSinceEpoch()};
+        if (store->modified(item.fileName()) >= modified)
+        {
+            QByteArray packed;
+            if (store->read(item.fileName(), packed) && packed == contents)
+                imported << item.filePath();
+            else if (folder.mkpath(conflictsFolderName))
+                QFile::rename(item.filePath(), folder.filePath(conflictsFolderName + "/" + item.fileName()));
+            continue;
+        }
+
+        if (store->write(item.fileName(), contents, modified))
+            imported << item.filePath();
+    }
+
+    if (imported.isEmpty() || !store->compact())
+        return QStringList{};
+    return imported;
+}
+
+/**
+ * @brief Storage::migrate
+ * Packs a dictionary still using one file per term. The
+ * pack is written under another name and renamed into place
+ * once complete, so an interrupted migration leaves the term
+ * files as they were and starts over the next time. The
+ * files are only removed once the pack is in place.
+ * @param folder the dictionary folder
+ * @param compression whether to compress the definitions
+ * @return whether the dictionary was packed
+ */
+bool Storage::migrate(QDir const &folder, bool compression)
+{
+    QString const migrationPath{folder.filePath(migrationFileName)};
+    QFile::remove(migrationPath);
+
+    QStringList imported;
+    {
+        PackedTermStore pack{migrationPath};
+        pack.setCompression(compression);
+        if (!pack.open())
+            return false;
+        imported = importLooseFiles(folder, &pack);
+        if (imported.isEmpty())
+            return false;
+    }
+
+    //The pack is closed first, since an open file cannot be
+    //renamed everywhere
+    if (!QFile::rename(migrationPath, folder.filePath(packFileName)))
+        return false;
+    for (QString const &path: imported)
+        QFile::remove(path);
+    return true;
+}
+
+/**
+ * @brief Storage::close
+ * Compacts and closes the store of a dictionary, so that
+ * its folder can be renamed or deleted. A worker thread
+ * still using the store keeps it alive until it is done.
+ * @param dictionary the dictionary name
+ */
+void Storage::close(QString const &dictionary)
+{
+    QMutexLocker locker{&mMutex};
+    while (mOpening.contains(dictionary) || mOpeningRevisions.contains(dictionary))
+        mStoreOpened.wait(&mMutex);
+
+    QSharedPointer<TermStore> const store{mStores.take(dictionary)};
+    mRevisions.remove(dictionary);
+    locker.unlock();
+
+    if (!store.isNull())
+        store->maybeCompact();
+}
+
+/**
+ * @brief Storage::closeAll
+ * Compacts and closes every open store.
+ */
+void Storage::closeAll()
+{
+    QMutexLocker locker{&mMutex};
+    QStringList const dictionaries{mStores.keys()};
+    locker.unlock();
+
+    for (QString const &dictionary: dictionaries)
+        close(dictionary);
+}
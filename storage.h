@@ -0,0 +1,66 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+
+class QDir;
+class TermStore;
+class PackedTermStore;
+class RevisionStore;
+
+class Storage
+{
+public:
+    explicit Storage(QString const &resourcesFolder);
+    ~Storage();
+
+    QStringList dictionaries();
+
+    bool createDictionary(QString const &dictionary);
+
+    bool removeDictionary(QString const &dictionary);
+
+    QStringList tombstones() const;
+
+    bool renameDictionary(QString const &dictionary, QString const &newName);
+
+    QSharedPointer<TermStore> store(QString const &dictionary);
+
+    QSharedPointer<RevisionStore> revisions(QString const &dictionary);
+
+    bool refresh(QString const &dictionary);
+
+    void releaseRetired();
+
+    QString packPath(QString const &dictionary) const;
+
+    void setCompression(bool enabled);
+
+    void close(QString const &dictionary);
+
+    void closeAll();
+
+private:
+    static QStringList importLooseFiles(QDir const &folder, PackedTermStore *store);
+
+    static bool migrate(QDir const &folder, bool compression);
+
+    QString const mResourcesFolder;
+    QMutex mMutex;
+    QWaitCondition mStoreOpened;
+    QHash<QString, QSharedPointer<TermStore>> mStores;
+    //Stores dropped by refresh() that the interface may still use
+    QList<QSharedPointer<TermStore>> mRetired;
+    QHash<QString, QSharedPointer<RevisionStore>> mRevisions;
+    QSet<QString> mOpening;
+    QSet<QString> mOpeningRevisions;
+    bool mCompression;
+};
+
+#endif // STORAGE_H
@@ -0,0 +1,293 @@
+#include "termlistmodel.h"
+
+#include <QPair>
+#include <algorithm>
+
+/**
+ * @brief TermListModel::TermListModel
+ * Creates an empty list of terms.
+ * @param parent
+ */
+TermListModel::TermListModel(QObject *parent) :
+    QAbstractListModel{parent}
+{
+    mOffsets.push_back(0);
+}
+
+/**
+ * @brief TermListModel::rowCount
+ * @param parent
+ * @return the number of terms
+ */
+int TermListModel::rowCount(QModelIndex const &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return mOffsets.size() - 1;
+}
+
+/**
+ * @brief TermListModel::data
+ * Decodes the name of a term. Views only ask for the
+ * rows they show, so names are never decoded in bulk.
+ * @param index the row of the term
+ * @param role the display or edit role
+ * @return the term name
+ */
+QVariant TermListModel::data(QModelIndex const &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return QVariant{};
+    return term(index.row());
+}
+
+/**
+ * @brief TermListModel::setTerms
+ * Replaces the terms of the model. The names are sorted
+ * ignoring case, which is the order the completer expects,
+ * and packed into a single buffer.
+ * @param terms the term names
+ */
+void TermListModel::setTerms(QStringList terms)
+{
+    std::sort(terms.begin(), terms.end(), [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+
+    beginResetModel();
+    mNames.clear();
+    mOffsets.clear();
+    mOffsets.reserve(terms.size() + 1);
+    mOffsets.push_back(0);
+    for (QString const &term: terms)
+    {
+        mNames += term.toUtf8();
+        mOffsets.push_back(mNames.size());
+    }
+    mNames.squeeze();
+    endResetModel();
+}
+
+/**
+ * @brief TermListModel::insertTerms
+ * Adds a batch of terms sorted ignoring case. Batches that
+ * sort after every listed term, such as those streamed by
+ * the term loader, are appended without moving any name.
+ * @param terms the sorted term names
+ */
+void TermListModel::insertTerms(QStringList const &terms)
+{
+    if (terms.isEmpty())
+        return;
+
+    int const rows{rowCount()};
+    if (rows != 0 &&
+            QString::compare(terms.first(), term(rows - 1), Qt::CaseInsensitive) <= 0)
+    {
+        //The batch overlaps the listed terms, merge it term by term
+        for (QString const &term: terms)
+            insertTerm(term);
+        return;
+    }
+
+    beginInsertRows(QModelIndex{}, rows, rows + terms.size() - 1);
+    mOffsets.reserve(mOffsets.size() + terms.size());
+    for (QString const &term: terms)
+    {
+        mNames += term.toUtf8();
+        mOffsets.push_back(mNames.size());
+    }
+    endInsertRows();
+}
+
+/**
+ * @brief TermListModel::insertTerm
+ * Adds a term at its sorted position, unless it is
+ * already listed.
+ * @param term the term name
+ * @return the row of the term
+ */
+int TermListModel::insertTerm(QString const &term)
+{
+    int const existing{find(term)};
+    if (existing != -1 && this->term(existing) == term)
+        return existing;
+
+    int const row{lowerBound(term)};
+    QByteArray const name{term.toUtf8()};
+
+    beginInsertRows(QModelIndex{}, row, row);
+    mNames.insert(mOffsets[row], name);
+    mOffsets.insert(row, mOffsets[row]);
+    for (int i = row + 1; i < mOffsets.size(); i++)
+        mOffsets[i] += name.size();
+    endInsertRows();
+    return row;
+}
+
+/**
+ * @brief TermListModel::removeTerm
+ * Removes a term, if it is listed.
+ * @param term the term name
+ */
+void TermListModel::removeTerm(QString const &term)
+{
+    int const row{find(term)};
+    if (row == -1 || this->term(row) != term)
+        return;
+
+    int const size{mOffsets[row + 1] - mOffsets[row]};
+
+    beginRemoveRows(QModelIndex{}, row, row);
+    mNames.remove(mOffsets[row], size);
+    mOffsets.remove(row + 1);
+    for (int i = row + 1; i < mOffsets.size(); i++)
+        mOffsets[i] -= size;
+    endRemoveRows();
+}
+
+/**
+ * @brief TermListModel::applyChanges
+ * Removes and inserts many terms at once. The names are
+ * copied into a new buffer in a single pass and the views
+ * are told that the layout changed, so they keep their
+ * selection and scroll position instead of being reset.
+ * @param removed the terms to remove
+ * @param inserted the terms to insert, unless already listed
+ */
+void TermListModel::applyChanges(QStringList const &removed, QStringList inserted)
+{
+    if (removed.isEmpty() && inserted.isEmpty())
+        return;
+
+    int const rows{rowCount()};
+    QVector<bool> removedRows(rows, false);
+    for (QString const &term: removed)
+    {
+        int const row{find(term)};
+        if (row != -1 && this->term(row) == term)
+            removedRows[row] = true;
+    }
+
+    //Place each new term before the first listed term that does
+    //not sort before it, skipping those that stay listed
+    std::sort(inserted.begin(), inserted.end(), [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    inserted.removeDuplicates();
+    QVector<QPair<int, QByteArray>> insertions;
+    for (QString const &term: inserted)
+    {
+        int const row{find(term)};
+        if (row != -1 && this->term(row) == term && !removedRows[row])
+            continue;
+        insertions.push_back(qMakePair(lowerBound(term), term.toUtf8()));
+    }
+
+    emit layoutAboutToBeChanged();
+
+    QByteArray names;
+    names.reserve(mNames.size());
+    QVector<int> offsets;
+    offsets.reserve(rows + insertions.size() + 1);
+    offsets.push_back(0);
+    QVector<int> newRows(rows, -1);
+    int next{0};
+    for (int row = 0; row <= rows; row++)
+    {
+        for (; next < insertions.size() && insertions[next].first == row; next++)
+        {
+            names += insertions[next].second;
+            offsets.push_back(names.size());
+        }
+        if (row == rows || removedRows[row])
+            continue;
+        newRows[row] = offsets.size() - 1;
+        names.append(mNames.constData() + mOffsets[row], mOffsets[row + 1] - mOffsets[row]);
+        offsets.push_back(names.size());
+    }
+    mNames = names;
+    mOffsets = offsets;
+
+    for (QModelIndex const &index: persistentIndexList())
+        changePersistentIndex(index, newRows[index.row()] == -1 ? QModelIndex{} :
+                                                                  this->index(newRows[index.row()]));
+    emit layoutChanged();
+}
+
+/**
+ * @brief TermListModel::clear
+ * Removes every term.
+ */
+void TermListModel::clear()
+{
+    setTerms(QStringList{});
+}
+
+/**
+ * @brief TermListModel::term
+ * @param row the row of the term
+ * @return the term name, or an empty string if out of range
+ */
+QString TermListModel::term(int row) const
+{
+    if (row < 0 || row >= rowCount())
+        return QString{};
+    return QString::fromUtf8(mNames.constData() + mOffsets[row],
+                             mOffsets[row + 1] - mOffsets[row]);
+}
+
+/**
+ * @brief TermListModel::lowerBound
+ * @param term the term name
+ * @return the first row that does not sort before term
+ */
+int TermListModel::lowerBound(QString const &term) const
+{
+    int first{0};
+    int count{rowCount()};
+    while (count > 0)
+    {
+        int const step{count / 2};
+        if (QString::compare(this->term(first + step), term, Qt::CaseInsensitive) < 0)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first;
+}
+
+/**
+ * @brief TermListModel::find
+ * Finds a term by name. An exact match is preferred,
+ * otherwise the first match ignoring case is returned.
+ * @param term the term name
+ * @return the row of the term, or -1 if it is not listed
+ */
+int TermListModel::find(QString const &term) const
+{
+    int const first{lowerBound(term)};
+    int row{first};
+    while (row < rowCount() &&
+           QString::compare(this->term(row), term, Qt::CaseInsensitive) == 0)
+    {
+        if (this->term(row) == term)
+            return row;
+        row++;
+    }
+    return row > first ? first : -1;
+}
+
+/**
+ * @brief TermListModel::hasPrefix
+ * @param prefix the beginning of a term name
+ * @return whether any term starts with prefix, ignoring case
+ */
+bool TermListModel::hasPrefix(QString const &prefix) const
+{
+    int const row{lowerBound(prefix)};
+    return row < rowCount() && term(row).startsWith(prefix, Qt::CaseInsensitive);
+}
@@ -0,0 +1,47 @@
+#ifndef TERMLISTMODEL_H
+#define TERMLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+
+class TermListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit TermListModel(QObject *parent = nullptr);
+
+    int rowCount(QModelIndex const &parent = QModelIndex()) const override;
+
+    QVariant data(QModelIndex const &index, int role = Qt::DisplayRole) const override;
+
+    void setTerms(QStringList terms);
+
+    void insertTerms(QStringList const &terms);
+
+    int insertTerm(QString const &term);
+
+    void removeTerm(QString const &term);
+
+    void applyChanges(QStringList const &removed, QStringList inserted);
+
+    void clear();
+
+    QString term(int row) const;
+
+    int find(QString const &term) const;
+
+    bool hasPrefix(QString const &prefix) const;
+
+private:
+    int lowerBound(QString const &term) const;
+
+    //Every name encoded as UTF-8, back to back
+    QByteArray mNames;
+    //Where each name starts in mNames, plus the end of the last one
+    QVector<int> mOffsets;
+};
+
+#endif // TERMLISTMODEL_H
@@ -0,0 +1,158 @@
+#include "termloader.h"
+#include "storage.h"
+#include "termstore.h"
+#include "metrics.h"
+
+#include <QtConcurrent>
+
+//Number of term names handed to the interface at a time
+int const batchSize{4096};
+
+/**
+ * @brief TermLoader::TermLoader
+ * Creates a loader that reads the term names of a
+ * dictionary on a worker thread.
+ * @param storage the storage holding the dictionaries
+ * @param parent
+ */
+TermLoader::TermLoader(Storage *storage, QObject *parent) :
+    QObject{parent},
+    mStorage{storage},
+    mGeneration{0}
+{
+    //Batches are emitted from the worker thread and relayed
+    //from the loader's thread, dropping those of cancelled loads
+    QObject::connect(this, SIGNAL(batchReady(int,QStringList)),
+                     this, SLOT(relayBatch(int,QStringList)), Qt::QueuedConnection);
+    QObject::connect(this, SIGNAL(loadFinished(int,QString)),
+                     this, SLOT(relayFinished(int,QString)), Qt::QueuedConnection);
+
+    qRegisterMetaType<QSharedPointer<FuzzyMatcher>>();
+    QObject::connect(this, SIGNAL(matcherBuilt(int,QSharedPointer<FuzzyMatcher>)),
+                     this, SLOT(relayMatcher(int,QSharedPointer<FuzzyMatcher>)), Qt::QueuedConnection);
+}
+
+/**
+ * @brief TermLoader::~TermLoader
+ * Cancels the current load and waits for every worker,
+ * since a cancelled one may still be opening a dictionary.
+ */
+TermLoader::~TermLoader()
+{
+    cancel();
+    mLoads.waitForFinished();
+}
+
+/**
+ * @brief TermLoader::load
+ * Starts loading the terms of a dictionary, cancelling
+ * any load that is still running. The terms are delivered
+ * through termsLoaded in sorted batches, followed by
+ * a fuzzy matcher over them through matcherReady.
+ * @param dictionary the dictionary name
+ */
+void TermLoader::load(QString const &dictionary)
+{
+    int const generation{mGeneration.fetchAndAddOrdered(1) + 1};
+
+    //Cancelled loads stop at their next check, but are kept
+    //until they do so that the destructor can wait for them
+    QList<QFuture<void>> const loads{mLoads.futures()};
+    mLoads.clearFutures();
+    for (QFuture<void> const &load: loads)
+        if (!load.isFinished())
+            mLoads.addFuture(load);
+    mLoads.addFuture(QtConcurrent::run(this, &TermLoader::run, dictionary, generation));
+}
+
+/**
+ * @brief TermLoader::cancel
+ * Stops the current load. Batches that are already
+ * queued are discarded.
+ */
+void TermLoader::cancel()
+{
+    mGeneration.fetchAndAddOrdered(1);
+}
+
+/**
+ * @brief TermLoader::isLoading
+ * @return whether a load is running
+ */
+bool TermLoader::isLoading() const
+{
+    QList<QFuture<void>> const loads{mLoads.futures()};
+    return !loads.isEmpty() && loads.last().isRunning();
+}
+
+/**
+ * @brief TermLoader::run
+ * Opens the dictionary and hands out its terms in batches,
+ * then builds the fuzzy matcher. Runs on a worker thread.
+ * @param dictionary the dictionary name
+ * @param generation the load this run belongs to
+ */
+void TermLoader::run(QString const &dictionary, int generation)
+{
+    ScopedTimer const timer{Metrics::TermLoaderRun};
+
+    //Opening may have to read the pack or migrate loose files
+    QSharedPointer<TermStore> const store{mStorage->store(dictionary)};
+    if (store.isNull() || generation != mGeneration.loadAcquire())
+        return;
+
+    QStringList const terms{store->terms()};
+    for (int first = 0; first < terms.size(); first += batchSize)
+    {
+        if (generation != mGeneration.loadAcquire())
+            return;
+        emit batchReady(generation, terms.mid(first, batchSize));
+    }
+    emit loadFinished(generation, dictionary);
+
+    //The terms can be browsed while the matcher is being built
+    QSharedPointer<FuzzyMatcher> const matcher{new FuzzyMatcher};
+    for (int i = 0; i < terms.size(); i++)
+    {
+        if (i % batchSize == 0 && generation != mGeneration.loadAcquire())
+            return;
+        matcher->insert(terms[i]);
+    }
+    emit matcherBuilt(generation, matcher);
+}
+
+/**
+ * @brief TermLoader::relayBatch
+ * Passes on a batch unless its load has been cancelled.
+ * @param generation the load the batch belongs to
+ * @param terms the term names
+ */
+void TermLoader::relayBatch(int generation, QStringList const &terms)
+{
+    if (generation == mGeneration.loadAcquire())
+        emit termsLoaded(terms);
+}
+
+/**
+ * @brief TermLoader::relayFinished
+ * Reports the end of a load unless it has been cancelled.
+ * @param generation the load that finished
+ * @param dictionary the dictionary name
+ */
+void TermLoader::relayFinished(int generation, QString const &dictionary)
+{
+    if (generation == mGeneration.loadAcquire())
+        emit finished(dictionary);
+}
+
+/**
+ * @brief TermLoader::relayMatcher
+ * Passes on the fuzzy matcher unless its load has been cancelled.
+ * @param generation the load the matcher belongs to
+ * @param matcher the matcher over the loaded terms
+ */
+void TermLoader::relayMatcher(int generation, QSharedPointer<FuzzyMatcher> const &matcher)
+{
+    if (generation == mGeneration.loadAcquire())
+        emit matcherReady(matcher);
+}
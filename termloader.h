@@ -0,0 +1,59 @@
+#ifndef TERMLOADER_H
+#define TERMLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureSynchronizer>
+#include "fuzzymatcher.h"
+
+class Storage;
+
+class TermLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TermLoader(Storage *storage, QObject *parent = nullptr);
+    ~TermLoader();
+
+    void load(QString const &dictionary);
+
+    void cancel();
+
+    bool isLoading() const;
+
+signals:
+    //Do not implement signals
+    void termsLoaded(QStringList terms);
+
+    void finished(QString dictionary);
+
+    void matcherReady(QSharedPointer<FuzzyMatcher> matcher);
+
+    void batchReady(int generation, QStringList terms);
+
+    void loadFinished(int generation, QString dictionary);
+
+    void matcherBuilt(int generation, QSharedPointer<FuzzyMatcher> matcher);
+
+private slots:
+    void relayBatch(int generation, QStringList const &terms);
+
+    void relayFinished(int generation, QString const &dictionary);
+
+    void relayMatcher(int generation, QSharedPointer<FuzzyMatcher> const &matcher);
+
+private:
+    void run(QString const &dictionary, int generation);
+
+    Storage *mStorage;
+    QAtomicInt mGeneration;
+    //Every load still running, including cancelled ones,
+    //which may still be using the storage
+    QFutureSynchronizer<void> mLoads;
+};
+
+#endif // TERMLOADER_H
@@ -0,0 +1,165 @@
+#include "termsearch.h"
+#include "storage.h"
+#include "termstore.h"
+#include "metrics.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+
+//Check whether the search was replaced every this many terms
+int const cancellationInterval{4096};
+
+/**
+ * @brief TermSearch::TermSearch
+ * Creates a search for term names across every dictionary.
+ * Each dictionary is searched by its own task on a thread
+ * pool, and its matches are delivered as soon as it is done.
+ * @param storage the storage holding the dictionaries
+ * @param parent
+ */
+TermSearch::TermSearch(Storage *storage, QObject *parent) :
+    QObject{parent},
+    mStorage{storage},
+    mGeneration{0},
+    mRemaining{0}
+{
+    //Matches are emitted from the pool and relayed from the
+    //search's thread, dropping those of replaced searches
+    qRegisterMetaType<TermSearch::Matches>("TermSearch::Matches");
+    QObject::connect(this, SIGNAL(dictionarySearched(int,TermSearch::Matches)),
+                     this, SLOT(relayMatches(int,TermSearch::Matches)), Qt::QueuedConnection);
+}
+
+/**
+ * @brief TermSearch::~TermSearch
+ * Cancels the current search and waits for its tasks.
+ */
+TermSearch::~TermSearch()
+{
+    cancel();
+    mPool.waitForDone();
+}
+
+/**
+ * @brief TermSearch::search
+ * Starts searching every dictionary for terms containing the
+ * query, cancelling the previous search. Matches arrive in
+ * batches through matchesFound, one per dictionary with
+ * matches, followed by finished.
+ * @param query the text to look for, ignoring case
+ * @param firstDictionary the dictionary to search first,
+ * usually the open one, whose terms are already in memory
+ * @param limit the maximum number of matches per dictionary
+ */
+void TermSearch::search(QString const &query, QString const &firstDictionary, int limit)
+{
+    cancel();
+    int const generation{mGeneration.loadAcquire()};
+    if (query == "")
+    {
+        mRemaining = 0;
+        emit finished();
+        return;
+    }
+
+    QStringList dictionaries{mStorage->dictionaries()};
+    if (dictionaries.removeOne(firstDictionary))
+        dictionaries.prepend(firstDictionary);
+
+    mRemaining = dictionaries.size();
+    for (QString const &dictionary: dictionaries)
+        QtConcurrent::run(&mPool, this, &TermSearch::run, dictionary, query, limit, generation);
+    if (mRemaining == 0)
+        emit finished();
+}
+
+/**
+ * @brief TermSearch::cancel
+ * Stops the current search. Dictionaries not searched yet
+ * are skipped and matches already queued are discarded.
+ */
+void TermSearch::cancel()
+{
+    mGeneration.fetchAndAddOrdered(1);
+    mPool.clear();
+}
+
+/**
+ * @brief TermSearch::isBetter
+ * Orders matches by rank, then shorter terms first, then
+ * alphabetically ignoring case, then by dictionary.
+ * @param a a match
+ * @param b another match
+ * @return whether a goes before b
+ */
+bool TermSearch::isBetter(Match const &a, Match const &b)
+{
+    if (a.rank != b.rank)
+        return a.rank < b.rank;
+    if (a.term.size() != b.term.size())
+        return a.term.size() < b.term.size();
+    int const order{QString::compare(a.term, b.term, Qt::CaseInsensitive)};
+    if (order != 0)
+        return order < 0;
+    return QString::compare(a.dictionary, b.dictionary, Qt::CaseInsensitive) < 0;
+}
+
+/**
+ * @brief TermSearch::run
+ * Searches the terms of a dictionary. Terms starting with
+ * the query are found by binary search, since the terms are
+ * sorted ignoring case; only terms containing it elsewhere
+ * need a scan. Runs on the thread pool.
+ * @param dictionary the dictionary name
+ * @param query the text to look for
+ * @param limit the maximum number of matches
+ * @param generation the search this task belongs to
+ */
+void TermSearch::run(QString const &dictionary, QString const &query, int limit, int generation)
+{
+    if (generation != mGeneration.loadAcquire())
+        return;
+
+    ScopedTimer const timer{Metrics::TermSearchRun};
+    Matches matches;
+    QSharedPointer<TermStore> const store{mStorage->store(dictionary)};
+    QStringList const terms{store.isNull() ? QStringList{} : store->terms()};
+
+    auto term = std::lower_bound(terms.constBegin(), terms.constEnd(), query,
+                                 [](QString const &a, QString const &b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    for (; term != terms.constEnd() && matches.size() < limit &&
+         term->startsWith(query, Qt::CaseInsensitive); ++term)
+        matches.push_back(Match{dictionary, *term, term->size() == query.size() ? Exact : Prefix});
+
+    for (int i = 0; i < terms.size() && matches.size() < limit; i++)
+    {
+        if (i % cancellationInterval == 0 && generation != mGeneration.loadAcquire())
+            return;
+        QString const &name{terms[i]};
+        if (name.size() > query.size() && name.indexOf(query, 1, Qt::CaseInsensitive) != -1 &&
+                !name.startsWith(query, Qt::CaseInsensitive))
+            matches.push_back(Match{dictionary, name, Substring});
+    }
+
+    emit dictionarySearched(generation, matches);
+}
+
+/**
+ * @brief TermSearch::relayMatches
+ * Passes on the matches of one dictionary of the current
+ * search, and tells when every dictionary has been searched.
+ * @param generation the search the matches belong to
+ * @param matches the matches of one dictionary
+ */
+void TermSearch::relayMatches(int generation, Matches const &matches)
+{
+    if (generation != mGeneration.loadAcquire())
+        return;
+
+    if (!matches.isEmpty())
+        emit matchesFound(matches);
+    if (--mRemaining == 0)
+        emit finished();
+}
@@ -0,0 +1,68 @@
+#ifndef TERMSEARCH_H
+#define TERMSEARCH_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QMetaType>
+
+class Storage;
+
+class TermSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    //How well a term matches the query, best first
+    enum Rank
+    {
+        Exact,
+        Prefix,
+        Substring
+    };
+
+    struct Match
+    {
+        QString dictionary;
+        QString term;
+        Rank rank;
+    };
+
+    typedef QVector<Match> Matches;
+
+    explicit TermSearch(Storage *storage, QObject *parent = nullptr);
+    ~TermSearch();
+
+    void search(QString const &query, QString const &firstDictionary, int limit);
+
+    void cancel();
+
+    static bool isBetter(Match const &a, Match const &b);
+
+signals:
+    //Do not implement signals
+    void matchesFound(TermSearch::Matches matches);
+
+    void finished();
+
+    void dictionarySearched(int generation, TermSearch::Matches matches);
+
+private slots:
+    void relayMatches(int generation, TermSearch::Matches const &matches);
+
+private:
+    void run(QString const &dictionary, QString const &query, int limit, int generation);
+
+    Storage *mStorage;
+    QThreadPool mPool;
+    QAtomicInt mGeneration;
+    //Dictionaries of the current search not searched yet
+    int mRemaining;
+};
+
+Q_DECLARE_METATYPE(TermSearch::Matches)
+
+#endif // TERMSEARCH_H
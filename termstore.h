@@ -0,0 +1,65 @@
+#ifndef TERMSTORE_H
+#define TERMSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QPair>
+#include <QVector>
+
+/**
+ * @brief The TermStore class
+ * Storage interface for the terms of a single dictionary.
+ * Definitions are UTF-8 encoded byte arrays.
+ */
+class TermStore
+{
+public:
+    //A term name and its definition
+    typedef QPair<QString, QByteArray> Term;
+
+    //A definition split into consecutive pieces
+    typedef QVector<QByteArray> Parts;
+
+    //Bytes removed at an offset and replaced by others
+    struct Splice
+    {
+        quint32 offset;
+        quint32 removed;
+        QByteArray inserted;
+    };
+
+    //Splices applied one after another, each offset referring
+    //to the definition as left by the previous splices
+    typedef QVector<Splice> Delta;
+
+    virtual ~TermStore() {}
+
+    virtual QStringList terms() const = 0;
+
+    virtual bool contains(QString const &term) const = 0;
+
+    virtual bool read(QString const &term, QByteArray &contents) = 0;
+
+    virtual bool view(QString const &term, QByteArray &contents) = 0;
+
+    virtual bool write(QString const &term, QByteArray const &contents) = 0;
+
+    virtual bool writeParts(QString const &term, Parts const &parts) = 0;
+
+    virtual bool writeDelta(QString const &term, Delta const &delta, Parts const &parts) = 0;
+
+    virtual bool writeBatch(QVector<Term> const &terms) = 0;
+
+    virtual bool remove(QString const &term) = 0;
+
+    virtual bool rename(QString const &term, QString const &newName) = 0;
+
+    virtual void setCompression(bool enabled) = 0;
+
+    virtual void maybeCompact() = 0;
+
+    virtual bool compact() = 0;
+};
+
+#endif // TERMSTORE_H
@@ -0,0 +1,224 @@
+#include "termwatcher.h"
+#include "storage.h"
+#include "termstore.h"
+#include "metrics.h"
+
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QtConcurrent>
+
+//Milliseconds without changes before they are applied, so that
+//a bulk sync touching many files causes a single update
+int const settleDelay{500};
+
+/**
+ * @brief TermWatcher::TermWatcher
+ * Creates a watcher for changes made to the dictionaries
+ * by other programs.
+ * @param storage the storage holding the dictionaries
+ * @param resourcesFolder the folder containing the dictionaries
+ * @param parent
+ */
+TermWatcher::TermWatcher(Storage *storage, QString const &resourcesFolder, QObject *parent) :
+    QObject{parent},
+    mStorage{storage},
+    mResourcesFolder{resourcesFolder},
+    mDictionariesChanged{false},
+    mTermsChanged{false},
+    mGeneration{0},
+    mSeeded{false}
+{
+    mWatcher = new QFileSystemWatcher{this};
+    QObject::connect(mWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(queueChange(QString)));
+    QObject::connect(mWatcher, SIGNAL(fileChanged(QString)), this, SLOT(queueChange(QString)));
+
+    mTimer = new QTimer{this};
+    mTimer->setSingleShot(true);
+    mTimer->setInterval(settleDelay);
+    QObject::connect(mTimer, SIGNAL(timeout()), this, SLOT(synchronize()));
+
+    //Changes are found on the worker thread and relayed from
+    //the watcher's thread, dropping those of other dictionaries
+    QObject::connect(this, SIGNAL(changesFound(int,QString,QStringList,QStringList)),
+                     this, SLOT(relayChanges(int,QString,QStringList,QStringList)),
+                     Qt::QueuedConnection);
+
+    watchPaths();
+}
+
+/**
+ * @brief TermWatcher::~TermWatcher
+ * Waits for the worker.
+ */
+TermWatcher::~TermWatcher()
+{
+    mGeneration.fetchAndAddOrdered(1);
+    mSync.waitForFinished();
+}
+
+/**
+ * @brief TermWatcher::watch
+ * Starts watching a dictionary instead of the previous one.
+ * A sync of the previous dictionary still running is not
+ * waited for; it finds its generation outdated and drops
+ * what it read. The terms the changes are found against
+ * are handed in by seed() as the term loader lists them.
+ * @param dictionary the dictionary name
+ */
+void TermWatcher::watch(QString const &dictionary)
+{
+    mGeneration.fetchAndAddOrdered(1);
+    mDictionary = dictionary;
+    mTermsChanged = false;
+    mSeeded = false;
+    QMutexLocker locker{&mMutex};
+    mTerms.clear();
+    locker.unlock();
+    watchPaths();
+}
+
+/**
+ * @brief TermWatcher::seed
+ * Adds terms listed by the term loader for the watched
+ * dictionary, so that the dictionary is not read twice.
+ * @param terms a batch of term names
+ */
+void TermWatcher::seed(QStringList const &terms)
+{
+    QMutexLocker locker{&mMutex};
+    for (QString const &term: terms)
+        mTerms.insert(term);
+}
+
+/**
+ * @brief TermWatcher::finishSeeding
+ * Tells that the term loader listed every term, so that
+ * changes noted meanwhile can be applied.
+ */
+void TermWatcher::finishSeeding()
+{
+    mSeeded = true;
+    if (mTermsChanged)
+        mTimer->start();
+}
+
+/**
+ * @brief TermWatcher::watchPaths
+ * Watches the resources folder, the folder of the dictionary,
+ * and its pack. A pack replaced by another program is no
+ * longer watched by the system, so it is added again.
+ */
+void TermWatcher::watchPaths()
+{
+    QStringList paths{mResourcesFolder};
+    if (mDictionary != "")
+    {
+        QString const pack{mStorage->packPath(mDictionary)};
+        paths << QFileInfo{pack}.path() << pack;
+    }
+
+    QStringList stale{mWatcher->files() + mWatcher->directories()};
+    for (QString const &path: paths)
+        stale.removeAll(path);
+    if (!stale.isEmpty())
+        mWatcher->removePaths(stale);
+
+    for (QString const &path: paths)
+        if (!mWatcher->files().contains(path) && !mWatcher->directories().contains(path) &&
+                QFileInfo::exists(path))
+            mWatcher->addPath(path);
+}
+
+/**
+ * @brief TermWatcher::queueChange
+ * Notes what changed and waits for things to settle.
+ * @param path the file or folder that changed
+ */
+void TermWatcher::queueChange(QString const &path)
+{
+    if (path == mResourcesFolder)
+        mDictionariesChanged = true;
+    else
+        mTermsChanged = true;
+    mTimer->start();
+}
+
+/**
+ * @brief TermWatcher::synchronize
+ * Applies the changes noted since the last time. The terms
+ * are compared on a worker thread; if it is still busy,
+ * the changes wait a little longer. Changes to the terms
+ * also wait until the term loader has listed them.
+ */
+void TermWatcher::synchronize()
+{
+    if (mSync.isRunning())
+    {
+        mTimer->start();
+        return;
+    }
+
+    watchPaths();
+    if (mDictionariesChanged)
+    {
+        mDictionariesChanged = false;
+        emit dictionariesChanged();
+    }
+    if (mTermsChanged && mSeeded && mDictionary != "")
+    {
+        mTermsChanged = false;
+        mSync = QtConcurrent::run(this, &TermWatcher::run, mDictionary, mGeneration.loadAcquire());
+    }
+}
+
+/**
+ * @brief TermWatcher::run
+ * Reads the terms of the dictionary and compares them with
+ * those known so far. Nothing is read unless the dictionary
+ * changed on disk. Runs on a worker thread.
+ * @param dictionary the dictionary name
+ * @param generation the generation of the dictionary
+ */
+void TermWatcher::run(QString const &dictionary, int generation)
+{
+    if (!mStorage->refresh(dictionary))
+        return;
+
+    ScopedTimer const timer{Metrics::TermWatcherRun};
+    QSharedPointer<TermStore> const store{mStorage->store(dictionary)};
+    QSet<QString> terms;
+    if (!store.isNull())
+        for (QString const &term: store->terms())
+            terms.insert(term);
+
+    //The generation is checked under the lock, so the terms of
+    //a dictionary no longer watched never replace the new ones
+    QMutexLocker locker{&mMutex};
+    if (generation != mGeneration.loadAcquire())
+        return;
+    QSet<QString> removed{mTerms};
+    QSet<QString> inserted{terms};
+    removed.subtract(terms);
+    inserted.subtract(mTerms);
+    mTerms = terms;
+    locker.unlock();
+    emit changesFound(generation, dictionary, removed.values(), inserted.values());
+}
+
+/**
+ * @brief TermWatcher::relayChanges
+ * Passes on the changes found in the watched dictionary,
+ * even when its terms stayed the same, since definitions
+ * may have changed.
+ * @param generation the generation the changes belong to
+ * @param dictionary the dictionary name
+ * @param removed the terms that are gone
+ * @param inserted the terms that are new
+ */
+void TermWatcher::relayChanges(int generation, QString const &dictionary,
+                               QStringList const &removed, QStringList const &inserted)
+{
+    if (generation == mGeneration.loadAcquire())
+        emit termsChanged(dictionary, removed, inserted);
+}
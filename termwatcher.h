@@ -0,0 +1,68 @@
+#ifndef TERMWATCHER_H
+#define TERMWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+
+class Storage;
+class QFileSystemWatcher;
+class QTimer;
+
+class TermWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TermWatcher(Storage *storage, QString const &resourcesFolder, QObject *parent = nullptr);
+    ~TermWatcher();
+
+    void watch(QString const &dictionary);
+
+    void seed(QStringList const &terms);
+
+    void finishSeeding();
+
+signals:
+    //Do not implement signals
+    void dictionariesChanged();
+
+    void termsChanged(QString dictionary, QStringList removed, QStringList inserted);
+
+    void changesFound(int generation, QString dictionary, QStringList removed, QStringList inserted);
+
+private slots:
+    void queueChange(QString const &path);
+
+    void synchronize();
+
+    void relayChanges(int generation, QString const &dictionary,
+                      QStringList const &removed, QStringList const &inserted);
+
+private:
+    void watchPaths();
+
+    void run(QString const &dictionary, int generation);
+
+    Storage *mStorage;
+    QString const mResourcesFolder;
+    QFileSystemWatcher *mWatcher;
+    QTimer *mTimer;
+    QString mDictionary;
+    bool mDictionariesChanged;
+    bool mTermsChanged;
+    QAtomicInt mGeneration;
+    QFuture<void> mSync;
+    //Whether mTerms holds every term the loader listed
+    bool mSeeded;
+    QMutex mMutex;
+    //The terms of the watched dictionary, as listed by the term
+    //loader and then as last read by the worker
+    QSet<QString> mTerms;
+};
+
+#endif // TERMWATCHER_H
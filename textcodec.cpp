@@ -0,0 +1,301 @@
+#include "textcodec.h"
+
+#include <QTextCodec>
+
+//MSVC never defines __SSE2__, but always has SSE2 on x64,
+//and on x86 when asked for it with /arch:SSE2 or later
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Definitions and term names are UTF-8 everywhere: in the
+ * packs, in the files they are imported from and exported
+ * to, and on the command line. Every conversion goes through
+ * here, so that they all handle bad bytes the same way:
+ * each invalid sequence becomes one replacement character,
+ * and decoding reports that it happened.
+ *
+ * Most definitions are largely ASCII, so runs of ASCII are
+ * checked and widened or narrowed sixteen bytes at a time
+ * where SSE2 is available. Decoding and encoding write
+ * straight into the buffer given, which keeps its capacity
+ * from one call to the next when the caller reuses it.
+ */
+
+/**
+ * @brief TextCodec::codec
+ * @return the codec for text streams, such as those of the
+ * command line, which must not follow the locale
+ */
+QTextCodec *TextCodec::codec()
+{
+    return QTextCodec::codecForMib(106);
+}
+
+/**
+ * @brief TextCodec::isAscii
+ * @param data the bytes
+ * @param size the number of bytes
+ * @return whether every byte is ASCII
+ */
+bool TextCodec::isAscii(char const *data, int size)
+{
+    int i{0};
+#if defined(TEXTCODEC_SSE2)
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i const bytes{_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i))};
+        if (_mm_movemask_epi8(bytes) != 0)
+            return false;
+    }
+#endif
+    for (; i < size; i++)
+        if (static_cast<uchar>(data[i]) >= 0x80)
+            return false;
+    return true;
+}
+
+/**
+ * @brief TextCodec::decode
+ * Decodes UTF-8 in a single pass, checking it as it goes.
+ * Overlong forms, surrogates and code points past U+10FFFF
+ * are invalid, as are truncated sequences.
+ * @param data the UTF-8 bytes
+ * @param size the number of bytes
+ * @param text set to the characters; its buffer is reused
+ * if it is large enough
+ * @return whether the bytes were valid UTF-8
+ */
+bool TextCodec::decode(char const *data, int size, QString &text)
+{
+    //A character never takes more UTF-16 units than bytes
+    text.resize(size);
+    ushort *out{reinterpret_cast<ushort *>(text.data())};
+    uchar const *in{reinterpret_cast<uchar const *>(data)};
+    int length{0};
+    int i{0};
+    bool valid{true};
+    while (i < size)
+    {
+#if defined(TEXTCODEC_SSE2)
+        __m128i const zero{_mm_setzero_si128()};
+        while (i + 16 <= size)
+        {
+            __m128i const bytes{_mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i))};
+            if (_mm_movemask_epi8(bytes) != 0)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + length), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + length + 8), _mm_unpackhi_epi8(bytes, zero));
+            i += 16;
+            length += 16;
+        }
+        if (i >= size)
+            break;
+#endif
+        uint const lead{in[i]};
+        if (lead < 0x80)
+        {
+            out[length++] = static_cast<ushort>(lead);
+            i++;
+            continue;
+        }
+
+        int extra{-1};
+        uint code{0};
+        uint minimum{0};
+        if ((lead & 0xE0) == 0xC0)
+        {
+            extra = 1;
+            code = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            extra = 2;
+            code = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            extra = 3;
+            code = lead & 0x07;
+            minimum = 0x10000;
+        }
+
+        int read{1};
+        for (; read <= extra && i + read < size && (in[i + read] & 0xC0) == 0x80; read++)
+            code = (code << 6) | (in[i + read] & 0x3F);
+        i += read;
+
+        if (read != extra + 1 || code < minimum || code > 0x10FFFF ||
+                (code >= 0xD800 && code <= 0xDFFF))
+        {
+            out[length++] = QChar::ReplacementCharacter;
+            valid = false;
+        }
+        else if (QChar::requiresSurrogates(code))
+        {
+            out[length++] = QChar::highSurrogate(code);
+            out[length++] = QChar::lowSurrogate(code);
+        }
+        else
+            out[length++] = static_cast<ushort>(code);
+    }
+    text.resize(length);
+    return valid;
+}
+
+/**
+ * @brief TextCodec::decode
+ * @param utf8 the UTF-8 bytes
+ * @param text set to the characters, reusing its buffer
+ * @return whether the bytes were valid UTF-8
+ */
+bool TextCodec::decode(QByteArray const &utf8, QString &text)
+{
+    return decode(utf8.constData(), utf8.size(), text);
+}
+
+/**
+ * @brief TextCodec::decode
+ * @param utf8 the UTF-8 bytes
+ * @return the characters, with invalid sequences replaced
+ */
+QString TextCodec::decode(QByteArray const &utf8)
+{
+    QString text;
+    decode(utf8.constData(), utf8.size(), text);
+    return text;
+}
+
+/**
+ * @brief writeUtf8
+ * Encodes characters as UTF-8. A surrogate without its
+ * other half becomes a replacement character.
+ * @param text the characters
+ * @param length the number of characters
+ * @param begin where the bytes go, with room for three
+ * bytes per character
+ * @return the number of bytes written
+ */
+static int writeUtf8(QChar const *text, int length, uchar *begin)
+{
+    uchar *out{begin};
+    ushort const *in{reinterpret_cast<ushort const *>(text)};
+    int i{0};
+    while (i < length)
+    {
+#if defined(TEXTCODEC_SSE2)
+        __m128i const nonAscii{_mm_set1_epi16(static_cast<short>(0xFF80))};
+        __m128i const zero{_mm_setzero_si128()};
+        while (i + 16 <= length)
+        {
+            __m128i const low{_mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i))};
+            __m128i const high{_mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i + 8))};
+            __m128i const flagged{_mm_and_si128(_mm_or_si128(low, high), nonAscii)};
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(flagged, zero)) != 0xFFFF)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(low, high));
+            i += 16;
+            out += 16;
+        }
+        if (i >= length)
+            break;
+#endif
+        uint code{in[i++]};
+        if (code < 0x80)
+        {
+            *out++ = static_cast<uchar>(code);
+            continue;
+        }
+        if (code < 0x800)
+        {
+            *out++ = static_cast<uchar>(0xC0 | (code >> 6));
+            *out++ = static_cast<uchar>(0x80 | (code & 0x3F));
+            continue;
+        }
+        if (QChar::isHighSurrogate(code) && i < length && QChar::isLowSurrogate(in[i]))
+        {
+            code = QChar::surrogateToUcs4(static_cast<ushort>(code), in[i++]);
+            *out++ = static_cast<uchar>(0xF0 | (code >> 18));
+            *out++ = static_cast<uchar>(0x80 | ((code >> 12) & 0x3F));
+            *out++ = static_cast<uchar>(0x80 | ((code >> 6) & 0x3F));
+            *out++ = static_cast<uchar>(0x80 | (code & 0x3F));
+            continue;
+        }
+        if (QChar::isSurrogate(code))
+            code = QChar::ReplacementCharacter;
+        *out++ = static_cast<uchar>(0xE0 | (code >> 12));
+        *out++ = static_cast<uchar>(0x80 | ((code >> 6) & 0x3F));
+        *out++ = static_cast<uchar>(0x80 | (code & 0x3F));
+    }
+    return static_cast<int>(out - begin);
+}
+
+/**
+ * @brief TextCodec::append
+ * Encodes characters as UTF-8 at the end of a buffer.
+ * @param text the characters
+ * @param length the number of characters
+ * @param utf8 the buffer the bytes are appended to
+ */
+void TextCodec::append(QChar const *text, int length, QByteArray &utf8)
+{
+    //A UTF-16 unit never takes more than three bytes
+    int const start{utf8.size()};
+    utf8.resize(start + length * 3);
+    utf8.resize(start + writeUtf8(text, length, reinterpret_cast<uchar *>(utf8.data()) + start));
+}
+
+/**
+ * @brief TextCodec::encode
+ * @param text the characters
+ * @param utf8 set to the UTF-8 bytes, reusing its buffer
+ */
+void TextCodec::encode(QString const &text, QByteArray &utf8)
+{
+    //Resizing to zero would free the buffer
+    utf8.resize(text.size() * 3);
+    utf8.resize(writeUtf8(text.constData(), text.size(), reinterpret_cast<uchar *>(utf8.data())));
+}
+
+/**
+ * @brief TextCodec::encode
+ * @param text the characters
+ * @return the UTF-8 bytes
+ */
+QByteArray TextCodec::encode(QString const &text)
+{
+    QByteArray utf8;
+    append(text.constData(), text.size(), utf8);
+    return utf8;
+}
+
+/**
+ * @brief TextCodec::utf8Size
+ * @param text the characters
+ * @param length the number of characters
+ * @return how many bytes encode() makes of the characters
+ */
+int TextCodec::utf8Size(QChar const *text, int length)
+{
+    int size{0};
+    for (int i = 0; i < length; i++)
+    {
+        ushort const unit{text[i].unicode()};
+        if (unit < 0x80)
+            size += 1;
+        else if (unit < 0x800)
+            size += 2;
+        else if (QChar::isHighSurrogate(unit) && i + 1 < length && text[i + 1].isLowSurrogate())
+        {
+            size += 4;
+            i++;
+        }
+        //Lone surrogates are encoded as replacement characters
+        else
+            size += 3;
+    }
+    return size;
+}
@@ -0,0 +1,31 @@
+#ifndef TEXTCODEC_H
+#define TEXTCODEC_H
+
+#include <QString>
+#include <QByteArray>
+
+class QTextCodec;
+
+class TextCodec
+{
+public:
+    static QTextCodec *codec();
+
+    static bool isAscii(char const *data, int size);
+
+    static bool decode(char const *data, int size, QString &text);
+
+    static bool decode(QByteArray const &utf8, QString &text);
+
+    static QString decode(QByteArray const &utf8);
+
+    static void append(QChar const *text, int length, QByteArray &utf8);
+
+    static void encode(QString const &text, QByteArray &utf8);
+
+    static QByteArray encode(QString const &text);
+
+    static int utf8Size(QChar const *text, int length);
+};
+
+#endif // TEXTCODEC_H